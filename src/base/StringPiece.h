@@ -0,0 +1,78 @@
+#ifndef STRING_PIECE_H
+#define STRING_PIECE_H
+
+#include <string.h>
+#include <strings.h>
+#include <string>
+
+/**
+ * 指向一段外部字符串的只读视图(const char*, size)，不拥有内存
+ * 项目使用 C++11，没有 std::string_view，这里实现用到的最小子集
+ * 使用者需要保证被引用的内存在视图使用期间有效
+ */
+class StringPiece
+{
+public:
+    StringPiece()
+        : ptr_(nullptr), length_(0) {}
+    StringPiece(const char *str)
+        : ptr_(str), length_(static_cast<size_t>(strlen(str))) {}
+    StringPiece(const std::string &str)
+        : ptr_(str.data()), length_(str.size()) {}
+    StringPiece(const char *offset, size_t len)
+        : ptr_(offset), length_(len) {}
+
+    const char* data() const { return ptr_; }
+    size_t size() const { return length_; }
+    bool empty() const { return length_ == 0; }
+    const char* begin() const { return ptr_; }
+    const char* end() const { return ptr_ + length_; }
+
+    void clear() { ptr_ = nullptr; length_ = 0; }
+    void set(const char *buffer, size_t len) { ptr_ = buffer; length_ = len; }
+
+    char operator[](size_t i) const { return ptr_[i]; }
+
+    void remove_prefix(size_t n)
+    {
+        ptr_ += n;
+        length_ -= n;
+    }
+
+    void remove_suffix(size_t n)
+    {
+        length_ -= n;
+    }
+
+    bool operator==(const StringPiece &x) const
+    {
+        return length_ == x.length_ && memcmp(ptr_, x.ptr_, length_) == 0;
+    }
+
+    bool operator!=(const StringPiece &x) const
+    {
+        return !(*this == x);
+    }
+
+    // 忽略大小写比较，HTTP 首部字段名和部分字段值需要
+    bool equalsIgnoreCase(const StringPiece &x) const
+    {
+        return length_ == x.length_ && strncasecmp(ptr_, x.ptr_, length_) == 0;
+    }
+
+    bool startsWithIgnoreCase(const StringPiece &x) const
+    {
+        return length_ >= x.length_ && strncasecmp(ptr_, x.ptr_, x.length_) == 0;
+    }
+
+    std::string as_string() const
+    {
+        return std::string(ptr_, length_);
+    }
+
+private:
+    const char *ptr_;
+    size_t length_;
+};
+
+#endif // STRING_PIECE_H
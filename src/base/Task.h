@@ -0,0 +1,146 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * 只能移动的 void() 可调用对象，用于 EventLoop 跨线程投递的任务
+ * 和 std::function 相比:
+ *   不要求可拷贝，投递时移动进来，不会拷贝 bind 进来的 shared_ptr 和 string
+ *   kInlineSize 字节以内的对象直接放在内部缓冲区，常见的 std::bind(&Class::f, ptr, args) 不需要堆分配
+ */
+class Task
+{
+public:
+    static const size_t kInlineSize = 64;
+
+    Task() noexcept : ops_(nullptr) {}
+
+    template <typename F,
+              typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F &&f)
+        : ops_(nullptr)
+    {
+        using Fn = typename std::decay<F>::type;
+        construct<Fn>(std::forward<F>(f), std::integral_constant<bool, fitsInline<Fn>()>());
+    }
+
+    Task(Task &&other) noexcept
+        : ops_(other.ops_)
+    {
+        if (ops_)
+        {
+            ops_->move(&storage_, &other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task& operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.ops_)
+            {
+                ops_ = other.ops_;
+                ops_->move(&storage_, &other.storage_);
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    void operator()() { ops_->invoke(&storage_); }
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    void reset()
+    {
+        if (ops_)
+        {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    using Storage = typename std::aligned_storage<kInlineSize, alignof(void*)>::type;
+
+    // 每种可调用类型一张函数表，move 把 src 移动构造到 dst 并析构 src
+    struct Ops
+    {
+        void (*invoke)(Storage*);
+        void (*move)(Storage *dst, Storage *src);
+        void (*destroy)(Storage*);
+    };
+
+    template <typename Fn>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(Fn) <= kInlineSize && alignof(Fn) <= alignof(Storage) &&
+               std::is_nothrow_move_constructible<Fn>::value;
+    }
+
+    // 放在内部缓冲区
+    template <typename Fn>
+    struct InlineOps
+    {
+        static Fn* get(Storage *s) { return reinterpret_cast<Fn*>(s); }
+        static void invoke(Storage *s) { (*get(s))(); }
+        static void move(Storage *dst, Storage *src)
+        {
+            ::new (dst) Fn(std::move(*get(src)));
+            get(src)->~Fn();
+        }
+        static void destroy(Storage *s) { get(s)->~Fn(); }
+        static const Ops ops;
+    };
+
+    // 太大的对象放在堆上，缓冲区里只存指针
+    template <typename Fn>
+    struct HeapOps
+    {
+        static Fn*& get(Storage *s) { return *reinterpret_cast<Fn**>(s); }
+        static void invoke(Storage *s) { (*get(s))(); }
+        static void move(Storage *dst, Storage *src) { ::new (dst) Fn*(get(src)); }
+        static void destroy(Storage *s) { delete get(s); }
+        static const Ops ops;
+    };
+
+    template <typename Fn, typename F>
+    void construct(F &&f, std::true_type)
+    {
+        ::new (&storage_) Fn(std::forward<F>(f));
+        ops_ = &InlineOps<Fn>::ops;
+    }
+
+    template <typename Fn, typename F>
+    void construct(F &&f, std::false_type)
+    {
+        ::new (&storage_) Fn*(new Fn(std::forward<F>(f)));
+        ops_ = &HeapOps<Fn>::ops;
+    }
+
+    Storage storage_;
+    const Ops *ops_;
+};
+
+template <typename Fn>
+const Task::Ops Task::InlineOps<Fn>::ops = {
+    &Task::InlineOps<Fn>::invoke, &Task::InlineOps<Fn>::move, &Task::InlineOps<Fn>::destroy
+};
+
+template <typename Fn>
+const Task::Ops Task::HeapOps<Fn>::ops = {
+    &Task::HeapOps<Fn>::invoke, &Task::HeapOps<Fn>::move, &Task::HeapOps<Fn>::destroy
+};
+
+#endif // TASK_H
@@ -1,6 +1,7 @@
 #include <semaphore.h>
 #include "Thread.h"
 #include "CurrentThread.h"
+#include "ThreadPlacement.h"
 
 std::atomic_int Thread::numCreated_(0);
 
@@ -40,6 +41,9 @@ void Thread::start()
     thread_ = std::shared_ptr<std::thread>(new std::thread([&](){
         // 获取线程tid
         tid_ = CurrentThread::tid();
+        // 线程名显示在 top -H、perf 中；先绑定 CPU 再执行线程函数，之后分配的内存按首次访问落在本地节点
+        ThreadPlacement::setCurrentThreadName(name_);
+        ThreadPlacement::bindCurrentThread(cpus_);
         // v操作
         sem_post(&sem);
         // 开启一个新线程专门执行该线程函数
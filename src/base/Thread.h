@@ -5,6 +5,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 #include <atomic>
 #include "noncopyable.h"
 
@@ -18,6 +19,10 @@ public:
     void start(); // 开启线程
     void join();  // 等待线程
 
+    // 线程启动时绑定到 cpus 上，需要在 start 之前设置，为空时不绑定
+    void setCpuAffinity(const std::vector<int> &cpus) { cpus_ = cpus; }
+    const std::vector<int>& cpuAffinity() const { return cpus_; }
+
     bool started() const { return started_; }
     pid_t tid() const { return tid_; }
     const std::string& name() const { return name_; }
@@ -35,6 +40,7 @@ private:
     // 其实保存的是 EventLoopThread::threadFunc()
     ThreadFunc func_;   
     std::string name_;  // 线程名
+    std::vector<int> cpus_; // 绑定的 CPU
     static std::atomic_int numCreated_; // 线程索引
 };
 
@@ -0,0 +1,190 @@
+#include "ThreadPlacement.h"
+#include "Logging.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/prctl.h>
+#include <algorithm>
+#include <fstream>
+
+namespace
+{
+
+std::string readFirstLine(const std::string &path)
+{
+    std::ifstream file(path.c_str());
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+} // namespace
+
+namespace ThreadPlacement
+{
+
+std::vector<int> parseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+    const char *p = list.c_str();
+    while (*p != '\0' && *p != '\n')
+    {
+        char *end = nullptr;
+        long first = ::strtol(p, &end, 10);
+        if (end == p || first < 0)
+        {
+            return std::vector<int>();
+        }
+        long last = first;
+        p = end;
+        if (*p == '-')
+        {
+            ++p;
+            last = ::strtol(p, &end, 10);
+            if (end == p || last < first)
+            {
+                return std::vector<int>();
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+        if (*p == ',')
+        {
+            ++p;
+        }
+        else if (*p != '\0' && *p != '\n')
+        {
+            return std::vector<int>();
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::vector<int> allowedCpus()
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+std::vector<int> excludeCpus(const std::vector<int> &cpus)
+{
+    std::vector<int> rest;
+    for (int cpu : allowedCpus())
+    {
+        if (std::find(cpus.begin(), cpus.end(), cpu) == cpus.end())
+        {
+            rest.push_back(cpu);
+        }
+    }
+    return rest;
+}
+
+int numaNodeCount()
+{
+    std::vector<int> nodes = parseCpuList(readFirstLine("/sys/devices/system/node/online"));
+    return nodes.empty() ? 1 : nodes.back() + 1;
+}
+
+std::vector<int> numaNodeCpus(int node)
+{
+    char path[64];
+    snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", node);
+    return parseCpuList(readFirstLine(path));
+}
+
+int numaNodeOfCpu(int cpu)
+{
+    const int nodes = numaNodeCount();
+    for (int node = 0; node < nodes; ++node)
+    {
+        std::vector<int> cpus = numaNodeCpus(node);
+        if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end())
+        {
+            return node;
+        }
+    }
+    return 0;
+}
+
+std::vector<int> spreadAcrossNodes(const std::vector<int> &cpus)
+{
+    // 每个节点上属于 cpus 的 CPU，拓扑里找不到的放进最后一组
+    const int nodes = numaNodeCount();
+    std::vector<std::vector<int>> perNode(nodes + 1);
+    for (int cpu : cpus)
+    {
+        int node = nodes;
+        for (int n = 0; n < nodes && node == nodes; ++n)
+        {
+            std::vector<int> nodeCpus = numaNodeCpus(n);
+            if (std::find(nodeCpus.begin(), nodeCpus.end(), cpu) != nodeCpus.end())
+            {
+                node = n;
+            }
+        }
+        perNode[node].push_back(cpu);
+    }
+
+    std::vector<int> spread;
+    for (size_t i = 0; spread.size() < cpus.size(); ++i)
+    {
+        for (const std::vector<int> &group : perNode)
+        {
+            if (i < group.size())
+            {
+                spread.push_back(group[i]);
+            }
+        }
+    }
+    return spread;
+}
+
+bool bindCurrentThread(const std::vector<int> &cpus)
+{
+    if (cpus.empty())
+    {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+    if (::sched_setaffinity(0, sizeof(set), &set) < 0)
+    {
+        LOG_ERROR << "sched_setaffinity error:" << errno;
+        return false;
+    }
+    return true;
+}
+
+void setCurrentThreadName(const std::string &name)
+{
+    // 内核限制 16 字节(含结尾的 0)，超出的部分被截掉
+    ::prctl(PR_SET_NAME, name.c_str());
+}
+
+} // namespace ThreadPlacement
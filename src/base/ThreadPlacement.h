@@ -0,0 +1,40 @@
+#ifndef THREAD_PLACEMENT_H
+#define THREAD_PLACEMENT_H
+
+#include <string>
+#include <vector>
+
+/**
+ * 线程的 CPU 绑定、NUMA 拓扑和线程名
+ * NUMA 拓扑从 /sys/devices/system/node 读取，没有这些信息时当作只有一个节点
+ */
+namespace ThreadPlacement
+{
+    // "0-3,8,10-11" 格式的 CPU 列表，格式错误时返回空
+    std::vector<int> parseCpuList(const std::string &list);
+
+    // 当前线程允许运行的 CPU
+    std::vector<int> allowedCpus();
+
+    // allowedCpus 中去掉 cpus 之后剩下的，用来把日志、数据库等线程放在 IO 线程之外的 CPU 上
+    std::vector<int> excludeCpus(const std::vector<int> &cpus);
+
+    int numaNodeCount();
+    std::vector<int> numaNodeCpus(int node);
+    // cpu 所在的 NUMA 节点，不知道时返回 0
+    int numaNodeOfCpu(int cpu);
+
+    /**
+     * 按 NUMA 节点交错排列 cpus: 节点 0 的第一个、节点 1 的第一个、节点 0 的第二个...
+     * 依次分给 subLoop 时各个节点上的 loop 数量相差不超过一
+     */
+    std::vector<int> spreadAcrossNodes(const std::vector<int> &cpus);
+
+    // 把当前线程绑定到 cpus 上，cpus 为空时什么也不做
+    bool bindCurrentThread(const std::vector<int> &cpus);
+
+    // 设置当前线程在 top、perf 中显示的名字，超过 15 个字符的部分被截掉
+    void setCurrentThreadName(const std::string &name);
+}
+
+#endif // THREAD_PLACEMENT_H
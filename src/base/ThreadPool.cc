@@ -28,6 +28,7 @@ void ThreadPool::start()
         snprintf(id, sizeof(id), "%d", i + 1);
         threads_.emplace_back(new Thread(
             std::bind(&ThreadPool::runInThread, this), name_ + id));
+        threads_[i]->setCpuAffinity(cpus_);
         threads_[i]->start();
     }
     // 不创建新线程
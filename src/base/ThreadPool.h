@@ -20,6 +20,8 @@ public:
 
     void setThreadInitCallback(const ThreadFunction& cb) { threadInitCallback_ = cb; }
     void setThreadSize(const int& num) { threadSize_ = num; }
+    // 工作线程绑定的 CPU，需要在 start 之前设置，比如 ThreadPlacement::excludeCpus(server.ioCpus())
+    void setCpuAffinity(const std::vector<int> &cpus) { cpus_ = cpus; }
     void start();
     void stop();
 
@@ -37,6 +39,7 @@ private:
     std::string name_;
     ThreadFunction threadInitCallback_;
     std::vector<std::unique_ptr<Thread>> threads_;
+    std::vector<int> cpus_;
     std::deque<ThreadFunction> queue_;
     bool running_;
     size_t threadSize_;
@@ -34,6 +34,8 @@ public:
         return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond); 
     }
 
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+
     // 失效的时间戳，返回一个值为0的Timestamp
     static Timestamp invalid()
     {
@@ -61,6 +63,13 @@ inline bool operator==(Timestamp lhs, Timestamp rhs)
     return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
 }
 
+// 两个时间戳相差的秒数 high - low
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
 // 如果是重复定时任务就会对此时间戳进行增加。
 inline Timestamp addTime(Timestamp timestamp, double seconds)
 {
@@ -0,0 +1,320 @@
+#include "DirIndex.h"
+#include "EventLoop.h"
+#include "Logging.h"
+
+#include <sys/inotify.h>
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+
+// 只关心目录项的增删和文件内容变化
+const uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                            IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+// 文件列表的每一项，带下载/删除链接和不带链接两种
+const HttpTemplate kActionRow(
+    "            <tr><td class=\"col1\"><a href={{prefix}}/{{name}}>{{name}}</a></td> "
+    "<td class=\"col2\"><a href=\"download{{prefix}}/{{name}}\">下载</a></td> "
+    "<td class=\"col3\"><a href=\"delete{{prefix}}/{{name}}\" onclick=\"return confirmDelete();\">删除</a></td></tr>\n");
+const HttpTemplate kPlainRow(
+    "            <tr><td class=\"col1\"><a href={{name}}>{{name}}</a></td> "
+    "<td class=\"col2\"></td> <td class=\"col3\"></td></tr>\n");
+
+int createInotifyFd()
+{
+    int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+    {
+        LOG_ERROR << "Failed in inotify_init1, errno = " << errno;
+    }
+    return fd;
+}
+
+} // namespace
+
+DirIndex::DirIndex(EventLoop *loop, const std::string &templatePath)
+    : loop_(loop),
+      inotifyFd_(createInotifyFd()),
+      inotifyChannel_(loop_, inotifyFd_)
+{
+    loadTemplate(templatePath);
+    if (inotifyFd_ >= 0)
+    {
+        inotifyChannel_.setReadCallback(std::bind(&DirIndex::handleRead, this));
+        inotifyChannel_.enableReading();
+    }
+}
+
+DirIndex::~DirIndex()
+{
+    if (inotifyFd_ >= 0)
+    {
+        inotifyChannel_.disableAll();
+        inotifyChannel_.remove();
+        ::close(inotifyFd_);
+    }
+}
+
+std::string DirIndex::normalize(const std::string &dir)
+{
+    std::string::size_type n = dir.find_last_not_of('/');
+    return n == std::string::npos ? std::string("/") : dir.substr(0, n + 1);
+}
+
+// 跳过 . .. 以及正在上传的临时文件
+bool DirIndex::hidden(const std::string &name)
+{
+    return name == "." || name == ".." || name.compare(0, 8, ".upload-") == 0;
+}
+
+// 模板只在启动时读取并编译一次
+void DirIndex::loadTemplate(const std::string &templatePath)
+{
+    std::string text;
+    std::ifstream fileListStream(templatePath, std::ios::in);
+    if (!fileListStream)
+    {
+        LOG_ERROR << "DirIndex can not open template " << templatePath;
+    }
+    std::string tempLine;
+    bool labeled = false;
+    while (getline(fileListStream, tempLine))
+    {
+        if (!labeled && tempLine == "<!--filelist_label-->")
+        {
+            text += "{{filelist}}";
+            labeled = true;
+            continue;
+        }
+        text += tempLine + "\n";
+    }
+    if (!labeled)
+    {
+        text += "{{filelist}}";
+    }
+    page_.reset(new HttpTemplate(text));
+}
+
+// 调用者持有 mutex_，先加监视再 readdir，不会漏掉两者之间的变化
+DirIndex::DirMap::iterator DirIndex::load(const std::string &dir)
+{
+    DIR *dirp = ::opendir(dir.c_str());
+    if (!dirp)
+    {
+        return dirs_.end();
+    }
+
+    Dir entry;
+    entry.wd = inotifyFd_ >= 0 ? ::inotify_add_watch(inotifyFd_, dir.c_str(), kWatchMask) : -1;
+    if (entry.wd < 0)
+    {
+        // 没有监视就不能缓存，每次重新读取
+        LOG_WARN << "DirIndex can not watch " << dir << ", errno = " << errno;
+    }
+    else if (watches_.count(entry.wd))
+    {
+        // 同一个目录换了一种写法，已经以另一个路径缓存过，这里不再重复缓存
+        entry.wd = -1;
+    }
+
+    struct dirent *stdinfo;
+    while ((stdinfo = ::readdir(dirp)) != nullptr)
+    {
+        std::string name(stdinfo->d_name);
+        if (!hidden(name))
+        {
+            entry.names.insert(std::move(name));
+        }
+    }
+    ::closedir(dirp);
+
+    if (entry.wd >= 0)
+    {
+        // 缓存满了淘汰最久没有列出的目录
+        if (dirs_.size() >= kMaxDirs)
+        {
+            DirMap::iterator oldest = dirs_.find(lru_.back());
+            ::inotify_rm_watch(inotifyFd_, oldest->second.wd);
+            erase(oldest);
+        }
+        watches_[entry.wd] = dir;
+    }
+    entry.lru = lru_.insert(lru_.begin(), dir);
+    return dirs_.insert(DirMap::value_type(dir, std::move(entry))).first;
+}
+
+void DirIndex::erase(DirMap::iterator it)
+{
+    if (it->second.wd >= 0)
+    {
+        watches_.erase(it->second.wd);
+    }
+    lru_.erase(it->second.lru);
+    dirs_.erase(it);
+}
+
+HttpTemplate::Block DirIndex::renderPage(const Dir &dir, const std::string &urlPrefix) const
+{
+    // 先算出所有文件项的总长度，只分配一次
+    const HttpTemplate &row = urlPrefix.empty() ? kPlainRow : kActionRow;
+    size_t total = 0;
+    for (const std::string &filename : dir.names)
+    {
+        total += urlPrefix.empty() ? row.size({filename}) : row.size({urlPrefix, filename});
+    }
+    std::string filelist;
+    filelist.reserve(total);
+    for (const std::string &filename : dir.names)
+    {
+        if (urlPrefix.empty())
+            row.render(&filelist, {filename});
+        else
+            row.render(&filelist, {urlPrefix, filename});
+    }
+    return page_->renderBlock({filelist});
+}
+
+bool DirIndex::render(const std::string &dir, const std::string &urlPrefix, HttpTemplate::Block &page)
+{
+    std::string key = normalize(dir);
+    std::unique_lock<std::mutex> lock(mutex_);
+    DirMap::iterator it = dirs_.find(key);
+    if (it == dirs_.end())
+    {
+        it = load(key);
+        if (it == dirs_.end())
+        {
+            page = renderPage(Dir(), urlPrefix);
+            return false;
+        }
+    }
+
+    Dir &entry = it->second;
+    if (entry.wd < 0)
+    {
+        page = renderPage(entry, urlPrefix);
+        erase(it);
+        return true;
+    }
+    lru_.splice(lru_.begin(), lru_, entry.lru);
+    auto cached = entry.pages.find(urlPrefix);
+    if (cached == entry.pages.end())
+    {
+        if (entry.pages.size() >= kMaxPagesPerDir)
+        {
+            page = renderPage(entry, urlPrefix);
+            return true;
+        }
+        cached = entry.pages.insert(std::make_pair(urlPrefix, renderPage(entry, urlPrefix))).first;
+    }
+    page = cached->second;
+    return true;
+}
+
+void DirIndex::addEntry(const std::string &dir, const std::string &name)
+{
+    if (hidden(name))
+        return;
+    std::unique_lock<std::mutex> lock(mutex_);
+    DirMap::iterator it = dirs_.find(normalize(dir));
+    if (it != dirs_.end() && it->second.names.insert(name).second)
+    {
+        it->second.pages.clear();
+    }
+}
+
+void DirIndex::removeEntry(const std::string &dir, const std::string &name)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    DirMap::iterator it = dirs_.find(normalize(dir));
+    if (it != dirs_.end() && it->second.names.erase(name) > 0)
+    {
+        it->second.pages.clear();
+    }
+}
+
+void DirIndex::handleRead()
+{
+    // inotify_event 要求按其成员对齐
+    alignas(struct inotify_event) char buf[4096];
+    std::vector<std::string> changed;
+    while (true)
+    {
+        ssize_t n = ::read(inotifyFd_, buf, sizeof buf);
+        if (n <= 0)
+        {
+            if (n < 0 && errno != EAGAIN && errno != EINTR)
+            {
+                LOG_ERROR << "DirIndex::handleRead read errno = " << errno;
+            }
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (char *p = buf; p < buf + n; )
+        {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                // 丢失了事件，全部作废，下次访问时重新读取
+                LOG_WARN << "DirIndex inotify queue overflow";
+                for (const auto &watch : watches_)
+                {
+                    ::inotify_rm_watch(inotifyFd_, watch.first);
+                }
+                watches_.clear();
+                dirs_.clear();
+                lru_.clear();
+                continue;
+            }
+
+            auto watch = watches_.find(event->wd);
+            if (watch == watches_.end())
+                continue;
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+                // 目录本身被删除或移走
+                if (!(event->mask & IN_IGNORED))
+                {
+                    ::inotify_rm_watch(inotifyFd_, event->wd);
+                }
+                erase(dirs_.find(watch->second));
+                continue;
+            }
+            if (event->len == 0)
+                continue;
+
+            std::string name(event->name);
+            Dir &entry = dirs_.at(watch->second);
+            if (event->mask & (IN_CREATE | IN_MOVED_TO))
+            {
+                if (!hidden(name) && entry.names.insert(name).second)
+                    entry.pages.clear();
+            }
+            else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                if (entry.names.erase(name) > 0)
+                    entry.pages.clear();
+            }
+            if (!hidden(name))
+            {
+                changed.push_back(watch->second + "/" + name);
+            }
+        }
+    }
+
+    if (changeCallback_)
+    {
+        for (const std::string &path : changed)
+        {
+            changeCallback_(path);
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef HTTP_DIRINDEX_H
+#define HTTP_DIRINDEX_H
+
+#include "noncopyable.h"
+#include "Channel.h"
+#include "HttpTemplate.h"
+
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+class EventLoop;
+
+/**
+ * 目录列表索引，多个 subLoop 共享
+ * 每个被访问过的目录第一次列出时 readdir 一次，之后用 inotify 增量维护文件名集合，
+ * 用 html/filelist.html 模板渲染好的页面作为不可变 Block 缓存，列目录不需要拷贝
+ * 最多缓存 kMaxDirs 个目录，超出时淘汰最久没有列出的目录并移除它的 inotify 监视
+ *
+ * inotify fd 注册在 loop 上，事件在 loop 线程处理
+ * FileServer 自己的上传/删除通过 addEntry/removeEntry 立即更新，不需要等 inotify 事件
+ */
+class DirIndex : noncopyable
+{
+public:
+    // 监视的目录中有文件被修改、删除或移动时回调，参数是文件完整路径
+    using ChangeCallback = std::function<void(const std::string &)>;
+
+    DirIndex(EventLoop *loop, const std::string &templatePath);
+    ~DirIndex();
+
+    void setChangeCallback(ChangeCallback cb) { changeCallback_ = std::move(cb); }
+
+    /**
+     * 生成目录 dir 的文件列表页面
+     * urlPrefix 非空时每一项带下载/删除链接，链接前缀为 urlPrefix
+     * 目录无法打开时返回 false，page 为没有文件项的页面
+     */
+    bool render(const std::string &dir, const std::string &urlPrefix, HttpTemplate::Block &page);
+
+    void addEntry(const std::string &dir, const std::string &name);
+    void removeEntry(const std::string &dir, const std::string &name);
+
+private:
+    struct Dir
+    {
+        Dir() : wd(-1) {}
+
+        int wd;                                     // inotify watch descriptor，-1 表示没有监视
+        std::set<std::string> names;                // 有序的文件名
+        std::map<std::string, HttpTemplate::Block> pages;   // urlPrefix -> 渲染好的页面，最多 kMaxPagesPerDir 个
+        std::list<std::string>::iterator lru;       // 在 lru_ 中的位置
+    };
+    /**
+     * urlPrefix 来自客户端请求的路径，"/img"、"//img"、"/img/" 等写法都指向同一个目录
+     * 每个目录只缓存前几种写法的页面，其余的每次渲染，不能让客户端无限制地增加缓存
+     */
+    static const size_t kMaxPagesPerDir = 4;
+    // 目录路径同样来自客户端，缓存的目录数和 inotify 监视数都要有上限
+    static const size_t kMaxDirs = 256;
+    using DirMap = std::map<std::string, Dir>;
+
+    static std::string normalize(const std::string &dir);
+    static bool hidden(const std::string &name);
+    void loadTemplate(const std::string &templatePath);
+    DirMap::iterator load(const std::string &dir);
+    // 从 dirs_、watches_、lru_ 中删除，不处理 inotify 监视
+    void erase(DirMap::iterator it);
+    HttpTemplate::Block renderPage(const Dir &dir, const std::string &urlPrefix) const;
+    void handleRead();
+
+    EventLoop *loop_;
+    const int inotifyFd_;
+    Channel inotifyChannel_;
+    ChangeCallback changeCallback_;
+
+    // 页面模板，<!--filelist_label--> 这一行换成 {{filelist}} 占位符
+    std::unique_ptr<HttpTemplate> page_;
+
+    std::mutex mutex_;
+    DirMap dirs_;
+    std::map<int, std::string> watches_;    // wd -> 目录
+    std::list<std::string> lru_;            // 缓存的目录，最近列出的在前面
+};
+
+#endif // HTTP_DIRINDEX_H
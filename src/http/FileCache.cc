@@ -0,0 +1,136 @@
+#include "FileCache.h"
+#include "Logging.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+FileCache::File::~File()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+}
+
+FileCache::FileCache(size_t capacity, double revalidateSeconds)
+    : capacity_(capacity),
+      revalidateSeconds_(revalidateSeconds)
+{
+}
+
+// open + fstat，只保留普通文件的fd
+FileCache::FilePtr FileCache::open(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return FilePtr();
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0)
+    {
+        int savedErrno = errno;
+        ::close(fd);
+        errno = savedErrno;
+        return FilePtr();
+    }
+    if (!S_ISREG(st.st_mode))
+    {
+        ::close(fd);
+        fd = -1;
+    }
+    return std::make_shared<File>(path, fd, st);
+}
+
+bool FileCache::sameFile(const struct stat &lhs, const struct stat &rhs)
+{
+    return lhs.st_ino == rhs.st_ino &&
+           lhs.st_dev == rhs.st_dev &&
+           lhs.st_size == rhs.st_size &&
+           lhs.st_mtim.tv_sec == rhs.st_mtim.tv_sec &&
+           lhs.st_mtim.tv_nsec == rhs.st_mtim.tv_nsec;
+}
+
+FileCache::FilePtr FileCache::get(const std::string &path)
+{
+    FilePtr file;
+    Timestamp now = Timestamp::now();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = files_.find(path);
+        if (it != files_.end())
+        {
+            // 移到表头
+            lru_.splice(lru_.begin(), lru_, it->second);
+            file = *it->second;
+            if (timeDifference(now, file->checked) < revalidateSeconds_)
+            {
+                return file;
+            }
+        }
+    }
+
+    // 条目过期，stat 确认文件是否被修改，系统调用不持有锁
+    if (file)
+    {
+        struct stat st;
+        if (::stat(path.c_str(), &st) == 0 && sameFile(st, file->st))
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            file->checked = now;
+            return file;
+        }
+        LOG_DEBUG << "FileCache " << path << " changed";
+    }
+
+    file = open(path);
+    if (file)
+    {
+        insert(file);
+    }
+    else
+    {
+        int savedErrno = errno;
+        invalidate(path);
+        errno = savedErrno;
+    }
+    return file;
+}
+
+void FileCache::insert(const FilePtr &file)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = files_.find(file->path);
+    if (it != files_.end())
+    {
+        lru_.erase(it->second);
+        files_.erase(it);
+    }
+    lru_.push_front(file);
+    files_[file->path] = lru_.begin();
+
+    // 淘汰最久没用的条目，正在 sendfile 的连接仍然持有引用
+    while (lru_.size() > capacity_)
+    {
+        files_.erase(lru_.back()->path);
+        lru_.pop_back();
+    }
+}
+
+void FileCache::invalidate(const std::string &path)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = files_.find(path);
+    if (it != files_.end())
+    {
+        lru_.erase(it->second);
+        files_.erase(it);
+    }
+}
+
+size_t FileCache::size() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return lru_.size();
+}
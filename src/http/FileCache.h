@@ -0,0 +1,65 @@
+#ifndef HTTP_FILECACHE_H
+#define HTTP_FILECACHE_H
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+
+#include <sys/stat.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * 已打开文件描述符和 stat 信息的 LRU 缓存，多个 subLoop 共享
+ * 命中时不需要 stat/open 系统调用，每个条目每隔 revalidateSeconds 用 stat 比较
+ * inode、mtime 和 size 检查文件是否被修改
+ *
+ * 条目通过 shared_ptr 引用计数，被淘汰或失效后只要还有连接在 sendfile
+ * fd 就不会被关闭，最后一个引用释放时才 close
+ */
+class FileCache : noncopyable
+{
+public:
+    struct File : noncopyable
+    {
+        File(const std::string &p, int f, const struct stat &s)
+            : path(p), fd(f), st(s), checked(Timestamp::now()) {}
+        ~File();
+
+        const std::string path;
+        const int fd;           // 普通文件的只读fd，目录等其他类型为 -1
+        const struct stat st;
+        Timestamp checked;      // 上一次确认文件没有变化的时间，受 FileCache::mutex_ 保护
+    };
+    using FilePtr = std::shared_ptr<File>;
+
+    explicit FileCache(size_t capacity = 1024, double revalidateSeconds = 1.0);
+
+    /**
+     * 获取 path 对应的文件，不存在或打开失败返回 nullptr，errno 保存失败原因
+     * 返回的 fd 只能配合显式 offset 使用(sendfile/pread)，不能改变文件偏移
+     */
+    FilePtr get(const std::string &path);
+
+    // 文件被上传覆盖或删除时主动让缓存失效
+    void invalidate(const std::string &path);
+
+    size_t size() const;
+
+private:
+    using FileList = std::list<FilePtr>;    // 表头是最近使用的条目
+
+    static FilePtr open(const std::string &path);
+    static bool sameFile(const struct stat &lhs, const struct stat &rhs);
+    void insert(const FilePtr &file);
+
+    const size_t capacity_;
+    const double revalidateSeconds_;
+    mutable std::mutex mutex_;
+    FileList lru_;
+    std::unordered_map<std::string, FileList::iterator> files_;
+};
+
+#endif // HTTP_FILECACHE_H
@@ -4,25 +4,21 @@
 #include "HttpContext.h"
 #include "HttpRequest.h"
 #include "HttpResponse.h"
+#include "HttpTemplate.h"
 
 #include <sys/stat.h>
 #include <cmath>
 #include <sstream>
-#include <dirent.h>
 #include <fcntl.h>
-#include <vector>
 #include <functional>
-#include<fstream>
 
 using namespace std;
-void getFileListPage(std::string &fileListHtml, std::string &workPath_, std::string &m_url);
-void getFileListPage(std::string &fileListHtml, std::string &workPath_);
 
-void getFileVec(const std::string dirName, std::vector<std::string> &resVec);
+namespace
+{
 
-            string get404Html(string &msg)
-            {
-                return R"(<!DOCTYPE HTML PUBLIC "-//W3C//DTD HTML 4.01//EN" "http://www.w3.org/TR/html4/strict.dtd">
+// 内置页面启动时编译一次，没有占位符的静态页面直接共享不可变的 Block
+const HttpTemplate kNotFoundPage(R"(<!DOCTYPE HTML PUBLIC "-//W3C//DTD HTML 4.01//EN" "http://www.w3.org/TR/html4/strict.dtd">
 <html>
     <head>
         <meta http-equiv="Content-Type" content="text/html;charset=utf-8">
@@ -31,51 +27,152 @@ void getFileVec(const std::string dirName, std::vector<std::string> &resVec);
     <body>
         <h1>Error response</h1>
         <p>Error code: 404</p>
-        <p>Message:)" + msg +
-                       R"(</p>
+        <p>Message:{{message}}</p>
         <p>Error code explanation: HTTPStatus.NOT_FOUND - Nothing matches the given URI.</p>
     </body>
 </html>
-)";
-            }
+)");
 
-            void scanDir(const string &path, string &list)
-            {
-                // <li><a href="branches/">branches/</a></li>
-                struct stat buffer;
-                struct dirent *dirp; // return value for readdir()
-                DIR *dir;            // return value for opendir()
-
-                char fullname[100];     // to store files full name
-                size_t n = path.size(); // fullname[n]=='\0'
-                strcpy(fullname, path.c_str());
-                if (fullname[n - 1] != '/')
-                {
-                    fullname[n] = '/';
-                    fullname[n + 1] = '\0';
-                    n++;
-                }
+const HttpTemplate kWelcomePage(R"(<!DOCTYPE html>
+<html>
+    <head>
+        <meta charset="UTF-8">
+        <title>WebServer</title>
+    </head>
+    <body>
+    <br/>
+    <br/>
+    <div align="center"><font size="5"> <strong>欢迎访问</strong></font></div>
+	<br/>
+		<br/>
+		<form action="0" method="post">
+ 			<div align="center"><button type="submit">新用户</button></div>
+                </form>
+		<br/>
+                <form action="1" method="post">
+                        <div align="center"><button type="submit" >已有账号</button></div>
+                </form>
+		
+		
+        </div>
+    </body>
+</html>)");
 
-                dir = opendir(path.c_str());
-                if (!dir)
-                    return;
-                while ((dirp = readdir(dir)))
-                {
-                    if (strcmp(dirp->d_name, ".") == 0 || strcmp(dirp->d_name, "..") == 0)
-                        continue;
-                    strcpy(&fullname[n], dirp->d_name);
-                    stat(fullname, &buffer);
-
-                    char name[600];
-                    if (S_ISDIR(buffer.st_mode))
-                        snprintf(name, sizeof(name), "<li><a href=\"%s/\">%s/</a></li>", dirp->d_name, dirp->d_name);
-                    else
-                        snprintf(name, sizeof(name), "<li><a href=\"%s\">%s</a></li>", dirp->d_name, dirp->d_name);
-                    list.append(name);
-                    list.push_back('\n');
-                }
-                closedir(dir);
-            }
+const HttpTemplate kSignUpPage(R"(<!DOCTYPE html>
+<html>
+    <head>
+        <meta charset="UTF-8">
+        <title>Sign up</title>
+    </head>
+    <body>
+<br/>
+<br/>
+    <div align="center"><font size="5"> <strong>注册</strong></font></div>
+    <br/>
+        <div class="login">
+                <form action="3CGISQL.cgi" method="post">
+                        <div align="center"><input type="text" name="user" placeholder="用户名" required="required"></div><br/>
+                        <div align="center"><input type="password" name="password" placeholder="用户密码" required="required"></div><br/>
+                        <div align="center"><button type="submit">注册</button></div>
+                </form>
+        </div>
+    </body>
+</html>)");
+
+const HttpTemplate kSignUpTakenPage(R"(<!DOCTYPE html>
+<html>
+    <head>
+        <meta charset="UTF-8">
+        <title>Sign up</title>
+    </head>
+    <body>
+<br/>
+<br/>
+    <div align="center"><font size="5"> <strong>注册</strong></font></div>
+    <br/>
+        <div class="login">
+                <form action="3CGISQL.cgi" method="post">
+                        <div align="center"><input type="text" name="user" placeholder="用户名" required="required"></div><br/>
+                        <div align="center"><input type="password" name="password" placeholder="用户密码" required="required"></div><br/>
+                        <div align="center"><button type="submit">注册</button></div>
+                </form>
+		<div  align="center">提示：该用户名被注册.</div>
+        </div>
+    </body>
+</html>)");
+
+const HttpTemplate kSignInPage(R"(<!DOCTYPE html>
+<html>
+    <head>
+        <meta charset="UTF-8">
+        <title>Sign in</title>
+    </head>
+    <body>
+<br/>
+<br/>
+    <div align="center"><font size="5"> <strong>登录</strong></font></div>
+    <br/>
+        <div class="login">
+                <form action="2CGISQL.cgi" method="post">
+                        <div align="center"><input type="text" name="user" placeholder="用户名" required="required"></div><br/>
+                        <div align="center"><input type="password" name="password" placeholder="登录密码" required="required"></div><br/>
+                        <div align="center"><button type="submit">确定</button></div>
+                </form>
+        </div>
+    </body>
+</html>)");
+
+const HttpTemplate kSignInFailedPage(R"(<!DOCTYPE html>
+<html>
+    <head>
+        <meta charset="UTF-8">
+        <title>Sign in</title>
+    </head>
+    <body>
+<br/>
+<br/>
+    <div align="center"><font size="5"> <strong>登录</strong></font></div>
+    <br/>
+        <div class="login">
+                <form action="2CGISQL.cgi" method="post">
+                        <div align="center"><input type="text" name="user" placeholder="用户名" required="required"></div><br/>
+                        <div align="center"><input type="password" name="password" placeholder="登录密码" required="required"></div><br/>
+                        <div align="center"><button type="submit">确定</button></div>
+                </form>
+		<br/>
+               <div  align="center">提示：用户名或密码错误，请重试</div>
+        </div>
+    </body>
+</html>)");
+
+const HttpTemplate kResultPage(R"(<!DOCTYPE html>
+<html>
+    <head>
+        <meta charset="UTF-8">
+        <title>WebServer</title>
+    </head>
+    <body>
+    <br/>
+    <br/>
+    <div align="center"><font size="5"> <strong>{{message}}</strong></font></div>
+	<br/>
+		<br/>
+		
+        </div>
+    </body>
+</html>)");
+
+// 固定提示信息的页面也预先渲染好
+const std::string kFileNotFound = "File not found.";
+const std::string kNotRegularFile = "This is not a regular file.";
+const std::string kUploaded = "上传成功";
+const std::string kDeleted = "删除成功";
+const HttpTemplate::Block kFileNotFoundBlock = kNotFoundPage.renderBlock({kFileNotFound});
+const HttpTemplate::Block kNotRegularFileBlock = kNotFoundPage.renderBlock({kNotRegularFile});
+const HttpTemplate::Block kUploadedBlock = kResultPage.renderBlock({kUploaded});
+const HttpTemplate::Block kDeletedBlock = kResultPage.renderBlock({kDeleted});
+
+} // namespace
 
 
 pthread_once_t MimeType::once_control = PTHREAD_ONCE_INIT;
@@ -140,11 +237,27 @@ FileServer::FileServer(const string &path,
                        const string &name,
                        TcpServer::Option option)
     : workPath_(path),
-      server_(loop, listenAddr, name, option)
+      server_(loop, listenAddr, name, option),
+      idleTimeout_(60.0),
+      headerTimeout_(10.0),
+      bodyTimeout_(600.0),
+      dirIndex_(loop, "html/filelist.html")
 {
     server_.setConnectionCallback(std::bind(&FileServer::onConnection, this, std::placeholders::_1));
     server_.setMessageCallback(std::bind(&FileServer::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    // 其他进程修改了被监视目录中的文件，让文件缓存立即失效
+    dirIndex_.setChangeCallback(std::bind(&FileCache::invalidate, &fileCache_, std::placeholders::_1));
     server_.setThreadNum(8);
+    // 大文件上传下载时读写经常一次处理不完，边缘触发省掉反复开关 EPOLLOUT 的 epoll_ctl
+    server_.setEdgeTriggered(true);
+    // 大文件下载会长时间占住一个 subLoop，新连接优先分给待发送数据少的
+    server_.setBalancePolicy(EventLoopThreadPool::kLeastPendingBytes);
+    // 空闲和读超时由每个 subLoop 的 TimeoutWheel 检查，半开连接和慢速客户端会被批量关闭
+    server_.setIdleTimeout(idleTimeout_);
+    // 慢速下载和流水线请求的客户端积压响应时暂停读请求，响应发得差不多了再继续读
+    server_.setFlowControl(8 * 1024 * 1024, 2 * 1024 * 1024);
+    // 优雅关闭时等正在进行的下载发送完
+    server_.setDrainCallback(std::bind(&FileServer::onDrain, this, std::placeholders::_1));
     m_connPool = ConnectionPool::getConnectionPool();
 }
 
@@ -159,7 +272,44 @@ void FileServer::onConnection(const TcpConnectionPtr &conn)
 {
     if (conn->connected())
     {
-        conn->setContext(HttpContext());
+        HttpContext context;
+        // 上传的临时文件放在工作目录下，完成后可以直接 rename 到目标位置
+        context.setUploadDir(workPath_);
+        conn->setContext(context);
+    }
+    else
+    {
+        // 请求体中途断开时删除已经写入的上传临时文件
+        HttpContext *context = boost::any_cast<HttpContext>(conn->getMutableContext());
+        if (context)
+            context->reset();
+    }
+}
+
+// 两个请求之间的连接发完已有的响应(包括 sendfile)就关闭，正在接收的请求处理完后关闭
+void FileServer::onDrain(const TcpConnectionPtr &conn)
+{
+    HttpContext *context = boost::any_cast<HttpContext>(conn->getMutableContext());
+    if (context == nullptr || context->readPhase() == HttpContext::kBetweenRequests)
+        conn->shutdown();
+}
+
+// 按请求的接收阶段设置读超时，两个请求之间只有空闲超时
+void FileServer::updateReadTimeout(const TcpConnectionPtr &conn, HttpContext *context, Buffer *buf)
+{
+    if (!conn->connected() || !context->updateReadPhase(buf))
+        return;
+    switch (context->readPhase())
+    {
+        case HttpContext::kReadingHead:
+            conn->setReadTimeout(headerTimeout_);
+            break;
+        case HttpContext::kReadingBody:
+            conn->setReadTimeout(bodyTimeout_);
+            break;
+        default:
+            conn->setReadTimeout(0);
+            break;
     }
 }
 
@@ -170,16 +320,23 @@ void FileServer::onMessage(const TcpConnectionPtr &conn,
     HttpContext *context = boost::any_cast<HttpContext>(conn->getMutableContext());
     // std::cout<<"浏览器发来的请求报文："<<std::endl;
     // std::cout<<buf->GetBufferAllAsString()<<endl;
-    if (!context->parseRequest(buf, receiveTime))  //反序列化（解析）为request
-    {
-        conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
-        conn->shutdown();
-    }
-    if (context->gotAll())
+    // 长连接上可能一次读到多个流水线请求，按顺序逐个处理
+    while (conn->connected())
     {
+        if (!context->parseRequest(buf, receiveTime))  //反序列化（解析）为request
+        {
+            conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
+            conn->shutdown();
+            // 出错前已经收完的文件项不会再被处理，临时文件在这里删除
+            context->reset();
+            break;
+        }
+        if (!context->gotAll())
+            break;
         onRequest(conn, context->request());
         context->reset();
     }
+    updateReadTimeout(conn, context, buf);
 }
 
 extern char favicon[555];
@@ -190,9 +347,7 @@ void FileServer::onRequest(const TcpConnectionPtr &conn, const HttpRequest &req)
         LOG_WARN << "Http 1.0";
     else
         LOG_WARN << "Http 1.1";
-    const string &connection = req.getHeader("Connection");
-    bool close = connection == "close" ||
-                 (req.getVersion() == HttpRequest::kHttp10 && connection != "Keep-Alive");
+    bool close = !req.keepAlive() || conn->draining();
     HttpResponse response(close);
 
     // 网站图标
@@ -205,22 +360,11 @@ void FileServer::onRequest(const TcpConnectionPtr &conn, const HttpRequest &req)
     }
     else
         setResponseBody(req, response);
+    if (!response.closeConnection())
+        response.addHeader("Keep-Alive", "timeout=" + std::to_string(static_cast<int>(idleTimeout_)));
 
-    Buffer buf;
-    response.appendToBuffer(&buf);
-    // std::cout<<"buffer中的数据"<<std::endl;
-    // std::string request = buf.GetBufferAllAsString();
-    // std::cout << request << std::endl;
-    conn->send(&buf);
-    if (response.needSendFile())
-    {
-        // 需要发送文件
-        int fd = response.getFd();
-        size_t needLen = static_cast<size_t>(response.getSendLen());
-        // std::cout<<"onRequest"<<std::endl;
-        // std::cout<<fd<<" "<<needLen<<std::endl;
-        conn->sendFile(fd, needLen);
-    }
+    // 响应头、响应体和文件按顺序排进连接的发送队列，大的响应体不拷贝
+    response.sendTo(conn);
 
     if (response.closeConnection())
     {
@@ -231,56 +375,30 @@ void FileServer::onRequest(const TcpConnectionPtr &conn, const HttpRequest &req)
 void FileServer::setResponseBody(const HttpRequest &req, HttpResponse &res)
 {
     // static const off64_t maxSendLen = 1024 * 1024 * 100;
-    string path = workPath_ + req.path();
-    string m_url = req.path();
+    string m_url = req.path().as_string();
+    string path = workPath_ + m_url;
     // if(m_url == "/") m_url = path;
     struct stat buffer;
     // std::cout<<"path:"<<path<<std::endl;
     // std::cout<<"m_url:"<<m_url<<std::endl;
     
-    if (stat(path.c_str(), &buffer) == 0)  //返回-1，文件不存在
+    // 命中文件缓存时不需要 stat/open
+    FileCache::FilePtr file = fileCache_.get(path);
+    if (file)  //返回空，文件不存在
     {
+        buffer = file->st;
         if (S_ISDIR(buffer.st_mode))
         { // 目录
             std::cout<<" 目录文件"<<std::endl;
             //TODO 
             if (strlen(m_url.c_str()) == 1) {
-                string html;
-                html = R"(<!DOCTYPE html>
-<html>
-    <head>
-        <meta charset="UTF-8">
-        <title>WebServer</title>
-    </head>
-    <body>
-    <br/>
-    <br/>
-    <div align="center"><font size="5"> <strong>欢迎访问</strong></font></div>
-	<br/>
-		<br/>
-		<form action="0" method="post">
- 			<div align="center"><button type="submit">新用户</button></div>
-                </form>
-		<br/>
-                <form action="1" method="post">
-                        <div align="center"><button type="submit" >已有账号</button></div>
-                </form>
-		
-		
-        </div>
-    </body>
-</html>)";
-
                 res.setStatusCode(HttpResponse::k200Ok);
                 res.setContentType("text/html;charset=utf-8");
-                res.setBody(html);
+                res.setBody(kWelcomePage.block());
             } else{ 
-            string list, show_path = path[0] == '.' ? path.substr(1) : path;
-            // std::cout<<" list before scan "<<list<<std::endl;
-            scanDir(path, list);
-            // std::cout<<"show_path "<<show_path<<std::endl<<" list "<<list<<std::endl;
-            string html;
-            getFileListPage(html, show_path, m_url);
+            // 目录索引由 inotify 维护，页面已经渲染好
+            HttpTemplate::Block html;
+            dirIndex_.render(path, m_url, html);
             res.setStatusCode(HttpResponse::k200Ok);
             res.setContentType("text/html;charset=utf-8");
             res.setBody(html);
@@ -289,16 +407,18 @@ void FileServer::setResponseBody(const HttpRequest &req, HttpResponse &res)
         else if (S_ISREG(buffer.st_mode))
         { // 常规文件
             std::cout<<" 常规文件"<<std::endl;
-            int fd = ::open(path.c_str(), O_RDONLY);
+            // fd 归文件缓存所有，响应持有引用直到 sendfile 结束
+            int fd = file->fd;
 
             // off64_t len = lseek(fd, 0, SEEK_END) - lseek(fd, 0, SEEK_SET);
             off64_t len = buffer.st_size;
             res.setFd(fd);
+            res.setFdHolder(file);
 
             string suffix;
-            size_t pos = req.path().find_last_of('.');
-            if (pos != req.path().npos)
-                suffix = req.path().substr(pos);
+            size_t pos = m_url.find_last_of('.');
+            if (pos != m_url.npos)
+                suffix = m_url.substr(pos);
             else
                 suffix = "";
             LOG_DEBUG << "File suffix: " << suffix;
@@ -307,7 +427,7 @@ void FileServer::setResponseBody(const HttpRequest &req, HttpResponse &res)
             res.setContentType(type);
             res.addHeader("Accept-Ranges", "bytes");
 
-            string range = req.getHeader("Range");
+            string range = req.getHeader("Range").as_string();
             // cout<<"range"<<endl;
             // cout<<range<<endl;
             if (range != "")
@@ -317,7 +437,7 @@ void FileServer::setResponseBody(const HttpRequest &req, HttpResponse &res)
                 res.setStatusMessage("Partial Content");
 
                 off64_t beg_num = 0, end_num = 0;
-                string range_value = req.getHeader("Range").substr(6);
+                string range_value = range.substr(6);
                 pos = range_value.find("-");
                 string beg = range_value.substr(0, pos);
                 string end = range_value.substr(pos + 1);
@@ -341,8 +461,8 @@ void FileServer::setResponseBody(const HttpRequest &req, HttpResponse &res)
                 // off64_t need_len = std::min(end_num - beg_num + 1, maxSendLen);
                 off64_t need_len = end_num - beg_num + 1;
                 end_num = beg_num + need_len - 1;
-                lseek(fd, beg_num, SEEK_SET);
-                res.setSendLen(static_cast<int>(need_len));
+                res.setSendOffset(beg_num);
+                res.setSendLen(need_len);
 
                 std::ostringstream os_range;
                 os_range << "bytes " << beg_num << "-" << end_num << "/" << len;
@@ -365,65 +485,18 @@ void FileServer::setResponseBody(const HttpRequest &req, HttpResponse &res)
             // 非常规文件
             res.setStatusCode(HttpResponse::k404NotFound);
             res.setContentType("text/html;charset=utf-8");
-            string msg = "This is not a regular file.";
-            std::cout<<msg<<std::endl;
-            res.setBody(get404Html(msg));
+            std::cout<<kNotRegularFile<<std::endl;
+            res.setBody(kNotRegularFileBlock);
         }
     } else if (m_url[1] == '0')
     {
-        string html;
-                html = R"(<!DOCTYPE html>
-<html>
-    <head>
-        <meta charset="UTF-8">
-        <title>Sign up</title>
-    </head>
-    <body>
-<br/>
-<br/>
-    <div align="center"><font size="5"> <strong>注册</strong></font></div>
-    <br/>
-        <div class="login">
-                <form action="3CGISQL.cgi" method="post">
-                        <div align="center"><input type="text" name="user" placeholder="用户名" required="required"></div><br/>
-                        <div align="center"><input type="password" name="password" placeholder="用户密码" required="required"></div><br/>
-                        <div align="center"><button type="submit">注册</button></div>
-                </form>
-        </div>
-    </body>
-</html>)";
-                // std::cout<<"html:"<<html<<std::endl;
-
                 res.setStatusCode(HttpResponse::k200Ok);
                 res.setContentType("text/html;charset=utf-8");
-                res.setBody(html);
+                res.setBody(kSignUpPage.block());
     } else if (m_url[1] == '1') {
-        string html;
-                html = R"(<!DOCTYPE html>
-<html>
-    <head>
-        <meta charset="UTF-8">
-        <title>Sign in</title>
-    </head>
-    <body>
-<br/>
-<br/>
-    <div align="center"><font size="5"> <strong>登录</strong></font></div>
-    <br/>
-        <div class="login">
-                <form action="2CGISQL.cgi" method="post">
-                        <div align="center"><input type="text" name="user" placeholder="用户名" required="required"></div><br/>
-                        <div align="center"><input type="password" name="password" placeholder="登录密码" required="required"></div><br/>
-                        <div align="center"><button type="submit">确定</button></div>
-                </form>
-        </div>
-    </body>
-</html>)";
-                //std::cout<<"html:"<<html<<std::endl;
-
                 res.setStatusCode(HttpResponse::k200Ok);
                 res.setContentType("text/html;charset=utf-8");
-                res.setBody(html);
+                res.setBody(kSignInPage.block());
     } else if (m_url[1] == '2' || m_url[1] == '3') {
         // std::cout << users.size() <<std::endl;
         // for(auto it : users) {
@@ -459,94 +532,24 @@ void FileServer::setResponseBody(const HttpRequest &req, HttpResponse &res)
                 ins = conn->update(sql_insert);
                 users.insert(pair<string, string>(name, password));
             }
-            string html;
-                if (ins) {
-                html = R"(<!DOCTYPE html>
-<html>
-    <head>
-        <meta charset="UTF-8">
-        <title>Sign in</title>
-    </head>
-    <body>
-<br/>
-<br/>
-    <div align="center"><font size="5"> <strong>登录</strong></font></div>
-    <br/>
-        <div class="login">
-                <form action="2CGISQL.cgi" method="post">
-                        <div align="center"><input type="text" name="user" placeholder="用户名" required="required"></div><br/>
-                        <div align="center"><input type="password" name="password" placeholder="登录密码" required="required"></div><br/>
-                        <div align="center"><button type="submit">确定</button></div>
-                </form>
-        </div>
-    </body>
-</html>)";
-                }
-                    
-                else {
-                html = R"(<!DOCTYPE html>
-<html>
-    <head>
-        <meta charset="UTF-8">
-        <title>Sign up</title>
-    </head>
-    <body>
-<br/>
-<br/>
-    <div align="center"><font size="5"> <strong>注册</strong></font></div>
-    <br/>
-        <div class="login">
-                <form action="3CGISQL.cgi" method="post">
-                        <div align="center"><input type="text" name="user" placeholder="用户名" required="required"></div><br/>
-                        <div align="center"><input type="password" name="password" placeholder="用户密码" required="required"></div><br/>
-                        <div align="center"><button type="submit">注册</button></div>
-                </form>
-		<div  align="center">提示：该用户名被注册.</div>
-        </div>
-    </body>
-</html>)";  
-                    
-            }
             res.setStatusCode(HttpResponse::k200Ok);
             res.setContentType("text/html;charset=utf-8");
-            res.setBody(html);
+            res.setBody(ins ? kSignInPage.block() : kSignUpTakenPage.block());
         }
 
         else if(m_url[1] == '2') {
-            string html;
+            HttpTemplate::Block html;
             //std::cout << "m_url[1] == '2'" <<std::endl;
             if (users.find(name) != users.end() && users[name] == password) {
             // string path = workPath_;
             // string list, html, show_path = path[0] == '.' ? path.substr(1) : path;
             // std::cout<< "path:" << path <<std::endl;
             // std::cout<< show_path <<std::endl;
-            // scanDir(path, list);
-            getFileListPage(html, workPath_);
+            dirIndex_.render(workPath_, string(), html);
             //std::cout<< "html:" << html <<std::endl;
             }
             else {
-                html = R"(<!DOCTYPE html>
-<html>
-    <head>
-        <meta charset="UTF-8">
-        <title>Sign in</title>
-    </head>
-    <body>
-<br/>
-<br/>
-    <div align="center"><font size="5"> <strong>登录</strong></font></div>
-    <br/>
-        <div class="login">
-                <form action="2CGISQL.cgi" method="post">
-                        <div align="center"><input type="text" name="user" placeholder="用户名" required="required"></div><br/>
-                        <div align="center"><input type="password" name="password" placeholder="登录密码" required="required"></div><br/>
-                        <div align="center"><button type="submit">确定</button></div>
-                </form>
-		<br/>
-               <div  align="center">提示：用户名或密码错误，请重试</div>
-        </div>
-    </body>
-</html>)";
+                html = kSignInFailedPage.block();
             }
             res.setStatusCode(HttpResponse::k200Ok);
             res.setContentType("text/html;charset=utf-8");
@@ -555,7 +558,6 @@ void FileServer::setResponseBody(const HttpRequest &req, HttpResponse &res)
         }
         
     } else if (m_url[1] == 'd' && m_url[2] == 'o') {
-        struct stat buffer;
         // std::cout<<" 常规文件"<<std::endl;
         // std::cout<<path<<std::endl;
         // std::cout<<m_url<<std::endl;
@@ -563,21 +565,28 @@ void FileServer::setResponseBody(const HttpRequest &req, HttpResponse &res)
         string dl_path = path.substr(0, n_d);
         string dl_url = m_url.substr(10);
         string download_path = dl_path + dl_url;
-        stat(download_path.c_str(), &buffer);
         std::cout<<download_path<<std::endl;
-        int fd = ::open(download_path.c_str(), O_RDONLY);
+        FileCache::FilePtr dl_file = fileCache_.get(download_path);
+        if (!dl_file || dl_file->fd < 0)
+        {
+            res.setStatusCode(HttpResponse::k404NotFound);
+            res.setContentType("text/html;charset=utf-8");
+            res.setBody(kFileNotFoundBlock);
+            return;
+        }
 
         // off64_t len = lseek(fd, 0, SEEK_END) - lseek(fd, 0, SEEK_SET);
-        off64_t len = buffer.st_size;
-        res.setFd(fd);
+        off64_t len = dl_file->st.st_size;
+        res.setFd(dl_file->fd);
+        res.setFdHolder(dl_file);
 
         string suffix;
-        size_t pos = req.path().find_last_of('.');
+        size_t pos = m_url.find_last_of('.');
         size_t f_pos = download_path.find_last_of('/');
         string f_name = download_path.substr(f_pos + 1);
         std::cout<<f_name<<std::endl;
-        if (pos != req.path().npos)
-            suffix = req.path().substr(pos);
+        if (pos != m_url.npos)
+            suffix = m_url.substr(pos);
         else
             suffix = "";
         LOG_DEBUG << "File suffix: " << suffix;
@@ -587,7 +596,7 @@ void FileServer::setResponseBody(const HttpRequest &req, HttpResponse &res)
         res.addHeader("Accept-Ranges", "bytes");
         res.setDisposition(f_name);
 
-        string range = req.getHeader("Range");
+        string range = req.getHeader("Range").as_string();
 
         std::cout<<" 非range传送"<<std::endl;
         res.setStatusCode(HttpResponse::k200Ok);
@@ -595,66 +604,41 @@ void FileServer::setResponseBody(const HttpRequest &req, HttpResponse &res)
         res.setSendLen(len);
         res.addHeader("Content-Length", std::to_string(len));
     } else if (m_url[1] == 'u') {
-        std::string body = req.m_string;
-        int n = body.find("-----------------");
-        std::string content = body.substr(0, n);
-        //std::cout<<"文件内容"<<std::endl;
-        // std::cout<<content<<std::endl;
-        auto headers = req.headers();
-        std::cout<<headers["Content-Disposition"]<<std::endl;
-        std::string content_type = headers["Content-Type"];
-        std::cout<<content_type<<std::endl;
+        // 文件数据已经由 HttpContext 流式写入临时文件，这里只需要 rename 到目标目录
         std::string f_url = path;
-        n = path.find(m_url);
+        int n = path.find(m_url);
         f_url = path.substr(0, n);
         std::cout<<f_url<<std::endl;
-        n = headers["Content-Disposition"].find("filename=");
-        std::string f_name = headers["Content-Disposition"].substr(n + 10);
-        f_name = f_name.substr(0, f_name.size() - 1);
-        std::cout<<f_name<<std::endl;
-        
 
         string path_u;
-        if(content_type == "image/jpeg" || content_type == "image/png") {
-            path = f_url + "/img/" + f_name;
-            path_u = f_url + "/img/";
-        } else {
-                path = f_url + "/text/" + f_name;
-                path_u = f_url + "/text/";  
+        for (const HttpRequest::FormPart &part : req.parts())
+        {
+            if (part.filename.empty() || part.tmpPath.empty())
+                continue;
+            // 只取文件名部分，防止 filename 中带有路径
+            std::string f_name = part.filename.substr(part.filename.find_last_of("/\\") + 1);
+            std::cout<<part.contentType<<" "<<f_name<<std::endl;
+            if(part.contentType == "image/jpeg" || part.contentType == "image/png") {
+                path_u = f_url + "/img/";
+            } else {
+                path_u = f_url + "/text/";
+            }
+            path = path_u + f_name;
+            std::cout<<path<<std::endl;
+            if (::rename(part.tmpPath.c_str(), path.c_str()) < 0)
+            {
+                LOG_ERROR << "rename " << part.tmpPath << " to " << path << " failed, errno = " << errno;
+            }
+            else
+            {
+                dirIndex_.addEntry(path_u, f_name);
+            }
+            fileCache_.invalidate(path);
         }
-        std::cout<<path<<std::endl;
-        ofstream os(path.c_str());     //创建一个文件输出流对象
-        if(!os.is_open())
-       {
-         std::cout<<"failed"<<std::endl;
-       }  
-        os.write(content.c_str(),content.size());
-        os.close();
-
-        string list, show_path = path_u[0] == '.' ? path_u.substr(1) : path_u;
-        std::cout<<" list before scan "<<list<<std::endl;
-        scanDir(path_u, list);
-        std::cout<<"show_path "<<show_path<<std::endl<<" list "<<list<<std::endl;
-        string html;
-        html = R"(<!DOCTYPE html>
-<html>
-    <head>
-        <meta charset="UTF-8">
-        <title>WebServer</title>
-    </head>
-    <body>
-    <br/>
-    <br/>
-    <div align="center"><font size="5"> <strong>上传成功</strong></font></div>
-	<br/>
-		<br/>
-		
-        </div>
-    </body>
-</html>)";
+
         res.setStatusCode(HttpResponse::k200Ok);
         res.setContentType("text/html;charset=utf-8"); 
-        res.setBody(html);
+        res.setBody(kUploadedBlock);
     } else if (m_url[1] == 'd' && m_url[2] == 'e') {
         // std::cout<<" 常规文件"<<std::endl;
         // std::cout<<path<<std::endl;
@@ -664,10 +648,14 @@ void FileServer::setResponseBody(const HttpRequest &req, HttpResponse &res)
         string dl_url = m_url.substr(8);
         std::string f_url = path;
         string download_path = dl_path + dl_url;
-        stat(download_path.c_str(), &buffer);
         std::cout<<download_path<<std::endl;
+        int n_u = download_path.find_last_of("/");
+        string path_d = download_path.substr(0, n_u + 1);
+        std::cout<<path_d<<std::endl;
         if(remove(download_path.c_str())==0)
         {
+            fileCache_.invalidate(download_path);
+            dirIndex_.removeEntry(path_d, download_path.substr(n_u + 1));
             cout<<"删除成功"<<endl;
         }
         else
@@ -675,47 +663,17 @@ void FileServer::setResponseBody(const HttpRequest &req, HttpResponse &res)
             cout<<"删除失败"<<endl;
         }
 
-        auto headers = req.headers();
-        std::string content_type = headers["Content-Type"];
-        std::cout<<content_type<<std::endl;
-        int n_u = download_path.find_last_of("/");
-        string path_d = download_path.substr(0, n_u + 1);
-
-        std::cout<<path_d<<std::endl;
-
-        string list, show_path = path_d[0] == '.' ? path_d.substr(1) : path_d;
-        std::cout<<" list before scan "<<list<<std::endl;
-        scanDir(path_d, list);
-        std::cout<<"show_path "<<show_path<<std::endl<<" list "<<list<<std::endl;
-        string html;
-        html = R"(<!DOCTYPE html>
-<html>
-    <head>
-        <meta charset="UTF-8">
-        <title>WebServer</title>
-    </head>
-    <body>
-    <br/>
-    <br/>
-    <div align="center"><font size="5"> <strong>删除成功</strong></font></div>
-	<br/>
-		<br/>
-		
-        </div>
-    </body>
-</html>)";
         res.setStatusCode(HttpResponse::k200Ok);
         res.setContentType("text/html;charset=utf-8"); 
-        res.setBody(html);
+        res.setBody(kDeletedBlock);
     }
     
     else // 路径不存在，返回 404
     {
         res.setStatusCode(HttpResponse::k404NotFound);
         res.setContentType("text/html;charset=utf-8");
-        string msg = "File not found.";
-        std::cout<<msg<<std::endl;
-        res.setBody(get404Html(msg));
+        std::cout<<kFileNotFound<<std::endl;
+        res.setBody(kFileNotFoundBlock);
     }
 }
 
@@ -723,101 +681,6 @@ void FileServer::setResponseBody(const HttpRequest &req, HttpResponse &res)
 
 
 
-// 以下两个函数用来构建文件列表的页面，最终结果保存到 fileListHtml 中
-void getFileListPage(std::string &fileListHtml, std::string &workPath_, std::string &m_url){
-    // 结果保存到 fileListHtml
-
-    // 将指定目录内的所有文件保存到 fileVec 中
-    std::vector<std::string> fileVec;
-    getFileVec(workPath_, fileVec);
-    
-    // 构建页面
-    std::ifstream fileListStream("html/filelist.html", std::ios::in); //输入文件流
-    std::string tempLine;
-    // 首先读取文件列表的 <!--filelist_label--> 注释前的语句
-    while(1){
-        getline(fileListStream, tempLine);
-        if(tempLine == "<!--filelist_label-->"){
-            break;
-        }
-        fileListHtml += tempLine + "\n";
-    }
-
-    // 根据如下标签，将将文件夹中的所有文件项添加到返回页面中
-    //             <tr><td class="col1">filenamename</td> <td class="col2"><a href="file/filename">下载</a></td> <td class="col3"><a href="delete/filename">删除</a></td></tr>
-    for(const auto &filename : fileVec){
-        // fileListHtml += "            <tr><td class=\"col1\">" + filename +
-        //             "</td> <td class=\"col2\"><a href=\"download/" + filename +
-        //             "\">下载</a></td> <td class=\"col3\"><a href=\"delete/" + filename +
-        //             "\" onclick=\"return confirmDelete();\">删除</a></td></tr>" + "\n";
-        fileListHtml += "            <tr><td class=\"col1\"><a href=" + m_url  + "/" + filename + ">"
-                    + filename + "</a></td> <td class=\"col2\"><a href=\"download" + m_url  + "/"  + filename +
-                    "\">下载</a></td> <td class=\"col3\"><a href=\"delete" + m_url  + "/" + filename +
-                    "\" onclick=\"return confirmDelete();\">删除</a></td></tr>" + "\n";
-    }                                 //           <a href=\"%s/\">%s/</a>
-
-    // 将文件列表注释后的语句加入后面
-    while(getline(fileListStream, tempLine)){
-        fileListHtml += tempLine + "\n";
-    }
-    
-}
-
-void getFileListPage(std::string &fileListHtml, std::string &workPath_){
-    // 结果保存到 fileListHtml
-
-    // 将指定目录内的所有文件保存到 fileVec 中
-    std::vector<std::string> fileVec;
-    getFileVec(workPath_, fileVec);
-    
-    // 构建页面
-    std::ifstream fileListStream("html/filelist.html", std::ios::in); //输入文件流
-    std::string tempLine;
-    // 首先读取文件列表的 <!--filelist_label--> 注释前的语句
-    while(1){
-        getline(fileListStream, tempLine);
-        if(tempLine == "<!--filelist_label-->"){
-            break;
-        }
-        fileListHtml += tempLine + "\n";
-    }
-
-    // 根据如下标签，将将文件夹中的所有文件项添加到返回页面中
-    //             <tr><td class="col1">filenamename</td> <td class="col2"><a href="file/filename">下载</a></td> <td class="col3"><a href="delete/filename">删除</a></td></tr>
-    for(const auto &filename : fileVec){
-        fileListHtml += "            <tr><td class=\"col1\"><a href="  + filename + ">"
-                    + filename + "</a></td> <td class=\"col2\"></td> <td class=\"col3\"></td></tr>" + "\n";
-        // fileListHtml += "            <tr><td><a href="  + filename + ">"
-        //             + filename + "</a></td> </tr>" + "\n";
-    }                                 
-
-    // 将文件列表注释后的语句加入后面
-    while(getline(fileListStream, tempLine)){
-        fileListHtml += tempLine + "\n";
-    }
-    
-}
-
-
-void getFileVec(const std::string dirName, std::vector<std::string> &resVec){
-    // 使用 dirent 获取文件目录下的所有文件
-    DIR *dir;   // 目录指针
-    dir = opendir(dirName.c_str());
-    struct dirent *stdinfo;
-    while (1)
-    {
-        // 获取文件夹中的一个文件
-        stdinfo = readdir(dir);
-        if (stdinfo == nullptr){
-            break;
-        }
-        resVec.push_back(stdinfo->d_name);
-        if(resVec.back() == "." || resVec.back() == ".."){
-            resVec.pop_back();
-        }
-    }
-}
-
 char favicon[555] = {
   '\x89', 'P', 'N', 'G', '\xD', '\xA', '\x1A', '\xA',
   '\x0', '\x0', '\x0', '\xD', 'I', 'H', 'D', 'R',
@@ -5,11 +5,14 @@
 #include <map>
 #include <string>
 #include "ConnectionPool.h"
+#include "FileCache.h"
+#include "DirIndex.h"
 #include <mutex>
 #include <memory>
 
         class HttpRequest;
         class HttpResponse;
+        class HttpContext;
 
         class MimeType
         {
@@ -43,19 +46,38 @@
             EventLoop *getLoop() const { return server_.getLoop(); }
 
             void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+            // 设置长连接空闲超时时间(秒)，超时没有收发数据则关闭连接，需要在 start 之前设置
+            void setIdleTimeout(double seconds) { idleTimeout_ = seconds; server_.setIdleTimeout(seconds); }
+            // 待发送的数据(包括文件)超过 highWaterMark 时暂停读请求，发送到 lowWaterMark 以下时恢复，需要在 start 之前设置
+            void setFlowControl(size_t highWaterMark, size_t lowWaterMark) { server_.setFlowControl(highWaterMark, lowWaterMark); }
+            // 请求行和首部、请求体分别必须在多少秒内收完，0 表示不限制
+            void setHeaderTimeout(double seconds) { headerTimeout_ = seconds; }
+            void setBodyTimeout(double seconds) { bodyTimeout_ = seconds; }
             void start();
             void sql_pool();
 
+            // 优雅关闭和热重启，见 TcpServer::drain、ListenerHandoff
+            void drain(double timeoutSeconds, const std::function<void()> &done) { server_.drain(timeoutSeconds, done); }
+            std::vector<int> listenFds() const { return server_.listenFds(); }
+            void adoptListenFds(const std::vector<int> &fds) { server_.adoptListenFds(fds); }
+
         private:
             void onMessage(const TcpConnectionPtr &conn,
                            Buffer *buf,
                            Timestamp receiveTime);
             void onRequest(const TcpConnectionPtr &, const HttpRequest &);
             void onConnection(const TcpConnectionPtr &conn);
+            void onDrain(const TcpConnectionPtr &conn);
+            void updateReadTimeout(const TcpConnectionPtr &conn, HttpContext *context, Buffer *buf);
             void setResponseBody(const HttpRequest &, HttpResponse &);
 
             std::string workPath_;
             TcpServer server_;
+            double idleTimeout_;
+            double headerTimeout_;
+            double bodyTimeout_;    // 上传大文件需要的时间长，默认比 HttpServer 宽松
+            FileCache fileCache_;   // 所有 subLoop 共享的已打开文件缓存
+            DirIndex dirIndex_;     // 目录列表索引，inotify 事件在 baseLoop 处理
             //数据库相关
             ConnectionPool *m_connPool;
             int m_sql_num;
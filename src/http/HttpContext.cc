@@ -1,12 +1,21 @@
 #include "HttpContext.h"
 #include "Buffer.h"
+#include "ByteScan.h"
+#include "Logging.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <stdint.h>
+#include <ctype.h>
 
 // 解析请求行
 bool HttpContext::processRequestLine(const char *begin, const char *end)
 {
     bool succeed = false;
     const char *start = begin;
-    const char *space = std::find(start, end, ' ');
+    const char *space = ByteScan::findByte(start, end, ' ');
 
     // 不是最后一个空格，并且成功获取了method并设置到request_
     if (space != end && request_.setMethod(start, space))
@@ -14,11 +23,11 @@ bool HttpContext::processRequestLine(const char *begin, const char *end)
         // 跳过空格
         start = space+1;
         // 继续寻找下一个空格
-        space = std::find(start, end, ' ');
+        space = ByteScan::findByte(start, end, ' ');
         if (space != end)
         {
             // 查看是否有请求参数
-            const char* question = std::find(start, space, '?');
+            const char* question = ByteScan::findByte(start, space, '?');
             if (question != space)
             {
                 // 设置访问路径
@@ -53,13 +62,258 @@ bool HttpContext::processRequestLine(const char *begin, const char *end)
     return succeed;
 }
 
+namespace
+{
+
+// 从 Content-Disposition / Content-Type 这类 "a; k1=v1; k2="v2"" 的首部值中取出参数 key 的值
+std::string getHeaderParam(const std::string &value, const char *key)
+{
+    size_t keyLen = strlen(key);
+    size_t pos = value.find(';');
+    while (pos != std::string::npos)
+    {
+        size_t begin = value.find_first_not_of(' ', pos + 1);
+        size_t end = value.find(';', begin);
+        if (begin == std::string::npos)
+        {
+            break;
+        }
+        if (value.compare(begin, keyLen, key) == 0 && value.size() > begin + keyLen && value[begin + keyLen] == '=')
+        {
+            std::string param = value.substr(begin + keyLen + 1,
+                end == std::string::npos ? std::string::npos : end - begin - keyLen - 1);
+            // 去掉两边的引号
+            if (param.size() >= 2 && param.front() == '"' && param.back() == '"')
+            {
+                param = param.substr(1, param.size() - 2);
+            }
+            return param;
+        }
+        pos = end;
+    }
+    return std::string();
+}
+
+} // namespace
+
+HttpContext::PartFile::~PartFile()
+{
+    ::close(fd);
+    // 没有完整写完的文件直接删除
+    if (!done)
+    {
+        ::unlink(path.c_str());
+    }
+}
+
+// 请求体的消费都要经过这里，保证不会越过 Content-Length 读到下一个请求
+void HttpContext::retrieveBody(Buffer *buf, size_t len)
+{
+    buf->retrieve(len);
+    bodyRemaining_ -= len;
+}
+
+/**
+ * 一次扫描找出缓冲区中已有的所有首部行，首部记录为 Buffer 中的偏移，数据留在 Buffer 中
+ * 空行表示首部结束，这时才把请求行和首部一起从 Buffer 中取走
+ * 数据不够时 hasMore 置为 false，返回 false 表示格式错误
+ */
+bool HttpContext::processHeaders(Buffer *buf, bool *hasMore)
+{
+    const char *lineStart = buf->peek() + headScanned_;
+    const char *lineEnds[kLineBatch];
+    size_t lines = ByteScan::findLines(lineStart, buf->beginWrite(), lineEnds, kLineBatch);
+    if (lines < kLineBatch)
+    {
+        // 缓冲区中的行已经全部找到，处理完之后需要等待后续数据
+        *hasMore = false;
+    }
+    for (size_t i = 0; i < lines; ++i)
+    {
+        const char *crlf = lineEnds[i];
+        if (crlf == lineStart)
+        {
+            headLen_ = headScanned_ + 2;
+            // 取走后内存中的数据不会立即被覆盖，本次 parseRequest 内视图仍然有效
+            buf->retrieve(headLen_);
+            bool ok = processHeadersDone();
+            *hasMore = ok;
+            return ok;
+        }
+        const char *colon = ByteScan::findByte(lineStart, crlf, ':');
+        if (colon == crlf)
+        {
+            // 没有冒号的首部行
+            *hasMore = false;
+            return false;
+        }
+        request_.addHeader(lineStart, colon, crlf);
+        lineStart = crlf + 2;
+        headScanned_ = lineStart - buf->peek();
+    }
+    return true;
+}
+
+// 请求头解析完毕，根据 Content-Length 和 Content-Type 决定请求体的解析方式
+bool HttpContext::processHeadersDone()
+{
+    // 手动解析数字，不构造字符串
+    StringPiece length = request_.getHeader("Content-Length");
+    bodyRemaining_ = 0;
+    for (size_t i = 0; i < length.size(); ++i)
+    {
+        if (!isdigit(length[i]) || bodyRemaining_ > (SIZE_MAX - 9) / 10)
+        {
+            LOG_ERROR << "HttpContext::processHeadersDone bad Content-Length " << length;
+            return false;
+        }
+        bodyRemaining_ = bodyRemaining_ * 10 + (length[i] - '0');
+    }
+
+    StringPiece type = request_.getHeader("Content-Type");
+    if (request_.method_ == HttpRequest::kPost &&
+        type.startsWithIgnoreCase("multipart/form-data"))
+    {
+        std::string boundary = getHeaderParam(type.as_string(), "boundary");
+        if (boundary.empty() || bodyRemaining_ == 0)
+        {
+            LOG_ERROR << "HttpContext::processHeadersDone bad multipart request";
+            return false;
+        }
+        boundary_ = "\r\n--" + boundary;
+        state_ = kExpectBoundary;
+    }
+    else if (bodyRemaining_ > 0)
+    {
+        state_ = kExpectBody;
+    }
+    else
+    {
+        state_ = kGotAll;
+    }
+    return true;
+}
+
+bool HttpContext::processPartHeader(const char *begin, const char *colon, const char *end)
+{
+    HttpRequest::FormPart &part = request_.parts().back();
+    StringPiece field(begin, colon - begin);
+    ++colon;
+    while (colon < end && isspace(*colon))
+    {
+        ++colon;
+    }
+    if (field.equalsIgnoreCase("Content-Disposition"))
+    {
+        std::string value(colon, end);
+        part.name = getHeaderParam(value, "name");
+        part.filename = getHeaderParam(value, "filename");
+    }
+    else if (field.equalsIgnoreCase("Content-Type"))
+    {
+        part.contentType.assign(colon, end);
+    }
+    return true;
+}
+
+// 表单项头部结束，文件项打开临时文件准备写入
+bool HttpContext::beginPartData()
+{
+    HttpRequest::FormPart &part = request_.parts().back();
+    if (part.filename.empty())
+    {
+        return true;
+    }
+
+    std::string path = (uploadDir_.empty() ? std::string("/tmp") : uploadDir_) + "/.upload-XXXXXX";
+    int fd = ::mkostemp(&path[0], O_CLOEXEC);
+    if (fd < 0)
+    {
+        LOG_ERROR << "HttpContext::beginPartData mkostemp " << path << " failed, errno = " << errno;
+        return false;
+    }
+    part.tmpPath = path;
+    partFile_ = std::make_shared<PartFile>(fd, path);
+    return true;
+}
+
+// 表单项数据直接写入文件，不在内存中累积
+bool HttpContext::appendPartData(const char *data, size_t len)
+{
+    HttpRequest::FormPart &part = request_.parts().back();
+    part.size += len;
+    if (!partFile_)
+    {
+        part.value.append(data, len);
+        return true;
+    }
+
+    while (len > 0)
+    {
+        ssize_t n = ::pwrite(partFile_->fd, data, len, partFile_->offset);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR << "HttpContext::appendPartData pwrite " << partFile_->path << " failed, errno = " << errno;
+            return false;
+        }
+        partFile_->offset += n;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+void HttpContext::finishPart()
+{
+    if (partFile_)
+    {
+        partFile_->done = true;
+        partFile_.reset();
+    }
+}
+
 // return false if any error
+bool HttpContext::updateReadPhase(const Buffer *buf)
+{
+    ReadPhase phase;
+    if (state_ == kExpectRequestLine)
+    {
+        // 请求行没收完时还在 buf 里，没有数据说明在等待下一个请求
+        phase = buf->readableBytes() > 0 ? kReadingHead : kBetweenRequests;
+    }
+    else if (state_ == kExpectHeaders)
+    {
+        phase = kReadingHead;
+    }
+    else if (state_ == kGotAll)
+    {
+        phase = kBetweenRequests;
+    }
+    else
+    {
+        phase = kReadingBody;
+    }
+    bool changed = phase != readPhase_;
+    readPhase_ = phase;
+    return changed;
+}
+
 bool HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime)
 {
-    bool ok = false;
+    bool ok = true;
     bool hasMore = true;
     while (hasMore)
     {
+        // 请求行和首部都留在 Buffer 中，每次解析前重新设置起始位置
+        if (state_ == kExpectRequestLine || state_ == kExpectHeaders)
+        {
+            request_.setBase(buf->peek());
+        }
+
         // 请求行状态
         if (state_ == kExpectRequestLine)
         {
@@ -73,8 +327,8 @@ bool HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime)
                 if (ok)
                 {
                     request_.setReceiveTime(receiveTime);
-                    // readerIndex 向后移动位置直到 crlf + 2
-                    buf->retrieveUntil(crlf + 2);
+                    // 下一行从 crlf + 2 开始
+                    headScanned_ = crlf + 2 - buf->peek();
                     // 状态转移，接下来解析请求头
                     state_ = kExpectHeaders;
                 }
@@ -90,71 +344,187 @@ bool HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime)
         }
         // 解析请求头
         else if (state_ == kExpectHeaders)
+        {
+            ok = processHeaders(buf, &hasMore);
+        }
+        /**
+         * 普通请求体，一次就全部到达时直接从 Buffer 中取
+         * 分多次到达时每次都搬进 body_ 的固定大小的块中，Buffer 不会随着请求体变大而反复扩容搬移，
+         * 收完后一次拷贝到请求中
+         */
+        else if (state_ == kExpectBody)
+        {
+            if ((!body_ || body_->empty()) && buf->readableBytes() >= bodyRemaining_)
+            {
+                request_.addcontent(buf->peek(), bodyRemaining_);
+                retrieveBody(buf, bodyRemaining_);
+                state_ = kGotAll;
+            }
+            else
+            {
+                if (!body_)
+                {
+                    body_ = std::make_shared<ChainBuffer>();
+                }
+                size_t len = std::min(buf->readableBytes(), bodyRemaining_);
+                body_->append(buf->peek(), len);
+                retrieveBody(buf, len);
+                if (bodyRemaining_ == 0)
+                {
+                    request_.m_string.clear();
+                    body_->retrieveInto(&request_.m_string, body_->readableBytes());
+                    state_ = kGotAll;
+                }
+            }
+            hasMore = false;
+        }
+        // multipart 第一个分隔行，之前的内容(preamble)直接丢弃
+        else if (state_ == kExpectBoundary)
         {
             const char* crlf = buf->findCRLF();
             if (crlf)
             {
-                // 找到 : 位置
-                const char* colon = std::find(buf->peek(), crlf, ':');
-                if (colon != crlf)
+                size_t lineLen = crlf - buf->peek();
+                if (lineLen + 2 > bodyRemaining_)
                 {
-                    // 添加状态首部
-                    request_.addHeader(buf->peek(), colon, crlf);
+                    ok = hasMore = false;
                 }
-                else // colon == crlf 说明没有找到 : 了，直接返回 end
+                else
                 {
-                    // empty line, end of header
-                    // FIXME:
-                    // state_ = kGotAll;
-                    // hasMore = false;
-                    state_ = kExpectBody;
+                    // 第一个分隔行前面没有 "\r\n"
+                    bool isBoundary = lineLen == boundary_.size() - 2 &&
+                                      std::equal(buf->peek(), crlf, boundary_.begin() + 2);
+                    retrieveBody(buf, lineLen + 2);
+                    if (isBoundary)
+                    {
+                        request_.parts().push_back(HttpRequest::FormPart());
+                        state_ = kExpectPartHeaders;
+                    }
                 }
-                buf->retrieveUntil(crlf + 2);
             }
             else
             {
                 hasMore = false;
             }
         }
-        // 解析请求体
-        else if (state_ == kExpectBody)
+        // 表单项头部
+        else if (state_ == kExpectPartHeaders)
+        {
+            const char* crlf = buf->findCRLF();
+            if (crlf)
+            {
+                size_t lineLen = crlf - buf->peek();
+                if (lineLen + 2 > bodyRemaining_)
+                {
+                    ok = hasMore = false;
+                }
+                else if (lineLen == 0)
+                {
+                    retrieveBody(buf, 2);
+                    ok = beginPartData();
+                    hasMore = ok;
+                    state_ = kExpectPartData;
+                }
+                else
+                {
+                    const char* colon = ByteScan::findByte(buf->peek(), crlf, ':');
+                    if (colon != crlf)
+                    {
+                        processPartHeader(buf->peek(), colon, crlf);
+                    }
+                    retrieveBody(buf, lineLen + 2);
+                }
+            }
+            else
+            {
+                hasMore = false;
+            }
+        }
+        /**
+         * 表单项数据，增量查找 "\r\n--boundary"
+         * 找不到时保留末尾可能是分隔符前缀的 delimiter.size()-1 个字节，其余全部写出
+         * 这样缓冲区中只保留一次 read 的数据量，而不是整个文件
+         */
+        else if (state_ == kExpectPartData)
         {
-            if(request_.method_ == HttpRequest::kPost) {
-                // std::cout<<"the method is:"<<request_.method_ <<std::endl;
-                const char* crlf = buf->findCRLF();
-                //buf->retrieveUntil(crlf + 2);
-                std::cout<<"buf1 "<<*buf->peek()<<std::endl;
-                if(*buf->peek() == '-') {
-                    const char* crlf = buf->findCRLF();
-                    buf->retrieveUntil(crlf + 2);
-                    std::cout<<"buf "<<*buf->peek()<<std::endl;
-                    do
+            const std::string &delimiter = boundary_;
+            size_t avail = std::min(buf->readableBytes(), bodyRemaining_);
+            const char* begin = buf->peek();
+            const char* end = begin + avail;
+            const char* found = ByteScan::find(begin, end, delimiter.data(), delimiter.size());
+            if (found != end)
+            {
+                size_t dataLen = found - begin;
+                ok = appendPartData(begin, dataLen);
+                if (!ok)
+                {
+                    hasMore = false;
+                }
+                // 分隔符后面两个字节决定是下一个表单项("\r\n")还是结束("--")
+                else if (dataLen + delimiter.size() + 2 > avail)
+                {
+                    ok = avail < bodyRemaining_;
+                    retrieveBody(buf, dataLen);
+                    hasMore = false;
+                }
+                else
+                {
+                    const char* tail = found + delimiter.size();
+                    finishPart();
+                    retrieveBody(buf, dataLen + delimiter.size() + 2);
+                    if (tail[0] == '-' && tail[1] == '-')
+                    {
+                        state_ = kExpectEpilogue;
+                    }
+                    else if (tail[0] == '\r' && tail[1] == '\n')
+                    {
+                        request_.parts().push_back(HttpRequest::FormPart());
+                        state_ = kExpectPartHeaders;
+                    }
+                    else
                     {
-                        crlf = buf->findCRLF();
-                        const char* colon = std::find(buf->peek(), crlf, ':');
-                        std::cout<<"do "<<std::endl;
-                        if (colon != crlf)
-                        {
-                        // 添加状态首部
-                        std::cout<<"if "<<*buf->peek()<<std::endl;
-                        request_.addHeader(buf->peek(), colon, crlf);
-                        }
-                        else 
-                        {
-                            buf->retrieveUntil(crlf + 2);
-                            break;
-                        }
-                        buf->retrieveUntil(crlf + 2);
-                    } while (1);
-                    std::cout<<"buf2 "<<*buf->peek()<<std::endl;
-                    request_.addcontent(buf->peek());
-                    } else {
-                        request_.addcontent(buf->peek());
+                        ok = hasMore = false;
                     }
+                }
             }
-            state_ = kGotAll;
+            else
+            {
+                size_t keep = std::min(avail, delimiter.size() - 1);
+                ok = avail < bodyRemaining_ && appendPartData(begin, avail - keep);
+                if (ok)
+                {
+                    retrieveBody(buf, avail - keep);
+                }
+                hasMore = false;
+            }
+        }
+        // 结束分隔行之后的内容(epilogue)丢弃
+        else if (state_ == kExpectEpilogue)
+        {
+            retrieveBody(buf, std::min(buf->readableBytes(), bodyRemaining_));
+            if (bodyRemaining_ == 0)
+            {
+                state_ = kGotAll;
+            }
+            hasMore = false;
+        }
+        else
+        {
             hasMore = false;
         }
     }
+
+    // 停在首部状态时可读数据全部属于还没收完的请求行和首部
+    if (ok && (state_ == kExpectRequestLine || state_ == kExpectHeaders) &&
+        buf->readableBytes() > kMaxHeadSize)
+    {
+        LOG_ERROR << "HttpContext::parseRequest request head too large";
+        ok = false;
+    }
+    // 请求还没有收完，Buffer 中的请求行和首部会被覆盖，复制一份
+    if (ok && headLen_ > 0 && state_ != kGotAll)
+    {
+        request_.saveHead(headLen_);
+    }
     return ok;
 }
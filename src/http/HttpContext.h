@@ -2,6 +2,11 @@
 #define HTTP_HTTPCONTEXT_H
 
 #include "HttpRequest.h"
+#include "ChainBuffer.h"
+
+#include <memory>
+#include <string>
+#include <unistd.h>
 
 class Buffer;
 
@@ -14,11 +19,32 @@ public:
         kExpectRequestLine, // 解析请求行状态
         kExpectHeaders,     // 解析请求头部状态
         kExpectBody,        // 解析请求体状态
+        kExpectBoundary,    // 解析 multipart 第一个分隔行
+        kExpectPartHeaders, // 解析 multipart 表单项头部
+        kExpectPartData,    // 解析 multipart 表单项数据
+        kExpectEpilogue,    // 丢弃结束分隔行之后剩余的请求体
         kGotAll,            // 解析完毕状态
     };
 
+    // 接收请求所处的阶段，上层按阶段设置连接的读超时
+    enum ReadPhase
+    {
+        kBetweenRequests,   // 上一个请求已处理完，还没收到新请求的数据
+        kReadingHead,       // 正在接收请求行和首部
+        kReadingBody,       // 正在接收请求体
+    };
+
+    // 请求行加首部的最大长度，超过认为是错误请求
+    static const size_t kMaxHeadSize = 64 * 1024;
+    // 一次扫描最多找出的首部行数
+    static const size_t kLineBatch = 64;
+
     HttpContext()
-        : state_(kExpectRequestLine)
+        : state_(kExpectRequestLine),
+          headScanned_(0),
+          headLen_(0),
+          bodyRemaining_(0),
+          readPhase_(kBetweenRequests)
     {
     }
 
@@ -26,16 +52,39 @@ public:
 
     bool gotAll() const { return state_ == kGotAll; }
 
+    // 根据解析状态和 buf 中剩余的数据更新读取阶段，阶段变化时返回 true
+    bool updateReadPhase(const Buffer *buf);
+    ReadPhase readPhase() const { return readPhase_; }
+
+    /**
+     * 设置 multipart 文件项临时文件所在目录
+     * 临时文件与最终存放位置在同一文件系统时，上层可以直接 rename 过去
+     */
+    void setUploadDir(const std::string &dir) { uploadDir_ = dir; }
+
     // 重置HttpContext状态，异常安全
     void reset()
     {
         state_ = kExpectRequestLine;
-        /**
-         * 构造一个临时空HttpRequest对象，和当前的成员HttpRequest对象交换置空
-         * 然后临时对象析构
-         */
-        HttpRequest dummy;
-        request_.swap(dummy);
+        headScanned_ = 0;
+        headLen_ = 0;
+        bodyRemaining_ = 0;
+        boundary_.clear();
+        partFile_.reset();
+        if (body_)
+        {
+            body_->retrieveAll();
+        }
+        // 上层没有取走的临时文件直接删除
+        for (const HttpRequest::FormPart &part : request_.parts())
+        {
+            if (!part.tmpPath.empty())
+            {
+                ::unlink(part.tmpPath.c_str());
+            }
+        }
+        // 清空但保留已分配的内存，长连接上的后续请求不需要重新分配
+        request_.reset();
     }
 
     const HttpRequest& request() const { return request_; }
@@ -43,10 +92,45 @@ public:
     HttpRequest& request() { return request_; }
 
 private:
+    /**
+     * 正在写入的文件项，析构时关闭fd
+     * 连接中途断开导致文件没有写完时，同时删除临时文件
+     */
+    struct PartFile
+    {
+        PartFile(int f, const std::string &p) : fd(f), path(p), offset(0), done(false) {}
+        ~PartFile();
+
+        int fd;
+        std::string path;
+        off64_t offset;
+        bool done;
+    };
+
     bool processRequestLine(const char *begin, const char *end);
+    bool processHeaders(Buffer *buf, bool *hasMore);
+    bool processHeadersDone();
+    bool processPartHeader(const char *begin, const char *colon, const char *end);
+    bool beginPartData();
+    bool appendPartData(const char *data, size_t len);
+    void finishPart();
+    void retrieveBody(Buffer *buf, size_t len);
 
     HttpRequestParseState state_;
     HttpRequest request_;
+
+    /**
+     * 请求行和首部解析完之前不从 Buffer 中取走，request_ 只记录相对请求起始位置的偏移
+     * headScanned_ 是下一行的起始偏移，已经扫描过的部分不会重复查找
+     */
+    size_t headScanned_;
+    size_t headLen_;                      // 请求行和首部的总长度
+    size_t bodyRemaining_;                // 请求体还未消费的字节数
+    std::string boundary_;                // "\r\n--" + boundary，表单项数据后的分隔符
+    std::string uploadDir_;               // 临时文件目录
+    std::shared_ptr<PartFile> partFile_;  // 当前文件项
+    std::shared_ptr<ChainBuffer> body_;   // 分多次到达的普通请求体，第一次用到时创建
+    ReadPhase readPhase_;                 // reset 不改变，跨请求保持
 };
 
-#endif // HTTP_HTTPCONTEXT_H
\ No newline at end of file
+#endif // HTTP_HTTPCONTEXT_H
@@ -3,17 +3,51 @@
 
 #include "noncopyable.h"
 #include "Timestamp.h"
-#include <unordered_map>
+#include "StringPiece.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <sys/types.h>
+#include <strings.h>
 
+/**
+ * HTTP 请求
+ * 请求行和首部不拷贝，以相对请求起始位置(base)的偏移保存，访问时返回指向原始数据的 StringPiece
+ * 解析时 base 指向连接 Buffer 中的请求起始位置，请求在同一次 parseRequest 中解析完毕时，
+ * 视图在本次 onMessage 回调内有效；需要等待后续数据时 HttpContext 调用 saveHead() 把
+ * 请求行和首部复制到请求自己的内存中
+ * 首部保存在内联数组中，超过 kInlineHeaders 个才使用堆内存
+ */
 class HttpRequest
 {
 public:
+    /**
+     * multipart/form-data 中的一个表单项
+     * 文件项的数据由 HttpContext 流式写入 tmpPath 指向的临时文件，不在内存中保留
+     * 普通表单项的值直接保存在 value 中
+     */
+    struct FormPart
+    {
+        std::string name;        // Content-Disposition 中的 name
+        std::string filename;    // Content-Disposition 中的 filename，为空说明不是文件
+        std::string contentType; // 该表单项的 Content-Type
+        std::string tmpPath;     // 文件项的临时文件路径
+        std::string value;       // 普通表单项的值
+        off64_t size = 0;        // 表单项数据长度
+    };
     enum Method { kInvalid, kGet, kPost, kHead, kPut, kDelete };
     enum Version { kUnknown, kHttp10, kHttp11 };
+    // 内联保存的首部个数
+    static const int kInlineHeaders = 32;
+
     // 只实现了 /1.0 /1.1，Http/2 是基于 HTTPS 实现的
     HttpRequest()
         : method_(kInvalid),
-          version_(kUnknown)
+          version_(kUnknown),
+          base_(nullptr),
+          headSaved_(false),
+          headerCount_(0)
     {        
     }
 
@@ -25,9 +59,10 @@ public:
     Version getVersion() const { return version_; }
     Version version() const { return version_; }
 
+    // 不构造 std::string，直接比较长度和内容
     bool setMethod(const char *start, const char *end)
     {
-        std::string m(start, end);
+        StringPiece m(start, end - start);
         if (m == "GET")
         {
             method_ = kGet;
@@ -84,19 +119,35 @@ public:
         return result;
     } 
 
+    /**
+     * 设置请求起始位置，之后的 setPath/setQuery/addHeader 都以它为基准计算偏移
+     * 连接 Buffer 扩容或整理时数据会移动，每次解析前都要重新设置
+     */
+    void setBase(const char *base) { base_ = base; }
+
+    // 把 [base, base+len) 的请求行和首部复制到自己的内存中，之后不再依赖连接 Buffer
+    void saveHead(size_t len)
+    {
+        if (!headSaved_)
+        {
+            head_.assign(base_, len);
+            headSaved_ = true;
+        }
+    }
+
     void setPath(const char *start, const char *end)
     {
-        path_.assign(start, end);
+        path_ = makeSlice(start, end);
     }
 
-    const std::string& path() const { return path_; }
+    StringPiece path() const { return piece(path_); }
 
     void setQuery(const char *start, const char *end) 
     {
-        query_.assign(start, end);
+        query_ = makeSlice(start, end);
     }
 
-    const std::string& query() const { return query_; }
+    StringPiece query() const { return piece(query_); }
 
     void setReceiveTime(Timestamp t) 
     { 
@@ -107,71 +158,159 @@ public:
 
     void addHeader(const char *start, const char *colon, const char *end)
     {
-        std::string field(start, colon);
+        Header header;
+        header.field = makeSlice(start, colon);
         ++colon;
         // 跳过空格
         while (colon < end && isspace(*colon))
         {
             ++colon;
         }
-        std::string value(colon, end);
-        // value丢掉后面的空格，通过重新截断大小设置
-        while (!value.empty() && isspace(value[value.size()-1]))
+        // value丢掉后面的空格
+        while (end > colon && isspace(*(end - 1)))
+        {
+            --end;
+        }
+        header.value = makeSlice(colon, end);
+        if (headerCount_ < kInlineHeaders)
         {
-          value.resize(value.size()-1);
+            headers_[headerCount_] = header;
         }
-        headers_[field] = value;
+        else
+        {
+            moreHeaders_.push_back(header);
+        }
+        ++headerCount_;
     }
 
-
-    void addcontent(const char *start)
+    // 保存请求体 [start, start+len)
+    void addcontent(const char *start, size_t len)
     {
-        std::string l = headers_["Content-Length"];
-        int len = atoi(l.c_str());
-        std::cout<<"len: "<<len<<std::endl;
-        std::cout<<"char: "<<*start<<" "<<*(start+1)<<" "<<*(start+2)<<std::endl;
-        m_string.assign(start, start+len);
-
+        m_string.assign(start, len);
     }
 
-    // 获取请求头部的对应值
-    std::string getHeader(const std::string &field) const
+    std::vector<FormPart>& parts() { return parts_; }
+    const std::vector<FormPart>& parts() const { return parts_; }
+
+    // 获取请求头部的对应值，字段名不区分大小写，不存在时返回空
+    StringPiece getHeader(const StringPiece &field) const
     {
-        std::string result;
-        auto it = headers_.find(field);
-        // std::cout<<"我要找:"<<field<<std::endl;
-        if (it != headers_.end())
+        for (int i = 0; i < headerCount_; ++i)
         {
-            // std::cout<<"找到请求头部了"<<std::endl;
-            result = it->second;
-        } 
-        //else  std::cout<<"根本没找到请求头部！！！"<<std::endl;
-        return result;
+            if (headerName(i).equalsIgnoreCase(field))
+            {
+                return headerValue(i);
+            }
+        }
+        return StringPiece();
     }
 
-    const std::unordered_map<std::string, std::string>& headers() const
+    int headerCount() const { return headerCount_; }
+    StringPiece headerName(int i) const { return piece(header(i).field); }
+    StringPiece headerValue(int i) const { return piece(header(i).value); }
+
+    /**
+     * 是否保持长连接
+     * HTTP/1.1 默认长连接，除非显式 Connection: close
+     * HTTP/1.0 默认短连接，除非显式 Connection: Keep-Alive
+     */
+    bool keepAlive() const
     {
-        return headers_;
+        StringPiece connection = getHeader("Connection");
+        if (connection.equalsIgnoreCase("close"))
+        {
+            return false;
+        }
+        if (version_ == kHttp10)
+        {
+            return connection.equalsIgnoreCase("keep-alive");
+        }
+        return version_ == kHttp11;
     }
 
     void swap(HttpRequest &rhs)
     {
         std::swap(method_, rhs.method_);
         std::swap(version_, rhs.version_);
-        path_.swap(rhs.path_);
-        query_.swap(rhs.query_);
+        std::swap(base_, rhs.base_);
+        std::swap(headSaved_, rhs.headSaved_);
+        head_.swap(rhs.head_);
+        std::swap(path_, rhs.path_);
+        std::swap(query_, rhs.query_);
         std::swap(receiveTime_, rhs.receiveTime_);
-        headers_.swap(rhs.headers_);
+        std::swap(headers_, rhs.headers_);
+        std::swap(headerCount_, rhs.headerCount_);
+        moreHeaders_.swap(rhs.moreHeaders_);
+        m_string.swap(rhs.m_string);
+        parts_.swap(rhs.parts_);
+    }
+
+    /**
+     * 清空请求，保留已经分配的内存
+     * 长连接上的后续请求不需要重新分配 head_/m_string
+     */
+    void reset()
+    {
+        method_ = kInvalid;
+        version_ = kUnknown;
+        base_ = nullptr;
+        headSaved_ = false;
+        head_.clear();
+        path_ = Slice();
+        query_ = Slice();
+        receiveTime_ = Timestamp();
+        headerCount_ = 0;
+        moreHeaders_.clear();
+        m_string.clear();
+        parts_.clear();
     }
+
     Method method_;         // 请求方法
     std::string m_string;  //请求体
 private:
-    
+    // 相对 base 的一段数据
+    struct Slice
+    {
+        Slice() : offset(0), len(0) {}
+        uint32_t offset;
+        uint32_t len;
+    };
+    struct Header
+    {
+        Slice field;
+        Slice value;
+    };
+
+    Slice makeSlice(const char *start, const char *end) const
+    {
+        Slice slice;
+        slice.offset = static_cast<uint32_t>(start - base_);
+        slice.len = static_cast<uint32_t>(end - start);
+        return slice;
+    }
+
+    StringPiece piece(const Slice &slice) const
+    {
+        const char *base = headSaved_ ? head_.data() : base_;
+        return slice.len == 0 ? StringPiece("", 0) : StringPiece(base + slice.offset, slice.len);
+    }
+
+    const Header& header(int i) const
+    {
+        return i < kInlineHeaders ? headers_[i] : moreHeaders_[i - kInlineHeaders];
+    }
+
     Version version_;       // 协议版本号
-    std::string path_;      // 请求路径
-    std::string query_;     // 询问参数
+    const char *base_;      // 请求起始位置，指向连接 Buffer
+    bool headSaved_;        // 为 true 时请求行和首部在 head_ 中
+    std::string head_;      // saveHead() 保存的请求行和首部
+    Slice path_;            // 请求路径
+    Slice query_;           // 询问参数
     Timestamp receiveTime_; // 请求时间
-    std::unordered_map<std::string, std::string> headers_; // 请求头部列表
+    Header headers_[kInlineHeaders];   // 请求头部列表
+    int headerCount_;
+    std::vector<Header> moreHeaders_;  // 超出内联数组的首部
+    std::vector<FormPart> parts_;  // multipart/form-data 表单项
 };
 
 #endif // HTTP_HTTPREQUEST_H
\ No newline at end of file
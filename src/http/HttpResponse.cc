@@ -1,11 +1,60 @@
 #include "HttpResponse.h"
 #include "Buffer.h"
+#include "TcpConnection.h"
+#include "OutputChain.h"
 
 #include <stdio.h>
 #include <string.h>
 
 void HttpResponse::appendToBuffer(Buffer* output) const
 {
+    const std::string &body = bodyBlock_ ? *bodyBlock_ : body_;
+    appendHeadersToBuffer(output, body.size());
+    output->append(body);
+}
+
+void HttpResponse::sendTo(const TcpConnectionPtr& conn)
+{
+    const std::string &body = bodyBlock_ ? *bodyBlock_ : body_;
+    Buffer buf;
+    OutputChain chain;
+    if (body.size() <= kInlineBodyLimit)
+    {
+        appendToBuffer(&buf);
+        chain.append(&buf);
+    }
+    else
+    {
+        appendHeadersToBuffer(&buf, body.size());
+        chain.append(&buf);
+        if (bodyBlock_)
+        {
+            chain.append(bodyBlock_);
+        }
+        else
+        {
+            chain.append(std::move(body_));
+        }
+    }
+    if (needSendFile())
+    {
+        // 文件排在响应头后面，fd 没有 holder 时由连接负责发完后关闭
+        chain.appendFile(fd_, offset_, static_cast<size_t>(len_), fdHolder_);
+    }
+    // 响应头和响应体一次 writev，文件紧跟着 sendfile
+    conn->send(&chain);
+}
+
+void HttpResponse::appendHeadersToBuffer(Buffer* output, size_t bodySize) const
+{
+    // 头部按估计的长度和较小的响应体一起预留空间，整个响应只扩容一次
+    size_t headerSize = 128 + statusMessage_.size();
+    for (const auto& header : headers_)
+    {
+        headerSize += header.first.size() + header.second.size() + 4;
+    }
+    output->ensureWritableBytes(headerSize + (bodySize <= kInlineBodyLimit ? bodySize : 0));
+
     // 响应行
     char buf[32];
     memset(buf, '\0', sizeof(buf));
@@ -14,14 +63,19 @@ void HttpResponse::appendToBuffer(Buffer* output) const
     output->append(statusMessage_);
     output->append("\r\n");
 
+    // 长连接下客户端依靠 Content-Length 划分响应，sendfile 的响应由调用者自己设置
+    if (fd_ == -1 && headers_.find("Content-Length") == headers_.end())
+    {
+        snprintf(buf, sizeof(buf), "Content-Length: %zu\r\n", bodySize);
+        output->append(buf);
+    }
+
     if (closeConnection_)
     {
         output->append("Connection: close\r\n");
     }
     else
     {
-        //snprintf(buf, sizeof(buf), "Content-Length: %zd\r\n", body_.size());
-        output->append(buf);
         output->append("Connection: Keep-Alive\r\n");
     }
 
@@ -33,5 +87,4 @@ void HttpResponse::appendToBuffer(Buffer* output) const
         output->append("\r\n");
     }
     output->append("\r\n");
-    output->append(body_); 
 }
\ No newline at end of file
@@ -2,6 +2,11 @@
 #define HTTP_HTTPRESPONSE_H
 
 #include <unordered_map>
+#include <string>
+#include <memory>
+#include <sys/types.h>
+
+#include "Callback.h"
 
 class Buffer;
 class HttpResponse
@@ -23,7 +28,9 @@ public:
     explicit HttpResponse(bool close)
       : statusCode_(kUnknown),
         closeConnection_(close),
-        fd_(-1)
+        fd_(-1),
+        offset_(0),
+        len_(0)
     {
     }   
 
@@ -53,10 +60,22 @@ public:
     { headers_[key] = value; }  
 
     void setBody(const std::string& body)
-    { body_ = body; }   
+    { body_ = body; bodyBlock_.reset(); }   
+
+    // 预先生成的不可变页面，多个响应共享，不拷贝
+    void setBody(const std::shared_ptr<const std::string>& block)
+    { body_.clear(); bodyBlock_ = block; }
 
     void appendToBuffer(Buffer* output) const;
 
+    /**
+     * 把响应交给连接发送，响应头和较小的响应体拷贝进一个 Buffer，
+     * 较大的响应体移动或共享进发送队列，文件排在最后，不再拷贝
+     * 各段组装好后一起交给连接，只发送一次
+     * 之后 body_ 被移走，不能再次发送
+     */
+    void sendTo(const TcpConnectionPtr& conn);
+
     bool needSendFile() const { return fd_ != -1; }
             int getFd() const { return fd_; }
             void setFd(int fd)
@@ -64,6 +83,11 @@ public:
                 // assert(fd >= 0);
                 fd_ = fd;
             }
+            // fd 由 holder 管理时(文件缓存)，发送期间需要持有它的引用
+            const std::shared_ptr<void>& getFdHolder() const { return fdHolder_; }
+            void setFdHolder(const std::shared_ptr<void> &holder) { fdHolder_ = holder; }
+            off64_t getSendOffset() const { return offset_; }
+            void setSendOffset(off64_t offset) { offset_ = offset; }
             off64_t getSendLen() const { return len_; }
             void setSendLen(off64_t len)
             {
@@ -72,13 +96,22 @@ public:
             }
 
 private:
+    // 响应体不超过这个长度时和响应头一起拷贝发送
+    static const size_t kInlineBodyLimit = 4096;
+
+    // 响应行和头部，bodySize 用于 Content-Length
+    void appendHeadersToBuffer(Buffer* output, size_t bodySize) const;
+
     std::unordered_map<std::string, std::string> headers_;
     HttpStatusCode statusCode_;
     // FIXME: add http version
     std::string statusMessage_;
     bool closeConnection_;               // 是否关闭长连接
     std::string body_;
+    std::shared_ptr<const std::string> bodyBlock_;  // 不为空时代替 body_
     int fd_;                           // 需要传输文件时使用
+    std::shared_ptr<void> fdHolder_;       // fd_ 的所有者，为空时 fd_ 交给连接关闭
+    off64_t offset_;                       // 文件起始偏移
     off64_t len_;                          // 传输大小
 };
 
@@ -21,13 +21,22 @@ HttpServer::HttpServer(EventLoop *loop,
                       const std::string &name,
                       TcpServer::Option option)
   : server_(loop, listenAddr, name, option),
-    httpCallback_(defaultHttpCallback)
+    httpCallback_(defaultHttpCallback),
+    idleTimeout_(60.0),
+    headerTimeout_(10.0),
+    bodyTimeout_(60.0)
 {
     server_.setConnectionCallback(
         std::bind(&HttpServer::onConnection, this, std::placeholders::_1));
     server_.setMessageCallback(
         std::bind(&HttpServer::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
     server_.setThreadNum(4);
+    // 空闲和读超时由每个 subLoop 的 TimeoutWheel 检查
+    server_.setIdleTimeout(idleTimeout_);
+    // 流水线请求的客户端不读响应时暂停读请求，发送队列不会无限增长
+    server_.setFlowControl(4 * 1024 * 1024, 1024 * 1024);
+    server_.setDrainCallback(
+        std::bind(&HttpServer::onDrain, this, std::placeholders::_1));
 }
 
 void HttpServer::start()
@@ -41,10 +50,31 @@ void HttpServer::onConnection(const TcpConnectionPtr& conn)
     if (conn->connected())
     {
         LOG_INFO << "new Connection arrived";
+        // 每个连接一个 HttpContext，长连接上的多个请求复用
+        conn->setContext(HttpContext());
     }
     else 
     {
         LOG_INFO << "Connection closed";
+        // 请求体中途断开时删除已经写入的上传临时文件
+        HttpContext *context = boost::any_cast<HttpContext>(conn->getMutableContext());
+        if (context)
+        {
+            context->reset();
+        }
+    }
+}
+
+/**
+ * 服务器开始优雅关闭
+ * 两个请求之间的连接发完已有的响应就关闭，正在接收的请求处理完后带 Connection: close 关闭
+ */
+void HttpServer::onDrain(const TcpConnectionPtr& conn)
+{
+    HttpContext *context = boost::any_cast<HttpContext>(conn->getMutableContext());
+    if (context == nullptr || context->readPhase() == HttpContext::kBetweenRequests)
+    {
+        conn->shutdown();
     }
 }
 
@@ -54,7 +84,7 @@ void HttpServer::onMessage(const TcpConnectionPtr& conn,
                            Timestamp receiveTime)
 {
     // LOG_INFO << "HttpServer::onMessage";
-    std::unique_ptr<HttpContext> context(new HttpContext);
+    HttpContext *context = boost::any_cast<HttpContext>(conn->getMutableContext());
 
 #if 0
     // 打印请求报文
@@ -62,42 +92,73 @@ void HttpServer::onMessage(const TcpConnectionPtr& conn,
     std::cout << request << std::endl;
 #endif
 
-    // 进行状态机解析
-    // 错误则发送 BAD REQUEST 半关闭
-    if (!context->parseRequest(buf, receiveTime))
+    // 一次读到的数据中可能有多个流水线请求，按顺序依次解析和响应
+    while (conn->connected())
     {
-        LOG_INFO << "parseRequest failed!";
-        conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
-        conn->shutdown();
-    }
+        // 进行状态机解析
+        // 错误则发送 BAD REQUEST 半关闭
+        if (!context->parseRequest(buf, receiveTime))
+        {
+            LOG_INFO << "parseRequest failed!";
+            conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
+            conn->shutdown();
+            // 出错前已经收完的文件项不会再被处理，临时文件在这里删除
+            context->reset();
+            break;
+        }
+
+        // 请求还不完整，等待更多数据
+        if (!context->gotAll())
+        {
+            break;
+        }
 
-    // 如果成功解析
-    if (context->gotAll())
-    {
         LOG_INFO << "parseRequest success!";
         onRequest(conn, context->request());
         context->reset();
     }
+    updateReadTimeout(conn, context, buf);
 }
 
-void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
+/**
+ * 按请求的接收阶段设置读超时，阶段不变时不重新设置
+ * 请求行和首部、请求体各有一个截止时间，逐字节慢慢发送的客户端不能一直占着连接
+ * 两个请求之间只有空闲超时
+ */
+void HttpServer::updateReadTimeout(const TcpConnectionPtr &conn, HttpContext *context, Buffer *buf)
 {
-    const std::string& connection = req.getHeader("Connection");
+    if (!conn->connected() || !context->updateReadPhase(buf))
+    {
+        return;
+    }
+    switch (context->readPhase())
+    {
+        case HttpContext::kReadingHead:
+            conn->setReadTimeout(headerTimeout_);
+            break;
+        case HttpContext::kReadingBody:
+            conn->setReadTimeout(bodyTimeout_);
+            break;
+        default:
+            conn->setReadTimeout(0);
+            break;
+    }
+}
 
-    // 判断长连接还是短连接
-    bool close = connection == "close" ||
-        (req.version() == HttpRequest::kHttp10 && connection != "Keep-Alive");
-    // TODO:这里有问题，但是强制改写了
-    close = true;
+void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
+{
+    // 判断长连接还是短连接，优雅关闭期间都是短连接
+    bool close = !req.keepAlive() || conn->draining();
     // 响应信息
     HttpResponse response(close);
     // httpCallback_ 由用户传入，怎么写响应体由用户决定
     // 此处初始化了一些response的信息，比如响应码，回复OK
     httpCallback_(req, &response);
-    Buffer buf;
-    response.appendToBuffer(&buf);
-    // TODO:需要重载 TcpConnection::send 使其可以接收一个缓冲区
-    conn->send(&buf);
+    if (!response.closeConnection())
+    {
+        response.addHeader("Keep-Alive", "timeout=" + std::to_string(static_cast<int>(idleTimeout_)));
+    }
+    response.sendTo(conn);
     if (response.closeConnection())
     {
         conn->shutdown();
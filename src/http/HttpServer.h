@@ -8,6 +8,7 @@
 
 class HttpRequest;
 class HttpResponse;
+class HttpContext;
 
 class HttpServer : noncopyable
 {
@@ -25,18 +26,36 @@ public:
     {
         httpCallback_ = cb;
     }
+
+    // 设置长连接空闲超时时间(秒)，超时没有收发数据则关闭连接，需要在 start 之前设置
+    void setIdleTimeout(double seconds) { idleTimeout_ = seconds; server_.setIdleTimeout(seconds); }
+    // 待发送的响应超过 highWaterMark 时暂停读请求，发送到 lowWaterMark 以下时恢复，需要在 start 之前设置
+    void setFlowControl(size_t highWaterMark, size_t lowWaterMark) { server_.setFlowControl(highWaterMark, lowWaterMark); }
+    // 收到请求的第一个字节后，请求行和首部、请求体分别必须在多少秒内收完，0 表示不限制
+    void setHeaderTimeout(double seconds) { headerTimeout_ = seconds; }
+    void setBodyTimeout(double seconds) { bodyTimeout_ = seconds; }
     
     void start();
 
+    // 优雅关闭和热重启，见 TcpServer::drain、ListenerHandoff
+    void drain(double timeoutSeconds, const std::function<void()> &done) { server_.drain(timeoutSeconds, done); }
+    std::vector<int> listenFds() const { return server_.listenFds(); }
+    void adoptListenFds(const std::vector<int> &fds) { server_.adoptListenFds(fds); }
+
 private:
     void onConnection(const TcpConnectionPtr& conn);
+    void onDrain(const TcpConnectionPtr& conn);
     void onMessage(const TcpConnectionPtr &conn,
                     Buffer *buf,
                     Timestamp receiveTime);
     void onRequest(const TcpConnectionPtr&, const HttpRequest&);
+    void updateReadTimeout(const TcpConnectionPtr &conn, HttpContext *context, Buffer *buf);
 
     TcpServer server_;
     HttpCallback httpCallback_;
+    double idleTimeout_;
+    double headerTimeout_;
+    double bodyTimeout_;
 };
 
 #endif // HTTP_HTTPSERVER_H
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "HttpTemplate.h"
+#include "Buffer.h"
+
+#include <assert.h>
+#include <algorithm>
+
+HttpTemplate::HttpTemplate(const std::string &text)
+{
+    text_.reserve(text.size());
+    size_t pos = 0;
+    while (true)
+    {
+        size_t open = text.find("{{", pos);
+        size_t close = open == std::string::npos ? open : text.find("}}", open + 2);
+        if (close == std::string::npos)
+        {
+            // 剩下的都是字面量
+            Segment seg = { text_.size(), text.size() - pos, -1 };
+            text_.append(text, pos, std::string::npos);
+            segments_.push_back(seg);
+            break;
+        }
+
+        std::string name = text.substr(open + 2, close - open - 2);
+        std::vector<std::string>::iterator it = std::find(names_.begin(), names_.end(), name);
+        if (it == names_.end())
+        {
+            it = names_.insert(names_.end(), name);
+        }
+        Segment seg = { text_.size(), open - pos, static_cast<int>(it - names_.begin()) };
+        text_.append(text, pos, open - pos);
+        segments_.push_back(seg);
+        pos = close + 2;
+    }
+
+    if (names_.empty())
+    {
+        block_ = std::make_shared<const std::string>(text_);
+    }
+}
+
+size_t HttpTemplate::size(Values values) const
+{
+    assert(values.size() == names_.size());
+    size_t total = text_.size();
+    for (const Segment &seg : segments_)
+    {
+        if (seg.slot >= 0)
+        {
+            total += values.begin()[seg.slot].get().size();
+        }
+    }
+    return total;
+}
+
+void HttpTemplate::render(Buffer *output, Values values) const
+{
+    output->ensureWritableBytes(size(values));
+    for (const Segment &seg : segments_)
+    {
+        output->append(text_.data() + seg.offset, seg.len);
+        if (seg.slot >= 0)
+        {
+            output->append(values.begin()[seg.slot].get());
+        }
+    }
+}
+
+void HttpTemplate::render(std::string *output, Values values) const
+{
+    output->reserve(output->size() + size(values));
+    for (const Segment &seg : segments_)
+    {
+        output->append(text_, seg.offset, seg.len);
+        if (seg.slot >= 0)
+        {
+            output->append(values.begin()[seg.slot].get());
+        }
+    }
+}
+
+HttpTemplate::Block HttpTemplate::renderBlock(Values values) const
+{
+    std::string page;
+    render(&page, values);
+    return std::make_shared<const std::string>(std::move(page));
+}
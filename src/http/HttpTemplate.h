@@ -0,0 +1,57 @@
+#ifndef HTTP_HTTPTEMPLATE_H
+#define HTTP_HTTPTEMPLATE_H
+
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Buffer;
+
+/**
+ * 预编译的页面模板，启动时解析一次
+ * 模板中的 {{name}} 为占位符，解析后保存为 字面量段 + 占位符 的序列
+ * 渲染时先算出总长度，目标 Buffer/string 只扩容一次
+ *
+ * 没有占位符的模板是静态页面，直接用 block() 得到不可变的页面内容，
+ * 多个响应共享同一块内存
+ */
+class HttpTemplate
+{
+public:
+    using Block = std::shared_ptr<const std::string>;
+    // 按 names() 的顺序传入占位符的值，只能引用左值，渲染期间必须有效
+    using Values = std::initializer_list<std::reference_wrapper<const std::string>>;
+
+    explicit HttpTemplate(const std::string &text);
+
+    // 占位符名字，按第一次出现的顺序
+    const std::vector<std::string>& names() const { return names_; }
+
+    // 渲染后的长度
+    size_t size(Values values) const;
+
+    void render(Buffer *output, Values values) const;
+    void render(std::string *output, Values values) const;
+
+    // 渲染成不可变页面
+    Block renderBlock(Values values) const;
+    // 静态页面(没有占位符)的内容，解析时已经生成
+    const Block& block() const { return block_; }
+
+private:
+    struct Segment
+    {
+        size_t offset;  // 字面量在 text_ 中的位置
+        size_t len;
+        int slot;       // 字面量之后的占位符下标，-1 表示没有
+    };
+
+    std::string text_;                  // 去掉占位符后的字面量
+    std::vector<Segment> segments_;
+    std::vector<std::string> names_;
+    Block block_;
+};
+
+#endif // HTTP_HTTPTEMPLATE_H
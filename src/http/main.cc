@@ -4,12 +4,22 @@
 #include "HttpContext.h"
 #include "Timestamp.h"
 #include "AsyncLogging.h"
+#include "ListenerHandoff.h"
+#include "Channel.h"
+
+#include <signal.h>
+#include <sys/signalfd.h>
 
 //extern char favicon[555];
 bool benchmark = false;
 
 int kRollSize = 500*1000*1000; //限制一个日志文件的大小
 
+// 热重启时新旧进程交接监听 socket 的 UNIX socket
+const char *kHandoffPath = "/tmp/file-server.handoff";
+// 优雅关闭时等待在途请求和下载的最长时间(秒)
+const double kDrainSeconds = 30.0;
+
 // 异步日志
 std::unique_ptr<AsyncLogging> g_asyncLog;
 
@@ -29,15 +39,49 @@ void setLogging(const char* argv0)
 
 int main(int argc, char* argv[])
 {
+    // SIGTERM、SIGINT 由 baseLoop 通过 signalfd 处理，要在创建任何线程之前屏蔽
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
     setLogging(argv[0]); //整个程序只有一个后端日志线程
 
     LOG_INFO << "pid = " << getpid();
     EventLoop loop;
     FileServer server("/home/scs1/webfile", &loop, InetAddress(8080), "file-server");
+    // 旧版本还在运行时接管它的监听 socket，重启期间连接不会被拒绝
+    server.adoptListenFds(ListenerHandoff::receive(kHandoffPath));
     //数据库
     server.sql_pool();
     server.start();
+
+    // 停止接受新连接，等在途的请求和下载完成后退出
+    auto shutdown = [&server, &loop]() {
+        server.drain(kDrainSeconds, [&loop]() { loop.quit(); });
+    };
+    // 下一个版本启动时把监听 socket 交给它，然后优雅退出
+    ListenerHandoff handoff(&loop, kHandoffPath);
+    handoff.listen(std::bind(&FileServer::listenFds, &server), shutdown);
+
+    int signalFd = ::signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    Channel signalChannel(&loop, signalFd);
+    signalChannel.setReadCallback([signalFd, &shutdown](Timestamp) {
+        signalfd_siginfo info;
+        if (::read(signalFd, &info, sizeof(info)) == sizeof(info))
+        {
+            LOG_INFO << "signal " << info.ssi_signo << ", draining";
+            shutdown();
+        }
+    });
+    signalChannel.enableReading();
+
     loop.loop();
+
+    signalChannel.disableAll();
+    signalChannel.remove();
+    ::close(signalFd);
 }
 
 // char favicon[555] = {
@@ -0,0 +1,258 @@
+#include "HttpContext.h"
+#include "Buffer.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+
+// 读取整个文件内容
+std::string readFile(const std::string &path)
+{
+    std::string content;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    char buf[4096];
+    ssize_t n;
+    while (fd >= 0 && (n = ::read(fd, buf, sizeof buf)) > 0)
+    {
+        content.append(buf, n);
+    }
+    ::close(fd);
+    return content;
+}
+
+// 构造一个 multipart 请求，后面跟一个流水线的 GET 请求
+std::string makeRequest(const std::string &fileData)
+{
+    std::string body;
+    body += "--XyZ\r\n";
+    body += "Content-Disposition: form-data; name=\"note\"\r\n\r\n";
+    body += "hello\r\n";
+    body += "--XyZ\r\n";
+    body += "Content-Disposition: form-data; name=\"file\"; filename=\"a.txt\"\r\n";
+    body += "Content-Type: text/plain\r\n\r\n";
+    body += fileData;
+    body += "\r\n--XyZ--\r\n";
+
+    std::string request;
+    request += "POST /upload HTTP/1.1\r\n";
+    request += "Content-Type: multipart/form-data; boundary=XyZ\r\n";
+    request += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+    request += body;
+    request += "GET / HTTP/1.1\r\n\r\n";
+    return request;
+}
+
+// 每次只喂 chunk 个字节，模拟 handleRead 分多次读到数据
+void testMultipart(size_t chunk)
+{
+    std::string fileData;
+    for (int i = 0; i < 10000; ++i)
+    {
+        fileData += "line " + std::to_string(i) + "\r\n--Xy-not-a-boundary\r\n";
+    }
+    std::string request = makeRequest(fileData);
+
+    HttpContext context;
+    context.setUploadDir("/tmp");
+    Buffer buf;
+    size_t fed = 0;
+    while (!context.gotAll())
+    {
+        assert(fed < request.size());
+        size_t n = std::min(chunk, request.size() - fed);
+        buf.append(request.data() + fed, n);
+        fed += n;
+        assert(context.parseRequest(&buf, Timestamp::now()));
+        // 缓冲区中只保留少量未处理的数据(请求行和首部收完之前整体留在缓冲区中)
+        assert(buf.readableBytes() < chunk + 256);
+    }
+
+    const HttpRequest &req = context.request();
+    assert(req.parts().size() == 2);
+    assert(req.parts()[0].name == "note");
+    assert(req.parts()[0].value == "hello");
+    assert(req.parts()[1].filename == "a.txt");
+    assert(req.parts()[1].contentType == "text/plain");
+    assert(req.parts()[1].size == static_cast<off64_t>(fileData.size()));
+    std::string tmpPath = req.parts()[1].tmpPath;
+    assert(readFile(tmpPath) == fileData);
+
+    // reset 会删除没有被取走的临时文件
+    context.reset();
+    assert(::access(tmpPath.c_str(), F_OK) != 0);
+
+    // 后面流水线的请求仍然完整保留在缓冲区中
+    buf.append(request.data() + fed, request.size() - fed);
+    assert(context.parseRequest(&buf, Timestamp::now()));
+    assert(context.gotAll());
+    assert(context.request().path() == "/");
+    printf("chunk = %zu ok\n", chunk);
+}
+
+// 首部分多次到达、字段名大小写不同、超过内联数组容量、流水线请求
+void testHeaders(size_t chunk)
+{
+    std::string request = "GET /dir/a.txt?x=1 HTTP/1.1\r\n"
+                          "Host: example.com\r\n"
+                          "connection:   close  \r\n";
+    for (int i = 0; i < HttpRequest::kInlineHeaders + 8; ++i)
+    {
+        request += "X-Extra-" + std::to_string(i) + ": " + std::to_string(i) + "\r\n";
+    }
+    request += "Range: bytes=0-99\r\n\r\n";
+    request += "POST /form HTTP/1.0\r\nContent-Length: 5\r\n\r\nhello";
+
+    HttpContext context;
+    Buffer buf;
+    size_t fed = 0;
+    while (!context.gotAll())
+    {
+        size_t n = std::min(chunk, request.size() - fed);
+        buf.append(request.data() + fed, n);
+        fed += n;
+        assert(context.parseRequest(&buf, Timestamp::now()));
+    }
+
+    const HttpRequest &req = context.request();
+    assert(req.method() == HttpRequest::kGet);
+    assert(req.path() == "/dir/a.txt");
+    assert(req.query() == "?x=1");
+    assert(req.getHeader("host") == "example.com");
+    assert(req.getHeader("CONNECTION") == "close");
+    assert(!req.keepAlive());
+    assert(req.getHeader("x-extra-39") == "39");
+    assert(req.getHeader("Range") == "bytes=0-99");
+    assert(req.getHeader("Missing").empty());
+    assert(req.headerCount() == HttpRequest::kInlineHeaders + 11);
+    context.reset();
+
+    // 第二个请求的请求体分多次到达时，首部需要保存下来
+    while (!context.gotAll())
+    {
+        assert(fed < request.size() || buf.readableBytes() > 0);
+        size_t n = std::min(chunk, request.size() - fed);
+        buf.append(request.data() + fed, n);
+        fed += n;
+        assert(context.parseRequest(&buf, Timestamp::now()));
+    }
+    assert(context.request().method() == HttpRequest::kPost);
+    assert(context.request().path() == "/form");
+    assert(context.request().getHeader("content-length") == "5");
+    assert(context.request().m_string == "hello");
+    assert(!context.request().keepAlive());
+    printf("headers chunk = %zu ok\n", chunk);
+}
+
+void testLargeBody(size_t chunk)
+{
+    std::string body(300000, 'x');
+    for (size_t i = 0; i < body.size(); ++i)
+    {
+        body[i] = static_cast<char>('a' + i % 26);
+    }
+    std::string request = "PUT /big HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+
+    HttpContext context;
+    Buffer buf;
+    for (int round = 0; round < 2; ++round)
+    {
+        size_t fed = 0;
+        while (!context.gotAll())
+        {
+            size_t n = std::min(chunk, request.size() - fed);
+            buf.append(request.data() + fed, n);
+            fed += n;
+            assert(context.parseRequest(&buf, Timestamp::now()));
+            // 请求体不在 Buffer 中累积
+            assert(buf.readableBytes() < chunk || context.gotAll());
+        }
+        assert(context.request().m_string == body);
+        context.reset();
+    }
+    printf("large body chunk = %zu ok\n", chunk);
+}
+
+void testBadHead()
+{
+    {
+        HttpContext context;
+        Buffer buf;
+        buf.append("GET / HTTP/1.1\r\nno colon here\r\n\r\n");
+        assert(!context.parseRequest(&buf, Timestamp::now()));
+    }
+    {
+        HttpContext context;
+        Buffer buf;
+        buf.append("GET / HTTP/1.1\r\nX: ");
+        buf.append(std::string(HttpContext::kMaxHeadSize, 'a'));
+        assert(!context.parseRequest(&buf, Timestamp::now()));
+    }
+    {
+        HttpContext context;
+        Buffer buf;
+        buf.append("POST / HTTP/1.1\r\nContent-Length: 12abc\r\n\r\n");
+        assert(!context.parseRequest(&buf, Timestamp::now()));
+    }
+    printf("bad head ok\n");
+}
+
+void testBadBoundary()
+{
+    HttpContext context;
+    Buffer buf;
+    std::string request = "POST /upload HTTP/1.1\r\n"
+                          "Content-Type: multipart/form-data\r\n"
+                          "Content-Length: 10\r\n\r\n";
+    buf.append(request);
+    assert(!context.parseRequest(&buf, Timestamp::now()));
+    printf("bad boundary ok\n");
+}
+
+// 读超时阶段: 请求行和首部 -> 请求体 -> 两个请求之间
+void testReadPhase()
+{
+    HttpContext context;
+    Buffer buf;
+    assert(!context.updateReadPhase(&buf));
+    assert(context.readPhase() == HttpContext::kBetweenRequests);
+
+    buf.append("POST /a HTTP/1.1\r\nContent-Le");
+    assert(context.parseRequest(&buf, Timestamp::now()));
+    assert(context.updateReadPhase(&buf));
+    assert(context.readPhase() == HttpContext::kReadingHead);
+
+    buf.append("ngth: 4\r\n\r\nab");
+    assert(context.parseRequest(&buf, Timestamp::now()));
+    assert(context.updateReadPhase(&buf));
+    assert(context.readPhase() == HttpContext::kReadingBody);
+    assert(!context.updateReadPhase(&buf));
+
+    buf.append("cd");
+    assert(context.parseRequest(&buf, Timestamp::now()));
+    assert(context.gotAll());
+    context.reset();
+    assert(context.updateReadPhase(&buf));
+    assert(context.readPhase() == HttpContext::kBetweenRequests);
+    printf("read phase ok\n");
+}
+
+int main()
+{
+    testMultipart(1);
+    testMultipart(7);
+    testMultipart(1024);
+    testMultipart(65536);
+    testBadBoundary();
+    testHeaders(1);
+    testHeaders(13);
+    testHeaders(4096);
+    testLargeBody(1000);
+    testLargeBody(65536);
+    testBadHead();
+    testReadPhase();
+    return 0;
+}
@@ -36,6 +36,9 @@ public:
     // 前端调用 append 写入日志
     void append(const char* logling, int len);
 
+    // 后端线程绑定的 CPU，需要在 start 之前设置，避免和 IO 线程抢同一个 CPU
+    void setCpuAffinity(const std::vector<int> &cpus) { thread_.setCpuAffinity(cpus); }
+
     void start()
     {
         running_ = true;
@@ -138,6 +138,12 @@ LogStream& LogStream::operator<<(const std::string& str)
     return *this;
 }
 
+LogStream& LogStream::operator<<(const StringPiece& str)
+{
+    buffer_.append(str.data(), str.size());
+    return *this;
+}
+
 LogStream& LogStream::operator<<(const Buffer& buf)
 {
     *this << buf.toString();
@@ -3,6 +3,7 @@
 
 #include "FixedBuffer.h"
 #include "noncopyable.h"
+#include "StringPiece.h"
 
 #include <string>
 
@@ -57,6 +58,7 @@ public:
     LogStream& operator<<(const char* str);
     LogStream& operator<<(const unsigned char* str);
     LogStream& operator<<(const std::string& str);
+    LogStream& operator<<(const StringPiece& str);
     LogStream& operator<<(const Buffer& buf);
 
     // (const char*, int)的重载
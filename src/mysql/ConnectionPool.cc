@@ -1,15 +1,26 @@
 #include "ConnectionPool.h"
+#include "ThreadPlacement.h"
 
 #include <fstream>
 #include <thread>
 #include <assert.h>
 
+namespace
+{
+std::vector<int> g_threadCpus;
+} // namespace
+
 ConnectionPool* ConnectionPool::getConnectionPool()
 {
     static ConnectionPool pool;
     return &pool;
 }
 
+void ConnectionPool::setThreadCpuAffinity(const std::vector<int> &cpus)
+{
+    g_threadCpus = cpus;
+}
+
 ConnectionPool::ConnectionPool()
 {
     // assert();
@@ -23,8 +34,16 @@ ConnectionPool::ConnectionPool()
         currentSize_++;
     }
     // 开启新线程执行任务
-    std::thread producer(&ConnectionPool::produceConnection, this);
-    std::thread recycler(&ConnectionPool::recycleConnection, this);
+    std::thread producer([this]() {
+        ThreadPlacement::setCurrentThreadName("MysqlProducer");
+        ThreadPlacement::bindCurrentThread(g_threadCpus);
+        produceConnection();
+    });
+    std::thread recycler([this]() {
+        ThreadPlacement::setCurrentThreadName("MysqlRecycler");
+        ThreadPlacement::bindCurrentThread(g_threadCpus);
+        recycleConnection();
+    });
     // 设置线程分离，不阻塞在此处
     producer.detach();
     recycler.detach();
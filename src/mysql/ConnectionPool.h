@@ -6,6 +6,7 @@
 using json = nlohmann::json; 
 
 #include <memory>
+#include <vector>
 #include <queue>
 #include <mutex>
 #include <condition_variable>
@@ -14,6 +15,8 @@ class ConnectionPool
 {
 public:
     static ConnectionPool* getConnectionPool();
+    // 后台创建、回收连接的线程绑定的 CPU，需要在第一次 getConnectionPool 之前设置
+    static void setThreadCpuAffinity(const std::vector<int> &cpus);
     std::shared_ptr<MysqlConn> getConnection();
     ~ConnectionPool();
 
@@ -1,10 +1,13 @@
 #include "Logging.h"
 #include "Acceptor.h"
 #include "InetAddress.h"
+#include "EventLoop.h"
 #include <functional>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 
 static int createNonblocking()
 {
@@ -21,7 +24,12 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &ListenAddr, bool reusepor
     : loop_(loop),
     acceptSocket_(createNonblocking()),
     acceptChannel_(loop, acceptSocket_.fd()),
-    listenning_(false)
+    listenning_(false),
+    acceptBatch_(kDefaultAcceptBatch),
+    idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+    accepted_(0),
+    rejected_(0),
+    fdLimitHits_(0)
 {
     LOG_DEBUG << "Acceptor create nonblocking socket, [fd = " << acceptChannel_.fd() << "]";
     // LOG_DEBUG("%s:%s:%d Acceptor create nonblocking socket, fd = %d\n", __FILE__, __FUNCTION__, __LINE__, acceptChannel_.fd());
@@ -38,12 +46,36 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &ListenAddr, bool reusepor
             std::bind(&Acceptor::handleRead, this));   
 }
 
+Acceptor::Acceptor(EventLoop *loop, int listenFd)
+    : loop_(loop),
+    acceptSocket_(listenFd),
+    acceptChannel_(loop, listenFd),
+    listenning_(false),
+    acceptBatch_(kDefaultAcceptBatch),
+    idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+    accepted_(0),
+    rejected_(0),
+    fdLimitHits_(0)
+{
+    LOG_DEBUG << "Acceptor adopt listening socket, [fd = " << listenFd << "]";
+    // 文件状态标志在进程间共享，fd 标志不共享，都重新设置一次
+    ::fcntl(listenFd, F_SETFL, ::fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+    ::fcntl(listenFd, F_SETFD, FD_CLOEXEC);
+    acceptChannel_.setReadCallback(
+            std::bind(&Acceptor::handleRead, this));
+}
+
 Acceptor::~Acceptor()
 {
-    // 把从Poller中感兴趣的事件删除掉
-    acceptChannel_.disableAll();    
-    // 调用EventLoop->removeChannel => Poller->removeChannel 把Poller的ChannelMap对应的部分删除
-    acceptChannel_.remove();       
+    // 开始监听之后 channel 才注册到 Poller 中
+    if (listenning_)
+    {
+        // 把从Poller中感兴趣的事件删除掉
+        acceptChannel_.disableAll();    
+        // 调用EventLoop->removeChannel => Poller->removeChannel 把Poller的ChannelMap对应的部分删除
+        acceptChannel_.remove();       
+    }
+    ::close(idleFd_);
 }
 
 void Acceptor::listen()
@@ -52,45 +84,102 @@ void Acceptor::listen()
     listenning_ = true;
     acceptSocket_.listen();
     // 将acceptChannel的读事件注册到poller
-    acceptChannel_.enableReading();
+    loop_->runInLoop(std::bind(&Channel::enableReading, &acceptChannel_));
 }
 
-// listenfd有事件发生了，就是有新用户连接了
+/**
+ * listenfd有事件发生了，就是有新用户连接了
+ * 一次最多 accept acceptBatch_ 个连接，直到 EAGAIN，连接风暴时减少 epoll_wait 次数
+ * 剩下的连接水平触发下一轮还会通知
+ */
 void Acceptor::handleRead()
 {
     // 使用了InetAddress类型定义对象，需要包含头文件
     // 之前为了不加载头文件使用了前置声明
     InetAddress peerAddr;
-    // 接受新连接
-    int connfd = acceptSocket_.accept(&peerAddr);
-    // 确实有新连接到来
-    if (connfd >= 0)
+    for (int i = 0; i < acceptBatch_; ++i)
     {
-        // TcpServer::NewConnectionCallback_
-        if (NewConnectionCallback_)
+        // 接受新连接
+        int connfd = acceptSocket_.accept(&peerAddr);
+        // 确实有新连接到来
+        if (connfd >= 0)
         {
-            // 轮询找到subLoop 唤醒并分发当前的新客户端的Channel
-            NewConnectionCallback_(connfd, peerAddr); 
+            accepted_.fetch_add(1, std::memory_order_relaxed);
+            // TcpServer::NewConnectionCallback_
+            if (NewConnectionCallback_)
+            {
+                // 轮询找到subLoop 唤醒并分发当前的新客户端的Channel
+                NewConnectionCallback_(connfd, peerAddr); 
+            }
+            else
+            {
+                LOG_DEBUG << "no newConnectionCallback() function";
+                ::close(connfd);
+            }
+            continue;
         }
-        else
+
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
         {
-            LOG_DEBUG << "no newConnectionCallback() function";
-            // LOG_DEBUG("connfd < 0 accept failed");
-            ::close(connfd);
+            // 队列里的连接已经取完
+            break;
+        }
+        if (savedErrno == EMFILE || savedErrno == ENFILE)
+        {
+            /**
+             * 当前进程的fd已经用完了，连接留在队列里的话水平触发会一直通知，loop 空转
+             * 用预留的 fd 接受后立即关闭，拒绝掉这个连接
+             * 可以调整单个服务器的fd上限，也可以分布式部署
+             */
+            logFdLimit();
+            if (!rejectOne())
+            {
+                break;
+            }
+            continue;
+        }
+        if (savedErrno == ECONNABORTED || savedErrno == EINTR || savedErrno == EPROTO)
+        {
+            // 对端在 accept 之前就断开了之类，不影响后面的连接
+            LOG_DEBUG << "accept() ignored errno " << savedErrno;
+            continue;
         }
+        errno = savedErrno;
+        LOG_ERROR << "accept() failed";
+        break;
     }
-    else
+}
+
+void Acceptor::logFdLimit()
+{
+    // fd 用完时每个连接都会走到这里，最多每 kFdLimitLogInterval 秒记录一次
+    ++fdLimitHits_;
+    Timestamp now(Timestamp::now());
+    if (lastFdLimitLog_.valid() && timeDifference(now, lastFdLimitLog_) < kFdLimitLogInterval)
     {
-        LOG_ERROR << "accept() failed";
-        // LOG_ERROR("%s:%s:%d accept err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+        return;
+    }
+    LOG_ERROR << "sockfd reached limit, rejected " << fdLimitHits_ << " connections";
+    lastFdLimitLog_ = now;
+    fdLimitHits_ = 0;
+}
 
-        // 当前进程的fd已经用完了
-        // 可以调整单个服务器的fd上限
-        // 也可以分布式部署
-        if (errno == EMFILE)
+bool Acceptor::rejectOne()
+{
+    bool rejected = false;
+    if (idleFd_ >= 0)
+    {
+        ::close(idleFd_);
+        int connfd = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+        if (connfd >= 0)
         {
-            LOG_ERROR << "sockfd reached limit";
-            // LOG_ERROR("%s:%s:%d sockfd reached limit\n", __FILE__, __FUNCTION__, __LINE__);
+            ::close(connfd);
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            rejected = true;
         }
     }
-}
\ No newline at end of file
+    // 预留的 fd 可能被别的线程抢先用掉，这时打开失败，下一次再试
+    idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return rejected;
+}
@@ -1,9 +1,13 @@
 #ifndef ACCEPTOR_H
 #define ACCEPTOR_H
 
+#include <stdint.h>
+#include <atomic>
+
 #include "noncopyable.h"
 #include "Socket.h"
 #include "Channel.h"
+#include "Timestamp.h"
 
 class EventLoop;
 class InetAddress;
@@ -18,6 +22,8 @@ public:
     // 接受新连接的回调函数
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
     Acceptor(EventLoop *loop, const InetAddress &ListenAddr, bool reuseport);
+    // 接管已经 bind、listen 的 socket，比如热重启时从旧进程收到的监听 fd
+    Acceptor(EventLoop *loop, int listenFd);
     ~Acceptor();
 
     void setNewConnectionCallback(const NewConnectionCallback &cb)
@@ -25,17 +31,47 @@ public:
         NewConnectionCallback_ = cb;
     }
 
+    EventLoop* loop() const { return loop_; }
+    int fd() const { return acceptSocket_.fd(); }
     bool listenning() const { return listenning_; }
+    /**
+     * 开始监听，可以在其他线程调用，监听 channel 会在 loop 线程里注册
+     * 多个 SO_REUSEPORT 监听 socket 按调用顺序加入内核的 reuseport 组
+     */
     void listen();
 
+    // 每次可读事件最多 accept 的连接数，默认 kDefaultAcceptBatch
+    void setAcceptBatch(int batch) { acceptBatch_ = batch > 0 ? batch : 1; }
+
+    // 累计接受的连接数和因为 fd 用完被拒绝的连接数，可以在其他线程读取
+    uint64_t acceptedCount() const { return accepted_.load(std::memory_order_relaxed); }
+    uint64_t rejectedCount() const { return rejected_.load(std::memory_order_relaxed); }
+
+    // SO_REUSEPORT 组的连接分配，见 Socket
+    void setIncomingCpu(int cpu) { acceptSocket_.setIncomingCpu(cpu); }
+    bool attachReusePortCpuBpf(const std::vector<int> &cpus) { return acceptSocket_.attachReusePortCpuBpf(cpus); }
+
+    static const int kDefaultAcceptBatch = 64;
+    // EMFILE/ENFILE 日志的最小间隔(秒)
+    static constexpr double kFdLimitLogInterval = 1.0;
+
 private:
     void handleRead();
+    // fd 用完时用预留的 fd 接受一个连接并立即关闭，让对端尽快知道被拒绝
+    bool rejectOne();
+    void logFdLimit();
 
     EventLoop *loop_; // Acceptor用的就是用户定义的BaseLoop
     Socket acceptSocket_;
     Channel acceptChannel_;
     NewConnectionCallback NewConnectionCallback_;
     bool listenning_; // 是否正在监听的标志
+    int acceptBatch_;
+    int idleFd_;      // 预留的空闲 fd(/dev/null)，EMFILE 时释放出来用
+    std::atomic<uint64_t> accepted_;
+    std::atomic<uint64_t> rejected_;
+    Timestamp lastFdLimitLog_;  // 上一次记录 fd 用完的时间
+    uint64_t fdLimitHits_;      // 上一次记录之后 fd 用完的次数
 };
 
 #endif // ACCEPTOR_H
\ No newline at end of file
@@ -1,24 +1,81 @@
 #include <errno.h>
 #include <sys/uio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "Buffer.h"
 #include "Logging.h"
 
 const char Buffer::kCRLF[] = "\r\n";
+char Buffer::s_empty[Buffer::kCheapPrepend];
+
+void Buffer::reallocate(size_t len)
+{
+    const size_t readable = readableBytes();
+    size_t need = std::max(kCheapPrepend + readable + len, initialSize_);
+    if (need > BufferAllocator::kMaxBlock && buffer_)
+    {
+        // 超出档位后按 1.5 倍增长，避免连续追加时反复搬移
+        need = std::max(need, capacity_ + capacity_ / 2);
+    }
+    size_t capacity = 0;
+    char *block = BufferAllocator::allocate(need, &capacity);
+    ::memcpy(block + kCheapPrepend, peek(), readable);
+    if (buffer_)
+    {
+        BufferAllocator::deallocate(buffer_, capacity_);
+    }
+    buffer_ = block;
+    capacity_ = capacity;
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend + readable;
+}
+
+void Buffer::shrink(size_t reserve)
+{
+    const size_t readable = readableBytes();
+    if (buffer_ == nullptr)
+    {
+        return;
+    }
+    if (readable == 0 && reserve == 0)
+    {
+        BufferAllocator::deallocate(buffer_, capacity_);
+        buffer_ = nullptr;
+        capacity_ = kCheapPrepend;
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = kCheapPrepend;
+        return;
+    }
+    // 换到能放下的最小档位，已经是最小的就不动
+    size_t capacity = 0;
+    char *block = BufferAllocator::allocate(kCheapPrepend + readable + reserve, &capacity);
+    if (capacity >= capacity_)
+    {
+        BufferAllocator::deallocate(block, capacity);
+        return;
+    }
+    ::memcpy(block + kCheapPrepend, peek(), readable);
+    BufferAllocator::deallocate(buffer_, capacity_);
+    buffer_ = block;
+    capacity_ = capacity;
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend + readable;
+}
 
 /**
  * 从fd上读取数据 Poller工作在LT模式
  * Buffer缓冲区是有大小的！ 但是从fd上读取数据的时候 却不知道tcp数据的最终大小
  *
  * @description: 从socket读到缓冲区的方法是使用readv先读至buffer_，
- * Buffer_空间如果不够会读入到栈上65536个字节大小的空间，然后以append的
+ * Buffer_空间如果不够会读入到线程共享的 64KB 读缓冲区，然后以append的
  * 方式追加入buffer_。既考虑了避免系统调用带来开销，又不影响数据的接收。
+ * 读缓冲区每个线程一块，不在栈上分配，也不需要每次清零；
+ * 没有分配内存的 Buffer 直接读到读缓冲区，再按实际读到的长度分配
  **/
 ssize_t Buffer::readFd(int fd, int *saveErrno)
 {
-    // 栈额外空间，用于从套接字往出读时，当buffer_暂时不够用时暂存数据，待buffer_重新分配足够空间后，在把数据交换给buffer_。
-    char extrabuf[65536] = {0}; // 栈上内存空间 65536/1024 = 64KB
+    char *extrabuf = BufferAllocator::threadReadBuffer();
 
     /*
     struct iovec {
@@ -30,39 +87,43 @@ ssize_t Buffer::readFd(int fd, int *saveErrno)
     // 使用iovec分配两个连续的缓冲区
     struct iovec vec[2];
     const size_t writable = writableBytes(); // 这是Buffer底层缓冲区剩余的可写空间大小 不一定能完全存储从fd读出的数据
+    int iovcnt = 0;
 
     // 第一块缓冲区，指向可写空间
-    vec[0].iov_base = begin() + writerIndex_;
-    vec[0].iov_len = writable;
-    // 第二块缓冲区，指向栈空间
-    vec[1].iov_base = extrabuf;
-    vec[1].iov_len = sizeof(extrabuf);
-
-    // when there is enough space in this buffer, don't read into extrabuf.
-    // when extrabuf is used, we read 128k-1 bytes at most.
-    // 这里之所以说最多128k-1字节，是因为若writable为64k-1，那么需要两个缓冲区 第一个64k-1 第二个64k 所以做多128k-1
-    // 如果第一个缓冲区>=64k 那就只采用一个缓冲区 而不使用栈空间extrabuf[65536]的内容
-    const int iovcnt = (writable < sizeof(extrabuf)) ? 2 : 1;
-    const ssize_t n = ::readv(fd, vec, iovcnt);
+    if (writable > 0)
+    {
+        vec[iovcnt].iov_base = beginWrite();
+        vec[iovcnt].iov_len = writable;
+        ++iovcnt;
+    }
+    // 第二块缓冲区，指向线程的读缓冲区
+    // 如果第一个缓冲区>=64k 那就只采用一个缓冲区，所以最多读 128k-1 字节
+    if (writable < BufferAllocator::kReadBufferSize)
+    {
+        vec[iovcnt].iov_base = extrabuf;
+        vec[iovcnt].iov_len = BufferAllocator::kReadBufferSize;
+        ++iovcnt;
+    }
+    const ssize_t n = iovcnt == 1 ? ::read(fd, vec[0].iov_base, vec[0].iov_len) : ::readv(fd, vec, iovcnt);
 
     if (n < 0)
     {
         *saveErrno = errno;
     }
-    else if (n <= writable) // Buffer的可写缓冲区已经够存储读出来的数据了
+    else if (static_cast<size_t>(n) <= writable) // Buffer的可写缓冲区已经够存储读出来的数据了
     {
         writerIndex_ += n;
     }
     else // extrabuf里面也写入了n-writable长度的数据
     {
-        writerIndex_ = buffer_.size();
+        writerIndex_ = capacity_;
         append(extrabuf, n - writable); // 对buffer_扩容 并将extrabuf存储的另一部分数据追加至buffer_
     }
     return n;
 }
 
 // inputBuffer_.readFd表示将对端数据读到inputBuffer_中，移动writerIndex_指针
-// outputBuffer_.writeFd表示将数据写入到outputBuffer_中，从readerIndex_开始，可以写readableBytes()个字节
+// writeFd表示将 readableBytes() 个字节从readerIndex_开始写入fd，不移动readerIndex_
 ssize_t Buffer::writeFd(int fd, int *saveErrno)
 {
     ssize_t n = ::write(fd, peek(), readableBytes());
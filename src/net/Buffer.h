@@ -1,7 +1,9 @@
 #ifndef BUFFER_H
 #define BUFFER_H
 
-#include <vector>
+#include "ByteScan.h"
+#include "BufferAllocator.h"
+
 #include <string>
 #include <algorithm>
 
@@ -11,20 +13,45 @@
 /// +-------------------+------------------+------------------+
 /// |                   |                  |                  |
 /// 0      <=      readerIndex   <=   writerIndex    <=     size
+///
+/// 内存由 BufferAllocator 按档位分配，扩容时不清零，只搬移可读的数据
+/// 第一次写入时才分配内存，shrink 可以把空闲的内存还回去，空的 Buffer 不占内存
 class Buffer
 {
 public:
     // prependable 初始大小，readIndex 初始位置
     static const size_t kCheapPrepend = 8;
-    // writeable 初始大小，writeIndex 初始位置  
-    // 刚开始 readerIndex 和 writerIndex 处于同一位置
+    // 第一次分配时至少分配的大小
     static const size_t kInitialSize = 1024;    
 
     explicit Buffer(size_t initialSize = kInitialSize)
-        :   buffer_(kCheapPrepend + initialSize),
+        :   buffer_(nullptr),
+            capacity_(kCheapPrepend),
+            initialSize_(initialSize),
             readerIndex_(kCheapPrepend),
             writerIndex_(kCheapPrepend)
         {}
+
+    Buffer(const Buffer &rhs)
+        :   Buffer(rhs.initialSize_)
+    {
+        append(rhs.peek(), rhs.readableBytes());
+    }
+
+    Buffer& operator=(const Buffer &rhs)
+    {
+        Buffer tmp(rhs);
+        swap(tmp);
+        return *this;
+    }
+
+    ~Buffer()
+    {
+        if (buffer_)
+        {
+            BufferAllocator::deallocate(buffer_, capacity_);
+        }
+    }
     
     /**
      * kCheapPrepend | reader | writer |
@@ -33,9 +60,9 @@ public:
     size_t readableBytes() const { return writerIndex_ - readerIndex_; }
     /**
      * kCheapPrepend | reader | writer |
-     * buffer_.size() - writerIndex_
+     * capacity_ - writerIndex_
      */   
-    size_t writableBytes() const { return buffer_.size() - writerIndex_; }
+    size_t writableBytes() const { return capacity_ - writerIndex_; }
     /**
      * kCheapPrepend | reader | writer |
      * wreaderIndex_
@@ -43,11 +70,24 @@ public:
     size_t prependableBytes() const { return readerIndex_; }
     void prepend(const void* /*restrict*/ data, size_t len) 
     {
+        if (buffer_ == nullptr)
+        {
+            reallocate(0);
+        }
         readerIndex_ -= len;
         const char* d = static_cast<const char*>(data);
         std::copy(d, d+len, begin()+readerIndex_);
     }
 
+    void swap(Buffer &rhs)
+    {
+        std::swap(buffer_, rhs.buffer_);
+        std::swap(capacity_, rhs.capacity_);
+        std::swap(initialSize_, rhs.initialSize_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+    }
+
     // 返回缓冲区中可读数据的起始地址
     const char* peek() const
     {
@@ -107,7 +147,7 @@ public:
         return result;
     }
 
-    // buffer_.size() - writeIndex_
+    // capacity_ - writeIndex_
     void ensureWritableBytes(size_t len)
     {
         if (writableBytes() < len)
@@ -136,10 +176,16 @@ public:
         writerIndex_ += len;
     }
 
+    // 向量化查找，见 ByteScan
     const char* findCRLF() const
     {
-        // FIXME: replace with memmem()?
-        const char* crlf = std::search(peek(), beginWrite(), kCRLF, kCRLF+2);
+        return findCRLF(peek());
+    }
+
+    // 从 start 开始查找，已经查找过的部分不需要重复扫描
+    const char* findCRLF(const char* start) const
+    {
+        const char* crlf = ByteScan::findCRLF(start, beginWrite());
         return crlf == beginWrite() ? NULL : crlf;
     }
 
@@ -153,6 +199,15 @@ public:
         return begin() + writerIndex_;
     }
 
+    // 底层占用的内存，没有分配时为 0
+    size_t internalCapacity() const { return buffer_ ? capacity_ : 0; }
+
+    /**
+     * 把内存缩小到刚好放下可读数据和 reserve 字节，用于突发流量之后归还内存
+     * 没有可读数据且 reserve 为 0 时释放全部内存
+     */
+    void shrink(size_t reserve);
+
     // 从fd上读取数据
     ssize_t readFd(int fd, int *saveErrno);
     // 通过fd发送数据
@@ -161,26 +216,28 @@ public:
 private:
     char* begin()
     {
-        // 获取buffer_起始地址
-        return &(*buffer_.begin());
+        // 获取buffer_起始地址，没有分配内存时指向一块只有 prependable 的静态空间
+        return buffer_ ? buffer_ : s_empty;
     }
 
     const char* begin() const
     {
-        return &(*buffer_.begin());
+        return buffer_ ? buffer_ : s_empty;
     }
 
-    // TODO:扩容操作
-    void makeSpace(int len)
+    // 换一块至少 kCheapPrepend + readable + len 的内存，只拷贝可读的数据
+    void reallocate(size_t len);
+
+    void makeSpace(size_t len)
     {
         /**
          * kCheapPrepend | reader | writer |
          * kCheapPrepend |       len         |
          */
         // 整个buffer都不够用
-        if (writableBytes() + prependableBytes() < len + kCheapPrepend)
+        if (buffer_ == nullptr || writableBytes() + prependableBytes() < len + kCheapPrepend)
         {
-            buffer_.resize(writerIndex_ + len);
+            reallocate(len);
         }
         else // 整个buffer够用，将后面移动到前面继续分配
         {
@@ -193,14 +250,13 @@ private:
         }
     }
 
-    /**
-     * 采取 vector 形式，可以自动分配内存
-     * 也可以提前预留空间大小、
-     */ 
-    std::vector<char> buffer_;
+    char *buffer_;          // 为空时 capacity_ 为 kCheapPrepend，begin() 指向 s_empty
+    size_t capacity_;
+    size_t initialSize_;
     size_t readerIndex_;
     size_t writerIndex_;
     static const char kCRLF[];
+    static char s_empty[kCheapPrepend];
 };
 
 #endif // BUFFER_H
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "BufferAllocator.h"
+
+#include <stdlib.h>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace
+{
+
+struct ThreadCache
+{
+    ~ThreadCache();
+
+    std::vector<char*> freeBlocks[BufferAllocator::kNumClasses];
+    size_t cachedBytes = 0;
+    std::unique_ptr<char[]> readBuffer;
+};
+
+thread_local ThreadCache t_cache;
+// 线程退出时 t_cache 可能先于其它对象析构，之后释放的内存直接 free
+__thread bool t_cacheDestroyed = false;
+
+ThreadCache::~ThreadCache()
+{
+    t_cacheDestroyed = true;
+    for (std::vector<char*> &blocks : freeBlocks)
+    {
+        for (char *block : blocks)
+        {
+            ::free(block);
+        }
+    }
+}
+
+// size 所在的档位，超过 kMaxBlock 返回 -1
+int sizeClass(size_t size)
+{
+    if (size > BufferAllocator::kMaxBlock)
+    {
+        return -1;
+    }
+    int index = 0;
+    size_t block = BufferAllocator::kMinBlock;
+    while (block < size)
+    {
+        block <<= 1;
+        ++index;
+    }
+    return index;
+}
+
+// 和 operator new 一样，内存不足时抛出 std::bad_alloc
+char* mallocOrThrow(size_t size)
+{
+    void *block = ::malloc(size);
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return static_cast<char*>(block);
+}
+
+} // namespace
+
+char* BufferAllocator::allocate(size_t size, size_t *capacity)
+{
+    int index = sizeClass(size);
+    if (index < 0)
+    {
+        // 大块按页取整
+        *capacity = (size + 4095) & ~static_cast<size_t>(4095);
+        return mallocOrThrow(*capacity);
+    }
+    *capacity = kMinBlock << index;
+    if (!t_cacheDestroyed)
+    {
+        std::vector<char*> &blocks = t_cache.freeBlocks[index];
+        if (!blocks.empty())
+        {
+            char *block = blocks.back();
+            blocks.pop_back();
+            t_cache.cachedBytes -= *capacity;
+            return block;
+        }
+    }
+    return mallocOrThrow(*capacity);
+}
+
+void BufferAllocator::deallocate(char *block, size_t capacity)
+{
+    int index = sizeClass(capacity);
+    if (index >= 0 && !t_cacheDestroyed)
+    {
+        std::vector<char*> &blocks = t_cache.freeBlocks[index];
+        if ((blocks.size() + 1) * capacity <= kCachedBytesPerClass)
+        {
+            blocks.push_back(block);
+            t_cache.cachedBytes += capacity;
+            return;
+        }
+    }
+    ::free(block);
+}
+
+char* BufferAllocator::threadReadBuffer()
+{
+    if (!t_cache.readBuffer)
+    {
+        t_cache.readBuffer.reset(new char[kReadBufferSize]);
+    }
+    return t_cache.readBuffer.get();
+}
+
+size_t BufferAllocator::threadCachedBytes()
+{
+    return t_cacheDestroyed ? 0 : t_cache.cachedBytes;
+}
@@ -0,0 +1,34 @@
+#ifndef BUFFER_ALLOCATOR_H
+#define BUFFER_ALLOCATOR_H
+
+#include <stddef.h>
+
+/**
+ * Buffer 底层内存的分配
+ * 256B 到 64KB 按 2 的幂分成 9 档，每个线程缓存每一档释放的内存块，下次分配直接复用；
+ * 更大的内存直接 malloc。分配的内存不清零
+ * 内存可以在分配以外的线程释放，放进释放线程的缓存
+ */
+class BufferAllocator
+{
+public:
+    static const size_t kMinBlock = 256;
+    static const size_t kMaxBlock = 64 * 1024;
+    static const int kNumClasses = 9;
+    // 每个线程每一档最多缓存的字节数，超过的直接 free
+    static const size_t kCachedBytesPerClass = 256 * 1024;
+    static const size_t kReadBufferSize = 64 * 1024;
+
+    // 分配至少 size 字节，*capacity 返回实际大小，内存不足时抛出 std::bad_alloc
+    static char* allocate(size_t size, size_t *capacity);
+    // capacity 必须是 allocate 返回的大小
+    static void deallocate(char *block, size_t capacity);
+
+    // 每个线程一块 kReadBufferSize 的读缓冲区，Buffer::readFd 空间不够时先读到这里
+    static char* threadReadBuffer();
+
+    // 当前线程缓存的字节数
+    static size_t threadCachedBytes();
+};
+
+#endif // BUFFER_ALLOCATOR_H
@@ -0,0 +1,258 @@
+#include "ByteScan.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define BYTESCAN_X86 1
+#endif
+
+namespace ByteScan
+{
+
+namespace scalar
+{
+
+// glibc 的 memchr 本身是向量化的，标量实现以它为基础
+const char* findByte(const char *begin, const char *end, char c)
+{
+    const void *p = memchr(begin, c, end - begin);
+    return p ? static_cast<const char*>(p) : end;
+}
+
+const char* findCRLF(const char *begin, const char *end)
+{
+    const char *p = begin;
+    while ((p = findByte(p, end, '\r')) != end)
+    {
+        if (end - p >= 2 && p[1] == '\n')
+        {
+            return p;
+        }
+        ++p;
+    }
+    return end;
+}
+
+const char* findDoubleCRLF(const char *begin, const char *end)
+{
+    const char *p = begin;
+    while ((p = findCRLF(p, end)) != end)
+    {
+        if (end - p >= 4 && p[2] == '\r' && p[3] == '\n')
+        {
+            return p;
+        }
+        ++p;
+    }
+    return end;
+}
+
+const char* find(const char *begin, const char *end, const char *needle, size_t len)
+{
+    if (len == 0)
+    {
+        return begin;
+    }
+    const char *p = begin;
+    while (static_cast<size_t>(end - p) >= len && (p = findByte(p, end - len + 1, needle[0])) != end - len + 1)
+    {
+        if (memcmp(p + 1, needle + 1, len - 1) == 0)
+        {
+            return p;
+        }
+        ++p;
+    }
+    return end;
+}
+
+// 从 begin 开始查找，lineStart 是 begin 所在行的开头
+size_t findLines(const char *begin, const char *end, const char **lineEnds, size_t maxLines,
+                 const char *lineStart)
+{
+    size_t count = 0;
+    const char *p = begin;
+    while (count < maxLines && (p = findCRLF(p, end)) != end)
+    {
+        lineEnds[count++] = p;
+        if (p == lineStart)
+        {
+            break;
+        }
+        lineStart = p + 2;
+        p = lineStart;
+    }
+    return count;
+}
+
+size_t findLines(const char *begin, const char *end, const char **lineEnds, size_t maxLines)
+{
+    return findLines(begin, end, lineEnds, maxLines, begin);
+}
+
+} // namespace scalar
+
+#ifdef BYTESCAN_X86
+
+// SSE2 是 x86_64 的基本指令集，不需要检测
+namespace sse2
+{
+#define BYTESCAN_WIDTH 16
+#define BYTESCAN_VEC __m128i
+#define BYTESCAN_LOAD(p) _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))
+#define BYTESCAN_SET1(c) _mm_set1_epi8(c)
+#define BYTESCAN_EQ_MASK(v, s) static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, s)))
+#include "ByteScanKernel.inc"
+#undef BYTESCAN_WIDTH
+#undef BYTESCAN_VEC
+#undef BYTESCAN_LOAD
+#undef BYTESCAN_SET1
+#undef BYTESCAN_EQ_MASK
+} // namespace sse2
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace avx2
+{
+#define BYTESCAN_WIDTH 32
+#define BYTESCAN_VEC __m256i
+#define BYTESCAN_LOAD(p) _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))
+#define BYTESCAN_SET1(c) _mm256_set1_epi8(c)
+#define BYTESCAN_EQ_MASK(v, s) static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, s)))
+#include "ByteScanKernel.inc"
+#undef BYTESCAN_WIDTH
+#undef BYTESCAN_VEC
+#undef BYTESCAN_LOAD
+#undef BYTESCAN_SET1
+#undef BYTESCAN_EQ_MASK
+} // namespace avx2
+#pragma GCC pop_options
+
+#endif // BYTESCAN_X86
+
+namespace
+{
+
+struct Kernels
+{
+    Level level;
+    const char* (*findCRLF)(const char*, const char*);
+    const char* (*findDoubleCRLF)(const char*, const char*);
+    const char* (*find)(const char*, const char*, const char*, size_t);
+    size_t (*findLines)(const char*, const char*, const char**, size_t);
+};
+
+const Kernels kScalarKernels = {
+    kScalar, scalar::findCRLF, scalar::findDoubleCRLF, scalar::find, scalar::findLines
+};
+#ifdef BYTESCAN_X86
+const Kernels kSse2Kernels = {
+    kSse2, sse2::findCRLF, sse2::findDoubleCRLF, sse2::find, sse2::findLines
+};
+const Kernels kAvx2Kernels = {
+    kAvx2, avx2::findCRLF, avx2::findDoubleCRLF, avx2::find, avx2::findLines
+};
+#endif
+
+bool supported(Level level)
+{
+#ifdef BYTESCAN_X86
+    if (level == kAvx2)
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+    return true;
+#else
+    return level == kScalar;
+#endif
+}
+
+const Kernels* kernelsFor(Level level)
+{
+#ifdef BYTESCAN_X86
+    if (level == kAvx2)
+        return &kAvx2Kernels;
+    if (level == kSse2)
+        return &kSse2Kernels;
+#endif
+    return &kScalarKernels;
+}
+
+Level defaultLevel()
+{
+#ifdef __OPTIMIZE__
+    return supported(kAvx2) ? kAvx2 : kScalar;
+#else
+    return kScalar;
+#endif
+}
+
+// 第一次使用时选择默认实现，setLevel 可能在其他线程修改
+std::atomic<const Kernels*>& active()
+{
+    static std::atomic<const Kernels*> kernels(kernelsFor(defaultLevel()));
+    return kernels;
+}
+
+const Kernels* current()
+{
+    return active().load(std::memory_order_acquire);
+}
+
+} // namespace
+
+Level level()
+{
+    return current()->level;
+}
+
+const char* levelName(Level level)
+{
+    switch (level)
+    {
+        case kAvx2: return "avx2";
+        case kSse2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+bool setLevel(Level level)
+{
+    if (!supported(level))
+    {
+        return false;
+    }
+    active().store(kernelsFor(level), std::memory_order_release);
+    return true;
+}
+
+const char* findCRLF(const char *begin, const char *end)
+{
+    return current()->findCRLF(begin, end);
+}
+
+const char* findDoubleCRLF(const char *begin, const char *end)
+{
+    return current()->findDoubleCRLF(begin, end);
+}
+
+const char* findByte(const char *begin, const char *end, char c)
+{
+    return scalar::findByte(begin, end, c);
+}
+
+const char* find(const char *begin, const char *end, const char *needle, size_t len)
+{
+    return current()->find(begin, end, needle, len);
+}
+
+size_t findLines(const char *begin, const char *end, const char **lineEnds, size_t maxLines)
+{
+    return current()->findLines(begin, end, lineEnds, maxLines);
+}
+
+} // namespace ByteScan
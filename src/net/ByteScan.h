@@ -0,0 +1,50 @@
+#ifndef BYTE_SCAN_H
+#define BYTE_SCAN_H
+
+#include <stddef.h>
+
+/**
+ * HTTP 解析用的字节扫描函数
+ * x86_64 上 CPU 支持 AVX2 时在运行时选择 AVX2 实现，否则使用标量实现(基于 glibc 的 memchr)
+ * 典型请求首部上 -O2 时 AVX2 约为标量的两倍，SSE2 和标量差不多，所以不会默认选择 SSE2
+ * 不开优化编译时(仓库默认的 -g)intrinsic 不会内联，向量实现比标量慢，默认也使用标量
+ * 所有函数在 [begin, end) 中查找，找不到返回 end
+ */
+namespace ByteScan
+{
+
+enum Level
+{
+    kScalar,
+    kSse2,
+    kAvx2,
+};
+
+// 当前使用的实现
+Level level();
+const char* levelName(Level level);
+// 强制使用某个实现，CPU 不支持时返回 false，测试用，可以和扫描函数在不同线程同时调用
+bool setLevel(Level level);
+
+// 第一个 "\r\n" 中 '\r' 的位置
+const char* findCRLF(const char *begin, const char *end);
+
+// 第一个 "\r\n\r\n" 的位置
+const char* findDoubleCRLF(const char *begin, const char *end);
+
+// 第一个字节 c 的位置
+const char* findByte(const char *begin, const char *end, char c);
+
+// 第一个子串 [needle, needle+len) 的位置，用于 multipart 分隔符
+const char* find(const char *begin, const char *end, const char *needle, size_t len);
+
+/**
+ * 一次扫描找出首部块中每一行的 "\r\n"，begin 必须是一行的开头
+ * 把每行 '\r' 的位置依次写入 lineEnds，遇到空行(首部结束)或写满 maxLines 时停止
+ * 返回找到的行数，空行也计算在内
+ */
+size_t findLines(const char *begin, const char *end, const char **lineEnds, size_t maxLines);
+
+} // namespace ByteScan
+
+#endif // BYTE_SCAN_H
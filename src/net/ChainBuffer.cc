@@ -0,0 +1,229 @@
+#include "ChainBuffer.h"
+#include "BufferAllocator.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+ChainBuffer::ChainBuffer()
+    : bytes_(0)
+{
+}
+
+ChainBuffer::~ChainBuffer()
+{
+    retrieveAll();
+}
+
+ChainBuffer::Block ChainBuffer::newBlock(size_t size)
+{
+    Block block;
+    block.data = BufferAllocator::allocate(size, &block.capacity);
+    block.begin = 0;
+    block.end = 0;
+    return block;
+}
+
+void ChainBuffer::freeBlock(const Block &block)
+{
+    BufferAllocator::deallocate(block.data, block.capacity);
+}
+
+void ChainBuffer::append(const char *data, size_t len)
+{
+    bytes_ += len;
+    while (len > 0)
+    {
+        if (blocks_.empty() || blocks_.back().end == blocks_.back().capacity)
+        {
+            blocks_.push_back(newBlock(kBlockSize));
+        }
+        Block &tail = blocks_.back();
+        size_t n = std::min(len, tail.capacity - tail.end);
+        ::memcpy(tail.data + tail.end, data, n);
+        tail.end += n;
+        data += n;
+        len -= n;
+    }
+}
+
+const char* ChainBuffer::peek() const
+{
+    return blocks_.empty() ? nullptr : blocks_.front().data + blocks_.front().begin;
+}
+
+size_t ChainBuffer::contiguousBytes() const
+{
+    return blocks_.empty() ? 0 : blocks_.front().end - blocks_.front().begin;
+}
+
+const char* ChainBuffer::linearize(size_t len)
+{
+    len = std::min(len, bytes_);
+    if (len <= contiguousBytes())
+    {
+        return peek();
+    }
+    // 跨块的部分搬进一块新块，放在最前面
+    Block merged = newBlock(len);
+    size_t copied = 0;
+    while (copied < len)
+    {
+        Block &front = blocks_.front();
+        size_t n = std::min(len - copied, front.end - front.begin);
+        ::memcpy(merged.data + copied, front.data + front.begin, n);
+        copied += n;
+        front.begin += n;
+        if (front.begin == front.end)
+        {
+            freeBlock(front);
+            blocks_.pop_front();
+        }
+    }
+    merged.end = len;
+    blocks_.push_front(merged);
+    return peek();
+}
+
+int ChainBuffer::fillIovec(struct iovec *vec, int maxIov) const
+{
+    int count = 0;
+    for (auto it = blocks_.begin(); it != blocks_.end() && count < maxIov; ++it)
+    {
+        if (it->end > it->begin)
+        {
+            vec[count].iov_base = it->data + it->begin;
+            vec[count].iov_len = it->end - it->begin;
+            ++count;
+        }
+    }
+    return count;
+}
+
+void ChainBuffer::retrieve(size_t len)
+{
+    len = std::min(len, bytes_);
+    bytes_ -= len;
+    while (len > 0)
+    {
+        Block &front = blocks_.front();
+        size_t n = std::min(len, front.end - front.begin);
+        front.begin += n;
+        len -= n;
+        if (front.begin == front.end)
+        {
+            freeBlock(front);
+            blocks_.pop_front();
+        }
+    }
+}
+
+void ChainBuffer::retrieveAll()
+{
+    for (const Block &block : blocks_)
+    {
+        freeBlock(block);
+    }
+    blocks_.clear();
+    bytes_ = 0;
+}
+
+void ChainBuffer::retrieveInto(std::string *output, size_t len)
+{
+    len = std::min(len, bytes_);
+    output->reserve(output->size() + len);
+    size_t left = len;
+    for (auto it = blocks_.begin(); left > 0; ++it)
+    {
+        size_t n = std::min(left, it->end - it->begin);
+        output->append(it->data + it->begin, n);
+        left -= n;
+    }
+    retrieve(len);
+}
+
+std::string ChainBuffer::retrieveAsString(size_t len)
+{
+    std::string result;
+    retrieveInto(&result, len);
+    return result;
+}
+
+/**
+ * 读进队尾块的剩余空间和 kReadBlocks 个新块，没有用到的新块还回去
+ * 新块来自线程的缓存，分配和归还的开销很小
+ */
+ssize_t ChainBuffer::readFd(int fd, int *savedErrno)
+{
+    struct iovec vec[kReadBlocks + 1];
+    Block fresh[kReadBlocks];
+    int iovcnt = 0;
+    size_t tailSpace = 0;
+    if (!blocks_.empty() && blocks_.back().end < blocks_.back().capacity)
+    {
+        Block &tail = blocks_.back();
+        tailSpace = tail.capacity - tail.end;
+        vec[iovcnt].iov_base = tail.data + tail.end;
+        vec[iovcnt].iov_len = tailSpace;
+        ++iovcnt;
+    }
+    for (int i = 0; i < kReadBlocks; ++i)
+    {
+        fresh[i] = newBlock(kBlockSize);
+        vec[iovcnt].iov_base = fresh[i].data;
+        vec[iovcnt].iov_len = fresh[i].capacity;
+        ++iovcnt;
+    }
+
+    const ssize_t n = ::readv(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *savedErrno = errno;
+    }
+    size_t left = n > 0 ? static_cast<size_t>(n) : 0;
+    bytes_ += left;
+    if (tailSpace > 0)
+    {
+        size_t used = std::min(left, tailSpace);
+        blocks_.back().end += used;
+        left -= used;
+    }
+    for (int i = 0; i < kReadBlocks; ++i)
+    {
+        if (left > 0)
+        {
+            fresh[i].end = std::min(left, fresh[i].capacity);
+            left -= fresh[i].end;
+            blocks_.push_back(fresh[i]);
+        }
+        else
+        {
+            freeBlock(fresh[i]);
+        }
+    }
+    return n;
+}
+
+ssize_t ChainBuffer::writeFd(int fd, int *savedErrno)
+{
+    struct iovec vec[IOV_MAX];
+    int iovcnt = fillIovec(vec, IOV_MAX);
+    if (iovcnt == 0)
+    {
+        return 0;
+    }
+    const ssize_t n = iovcnt == 1 ? ::write(fd, vec[0].iov_base, vec[0].iov_len) : ::writev(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *savedErrno = errno;
+        return n;
+    }
+    retrieve(n);
+    return n;
+}
@@ -0,0 +1,73 @@
+#ifndef CHAIN_BUFFER_H
+#define CHAIN_BUFFER_H
+
+#include "noncopyable.h"
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <deque>
+#include <string>
+
+/**
+ * 由固定大小的内存块组成的缓冲区，块由 BufferAllocator 分配
+ * 和 Buffer 不同，追加数据时不需要扩容搬移已有的数据，取走数据时整块归还
+ * readFd 用 readv 直接读进多个块，writeFd 用 writev 跨块发送
+ * 数据不保证连续: peek() 只是第一块中的数据，需要连续的视图时用 linearize
+ */
+class ChainBuffer : noncopyable
+{
+public:
+    static const size_t kBlockSize = 16 * 1024;
+    // readFd 一次最多准备的新块数
+    static const int kReadBlocks = 4;
+
+    ChainBuffer();
+    ~ChainBuffer();
+
+    size_t readableBytes() const { return bytes_; }
+    bool empty() const { return bytes_ == 0; }
+
+    void append(const char *data, size_t len);
+    void append(const std::string &str) { append(str.data(), str.size()); }
+
+    // 第一段连续的数据
+    const char* peek() const;
+    size_t contiguousBytes() const;
+
+    /**
+     * 让前 len 个字节连续存放，返回起始地址
+     * 已经在同一块中时不拷贝，否则把它们搬进一块足够大的新块
+     */
+    const char* linearize(size_t len);
+
+    // 把可读数据按块填入 vec，最多 maxIov 段，返回段数
+    int fillIovec(struct iovec *vec, int maxIov) const;
+
+    void retrieve(size_t len);
+    void retrieveAll();
+    std::string retrieveAsString(size_t len);
+    std::string retrieveAllAsString() { return retrieveAsString(bytes_); }
+    // 取出前 len 个字节追加到 output 后面
+    void retrieveInto(std::string *output, size_t len);
+
+    ssize_t readFd(int fd, int *savedErrno);
+    // 写出的部分从缓冲区中取走
+    ssize_t writeFd(int fd, int *savedErrno);
+
+private:
+    struct Block
+    {
+        char *data;
+        size_t capacity;
+        size_t begin;   // 可读数据 [begin, end)
+        size_t end;
+    };
+
+    Block newBlock(size_t size);
+    void freeBlock(const Block &block);
+
+    std::deque<Block> blocks_;
+    size_t bytes_;
+};
+
+#endif // CHAIN_BUFFER_H
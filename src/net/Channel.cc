@@ -11,6 +11,8 @@ Channel::Channel(EventLoop *loop, int fd)
         events_(0),
         revents_(0),
         index_(-1),
+        writing_(false),
+        edgeTriggered_(false),
         tied_(false)
 {
 }
@@ -28,6 +30,32 @@ void Channel::tie(const std::shared_ptr<void> &obj)
     tied_ = true;
 }
 
+void Channel::enableWriting()
+{
+    writing_ = true;
+    // 边缘触发模式下 EPOLLOUT 已经注册过就不需要再 epoll_ctl
+    if (!(events_ & kWriteEvent))
+    {
+        events_ |= kWriteEvent | edgeEvents();
+        update();
+    }
+}
+
+void Channel::disableWriting()
+{
+    writing_ = false;
+    if (!edgeTriggered_)
+    {
+        events_ &= ~kWriteEvent;
+        update();
+    }
+}
+
+void Channel::setEdgeTriggered(bool on)
+{
+    edgeTriggered_ = on && loop_->supportsEdgeTriggered();
+}
+
 /**
  * 当改变channel所表示fd的events事件后，update负责在poller里面更改fd相应的事件epoll_ctl 
  * 
@@ -106,8 +134,8 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
         }
     }
 
-    // 写事件
-    if (revents_ & EPOLLOUT)
+    // 写事件，边缘触发模式下 EPOLLOUT 一直注册着，没有待写数据时忽略
+    if ((revents_ & EPOLLOUT) && writing_)
     {
         if (writeCallback_)
         {
@@ -44,15 +44,25 @@ public:
     void  set_revents(int revt) { revents_ = revt; }  // 设置Poller返回的发生事件
 
     // 设置fd相应的事件状态，update()其本质调用epoll_ctl
-    void enableReading() { events_ |= kReadEvent; update(); }
+    void enableReading() { events_ |= kReadEvent | edgeEvents(); update(); }
     void disableReading() { events_ &= ~kReadEvent; update(); }
-    void enableWriting() { events_ |= kWriteEvent; update(); }
-    void disableWriting() { events_ &= ~kWriteEvent; update(); }
-    void disableAll() { events_ &= kNoneEvent; update(); }
+    void enableWriting();
+    void disableWriting();
+    void disableAll() { events_ &= kNoneEvent; writing_ = false; update(); }
+
+    /**
+     * 边缘触发(EPOLLET)模式，需要在第一次 enableReading 之前设置
+     * 这种模式下 EPOLLOUT 和 EPOLLIN 一起注册并一直保持，enableWriting/disableWriting
+     * 只修改 writing_ 标志，不再调用 epoll_ctl；没有待写数据时的 EPOLLOUT 直接忽略
+     * 使用者必须在读写回调里一直读/写到 EAGAIN，否则不会再收到通知
+     * Poller 不支持边缘触发(poll/io_uring)时保持水平触发
+     */
+    void setEdgeTriggered(bool on);
+    bool isEdgeTriggered() const { return edgeTriggered_; }
 
     // 返回fd当前的事件状态
     bool isNoneEvent() const { return events_ == kNoneEvent; }
-    bool isWriting() const { return events_ & kWriteEvent; }
+    bool isWriting() const { return writing_; }
     bool isReading() const { return events_ & kReadEvent; }
 
     /**
@@ -70,6 +80,8 @@ public:
 
 private:
     void update();
+    // 边缘触发模式下每次注册都要带上的事件
+    int edgeEvents() const { return edgeTriggered_ ? (EPOLLET | kWriteEvent) : kNoneEvent; }
     void handleEventWithGuard(Timestamp receiveTime);
 
     /**
@@ -86,6 +98,8 @@ private:
     int events_;        // 注册fd感兴趣的事件
     int revents_;       // poller返回的具体发生的事件
     int index_;         // 在Poller上注册的情况
+    bool writing_;      // 是否有数据等待 EPOLLOUT，边缘触发模式下和 events_ 中的 EPOLLOUT 不一定一致
+    bool edgeTriggered_;
 
     std::weak_ptr<void> tie_;   // 弱指针指向TcpConnection(必要时升级为shared_ptr多一份引用计数，避免用户误删)
     bool tied_;  // 标志此 Channel 是否被调用过 Channel::tie 方法
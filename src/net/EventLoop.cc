@@ -1,6 +1,8 @@
 #include "EventLoop.h"
 #include "Logging.h"
 #include "Poller.h"
+#include "TimeoutWheel.h"
+#include "FixedBlockPool.h"
 #include <unistd.h>
 #include <sys/eventfd.h>
 #include <fcntl.h>
@@ -31,7 +33,14 @@ EventLoop::EventLoop() :
     timerQueue_(new TimerQueue(this)),
     wakeupFd_(createEventfd()),
     wakeupChannel_(new Channel(this, wakeupFd_)),
-    currentActiveChannel_(nullptr)
+    currentActiveChannel_(nullptr),
+    wakeupPending_(false),
+    busyPollUs_(0),
+    spinning_(false),
+    connections_(0),
+    pendingBytes_(0),
+    connectionPool_(std::make_shared<FixedBlockPool>()),
+    controlBlockPool_(std::make_shared<FixedBlockPool>())
 {
     LOG_DEBUG << "EventLoop created " << this << " the index is " << threadId_;
     LOG_DEBUG << "EventLoop created wakeupFd " << wakeupChannel_->fd();
@@ -75,7 +84,7 @@ void EventLoop::loop()
         // 清空activeChannels_
         activeChannels_.clear();
         // 获取
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        pollReturnTime_ = poller_->poll(pollTimeout(), &activeChannels_);
         for (Channel *channel : activeChannels_)
         {
             channel->handleEvent(pollReturnTime_);
@@ -86,7 +95,20 @@ void EventLoop::loop()
          * mainLoop实现注册一个回调，交给subLoop来执行，wakeup subLoop 之后，让其执行注册的回调操作
          * 这些回调函数在 std::vector<Functor> pendingFunctors_; 之中
          */
-        doPendingFunctors();
+        size_t functors = doPendingFunctors();
+
+        // 有活动时延长忙轮询的时间
+        const int spinUs = busyPollUs_.load(std::memory_order_relaxed);
+        if (spinUs > 0 && (!activeChannels_.empty() || functors > 0))
+        {
+            spinUntil_ = addTime(pollReturnTime_, spinUs / 1000000.0);
+        }
+    }
+    if (spinning_)
+    {
+        // 退出之后 queueInLoop 要重新写 eventfd
+        spinning_ = false;
+        wakeupPending_.store(false, std::memory_order_release);
     }
     looping_ = false;    
 }
@@ -101,14 +123,14 @@ void EventLoop::quit()
      * 比如在工作线程(subLoop)中调用了IO线程(mainLoop)
      * 这种情况会唤醒主线程
      */
-    if (isInLoopThread())
+    if (!isInLoopThread())
     {
         wakeup();
     }
 }
 
 // 在当前eventLoop中执行回调函数
-void EventLoop::runInLoop(Functor cb)
+void EventLoop::runInLoop(Task cb)
 {
     // 每个EventLoop都保存创建自己的线程tid
     // 我们可以通过CurrentThread::tid()获取当前执行线程的tid然后和EventLoop保存的进行比较
@@ -119,16 +141,13 @@ void EventLoop::runInLoop(Functor cb)
     // 在非当前eventLoop线程中执行回调函数，需要唤醒evevntLoop所在线程
     else
     {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
     }
 }
 
-void EventLoop::queueInLoop(Functor cb)
+void EventLoop::queueInLoop(Task cb)
 {
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        pendingFunctors_.emplace_back(cb); // 使用了std::move
-    }
+    pendingFunctors_.push(std::move(cb));
 
     // 唤醒相应的，需要执行上面回调操作的loop线程
     /** 
@@ -137,8 +156,8 @@ void EventLoop::queueInLoop(Functor cb)
      * 这个 || callingPendingFunctors_ 比较有必要，因为在执行回调的过程可能会加入新的回调
      * 则这个时候也需要唤醒，否则就会发生有事件到来但是仍被阻塞住的情况
      */
-    if (!isInLoopThread() || callingPendingFunctors_)
-    
+    if ((!isInLoopThread() || callingPendingFunctors_)
+        && !wakeupPending_.exchange(true, std::memory_order_acq_rel))
     {
         // 唤醒loop所在的线程
         wakeup();
@@ -180,26 +199,61 @@ bool EventLoop::hasChannel(Channel *channel)
     return poller_->hasChannel(channel);    
 }
 
-void EventLoop::doPendingFunctors()
+bool EventLoop::supportsEdgeTriggered() const
 {
-    std::vector<Functor> functors;
-    callingPendingFunctors_ = true;
+    return poller_->supportsEdgeTriggered();
+}
 
-    /**
-     * TODO:
-     * 如果没有生成这个局部的 functors
-     * 则在互斥锁加持下，我们直接遍历pendingFunctors
-     * 其他线程这个时候无法访问，无法向里面注册回调函数，增加服务器时延
-     */
+TimeoutWheel* EventLoop::timeoutWheel()
+{
+    if (!timeoutWheel_)
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        functors.swap(pendingFunctors_);
+        timeoutWheel_.reset(new TimeoutWheel(this));
     }
+    return timeoutWheel_.get();
+}
 
-    for (const Functor &functor : functors)
+int EventLoop::pollTimeout()
+{
+    if (busyPollUs_.load(std::memory_order_relaxed) > 0 && Timestamp::now() < spinUntil_)
+    {
+        if (!spinning_)
+        {
+            // 空转期间每一轮都会检查队列，让生产者不用写 eventfd
+            spinning_ = true;
+            wakeupPending_.store(true, std::memory_order_release);
+        }
+        return 0;
+    }
+    if (spinning_)
+    {
+        spinning_ = false;
+        // 清除之后 push 的任务会写 eventfd，清除之前 push 的没有唤醒，阻塞之前先检查队列
+        wakeupPending_.exchange(false, std::memory_order_acq_rel);
+        if (!pendingFunctors_.empty())
+        {
+            return 0;
+        }
+    }
+    return kPollTimeMs;
+}
+
+size_t EventLoop::doPendingFunctors()
+{
+    callingPendingFunctors_ = true;
+
+    /**
+     * 先清除唤醒标志再取任务:
+     * 清除之前 push 的任务这一轮一定能取到，清除之后 push 的任务会重新写 eventfd
+     * 只执行开始时已经在队列里的任务，执行过程中新加入的留到下一轮
+     * 忙轮询期间不清除，下一轮 poll 不阻塞，一样能取到
+     */
+    if (!spinning_)
     {
-        functor();
+        wakeupPending_.exchange(false, std::memory_order_acq_rel);
     }
+    size_t count = pendingFunctors_.runAll();
 
     callingPendingFunctors_ = false;
+    return count;
 }
@@ -5,14 +5,17 @@
 #include "Timestamp.h"
 #include "CurrentThread.h"
 #include "TimerQueue.h"
+#include "Task.h"
+#include "TaskQueue.h"
 #include <functional>
 #include <vector>
 #include <memory>
 #include <atomic>
-#include <mutex>
 
 class Channel;
 class Poller;
+class TimeoutWheel;
+class FixedBlockPool;
 // 事件循环类 主要包含了两大模块，channel poller
 class EventLoop : noncopyable
 {
@@ -28,7 +31,7 @@ public:
     Timestamp pollReturnTime() const { return pollReturnTime_; }
 
     // 在当前线程同步调用函数
-    void runInLoop(Functor cb);
+    void runInLoop(Task cb);
     /**
      * 把cb放入队列，唤醒loop所在的线程执行cb
      * 
@@ -36,39 +39,88 @@ public:
      * 在mainLoop中获取subLoop指针，然后调用相应函数
      * 在queueLoop中发现当前的线程不是创建这个subLoop的线程，将此函数装入subLoop的pendingFunctors容器中
      * 之后mainLoop线程会调用subLoop::wakeup向subLoop的eventFd写数据，以此唤醒subLoop来执行pengdingFunctors
+     *
+     * pendingFunctors_ 是无锁队列，cb 移动进去不拷贝
+     * 已经有唤醒没被处理时不再写 eventfd，一批投递只唤醒一次
      */
-    void queueInLoop(Functor cb);
+    void queueInLoop(Task cb);
 
     // 用来唤醒loop所在的线程
     void wakeup();
 
+    /**
+     * 自适应忙轮询，spinUs 为 0 时关闭(默认)，可以在任意线程设置
+     * 有 IO 事件或者执行了 pendingFunctors_ 之后的 spinUs 微秒内用 0 超时的 poll 空转，
+     * 期间其他线程 queueInLoop 不写 eventfd，loop 下一轮直接从队列取到任务
+     * 空闲超过 spinUs 后回到阻塞的 poll，用独占 CPU 的空转换取更低的延迟
+     */
+    void setBusyPoll(int spinUs) { busyPollUs_.store(spinUs, std::memory_order_relaxed); }
+    int busyPoll() const { return busyPollUs_.load(std::memory_order_relaxed); }
+
     // EventLoop的方法 => Poller
     void updateChannel(Channel *channel);
     void removeChannel(Channel *channel);
     bool hasChannel(Channel *channel);
+    bool supportsEdgeTriggered() const;
+
+    /**
+     * 负载统计，供 EventLoopThreadPool 选择 subLoop
+     * 连接数在 TcpServer 选定 loop 时就加一(baseLoop 线程)，连接销毁时在本 loop 线程减一
+     * 待发送字节数只由本 loop 线程里的 TcpConnection 修改，其他线程可以读取
+     */
+    int connectionCount() const { return connections_.load(std::memory_order_relaxed); }
+    int64_t pendingBytes() const { return pendingBytes_.load(std::memory_order_relaxed); }
+    void addConnections(int delta)
+    {
+        connections_.fetch_add(delta, std::memory_order_relaxed);
+    }
+    void addPendingBytes(int64_t delta)
+    {
+        pendingBytes_.store(pendingBytes_.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
 
     // 判断EventLoop是否在自己的线程
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 
     /**
      * 定时任务相关函数
+     * 返回的 TimerId 可以用来取消定时器或者重新设置到期时间，线程安全
      */
-    void runAt(Timestamp timestamp, Functor&& cb) {
-        timerQueue_->addTimer(std::move(cb), timestamp, 0.0);
+    TimerId runAt(Timestamp timestamp, Functor&& cb) {
+        return timerQueue_->addTimer(std::move(cb), timestamp, 0.0);
     }
 
-    void runAfter(double waitTime, Functor&& cb) {
+    TimerId runAfter(double waitTime, Functor&& cb) {
         Timestamp time(addTime(Timestamp::now(), waitTime)); 
-        runAt(time, std::move(cb));
+        return runAt(time, std::move(cb));
     }
 
-    void runEvery(double interval, Functor&& cb) {
+    TimerId runEvery(double interval, Functor&& cb) {
         Timestamp timestamp(addTime(Timestamp::now(), interval)); 
-        timerQueue_->addTimer(std::move(cb), timestamp, interval);
+        return timerQueue_->addTimer(std::move(cb), timestamp, interval);
     }
+
+    void cancel(TimerId timerId) {
+        timerQueue_->cancel(timerId);
+    }
+
+    // 定时器改为 delay 秒后到期，定时器已经结束时什么也不做
+    void restartTimer(TimerId timerId, double delay) {
+        timerQueue_->restart(timerId, addTime(Timestamp::now(), delay));
+    }
+
+    // 本 loop 上连接的超时检查，第一次使用时创建，只在 loop 线程调用
+    TimeoutWheel* timeoutWheel();
+
+    // 本 loop 上 TcpConnection 的对象池和它们的 shared_ptr 控制块的池，TcpServer 用 makePooled 从这里分配连接
+    const std::shared_ptr<FixedBlockPool>& connectionPool() const { return connectionPool_; }
+    const std::shared_ptr<FixedBlockPool>& controlBlockPool() const { return controlBlockPool_; }
 private:
     void handleRead();
-    void doPendingFunctors();
+    // 返回执行的任务数
+    size_t doPendingFunctors();
+    // 本轮 poll 的超时时间，忙轮询期间为 0
+    int pollTimeout();
 
     using ChannelList = std::vector<Channel*>;
     std::atomic_bool looping_;  // 原子操作，通过CAS实现
@@ -78,6 +130,7 @@ private:
     Timestamp pollReturnTime_;  // poller返回发生事件的channels的返回时间
     std::unique_ptr<Poller> poller_;
     std::unique_ptr<TimerQueue> timerQueue_;
+    std::unique_ptr<TimeoutWheel> timeoutWheel_;    // 在 timerQueue_ 之前析构
     
     /**
      * TODO:eventfd用于线程通知机制，libevent和我的webserver是使用sockepair
@@ -89,8 +142,17 @@ private:
 
     ChannelList activeChannels_;            // 活跃的Channel
     Channel* currentActiveChannel_;         // 当前处理的活跃channel
-    std::mutex mutex_;                      // 用于保护pendingFunctors_线程安全操作
-    std::vector<Functor> pendingFunctors_;  // 存储loop跨线程需要执行的所有回调操作
+    std::atomic_bool wakeupPending_;        // 已经写了 eventfd，loop 还没开始执行 pendingFunctors_
+    TaskQueue pendingFunctors_;             // 存储loop跨线程需要执行的所有回调操作
+
+    std::atomic<int> busyPollUs_;           // 忙轮询的时间预算(微秒)
+    bool spinning_;                         // 正在忙轮询，只在 loop 线程访问
+    Timestamp spinUntil_;                   // 最近一次有活动之后忙轮询到这个时间
+
+    std::atomic<int> connections_;          // 本 loop 上的连接数
+    std::atomic<int64_t> pendingBytes_;     // 本 loop 上所有连接还没发出去的字节数
+    std::shared_ptr<FixedBlockPool> connectionPool_;
+    std::shared_ptr<FixedBlockPool> controlBlockPool_;
 };
 
 
@@ -4,6 +4,7 @@
 #include <functional>
 #include <mutex>
 #include <condition_variable>
+#include <vector>
 #include "noncopyable.h"
 #include "Thread.h"
 
@@ -20,6 +21,9 @@ public:
 
     EventLoop *startLoop(); // 开启线程池
 
+    // loop 线程绑定的 CPU，需要在 startLoop 之前设置，EventLoop 在绑定之后创建
+    void setCpuAffinity(const std::vector<int> &cpus) { thread_.setCpuAffinity(cpus); }
+
 private:
     void threadFunc();
 
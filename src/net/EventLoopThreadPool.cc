@@ -2,6 +2,23 @@
 
 #include "EventLoopThread.h"
 #include "EventLoopThreadPool.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "FixedBlockPool.h"
+#include "ThreadPlacement.h"
+
+namespace
+{
+
+// 一个连接大致按 64KB 待发送数据计算，把连接数和待发送字节数合成一个负载值
+const int64_t kBytesPerConnection = 64 * 1024;
+
+int64_t loadOf(const EventLoop *loop)
+{
+    return loop->connectionCount() + loop->pendingBytes() / kBytesPerConnection;
+}
+
+} // namespace
 
 EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg)
     : baseLoop_(baseLoop)
@@ -9,6 +26,9 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string
     , started_(false)
     , numThreads_(0)
     , next_(0)
+    , policy_(kRoundRobin)
+    , random_(std::random_device()())
+    , placement_(kNoPlacement)
 {
 }
 
@@ -21,6 +41,18 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
 {
     started_ = true;
 
+    // 按放置策略排好的 CPU，依次分给 subLoop
+    std::vector<int> cpus;
+    if (placement_ != kNoPlacement)
+    {
+        cpus = cpus_.empty() ? ThreadPlacement::allowedCpus() : cpus_;
+        if (placement_ == kSpreadNumaNodes)
+        {
+            cpus = ThreadPlacement::spreadAcrossNodes(cpus);
+        }
+    }
+    const bool numa = !cpus.empty() && ThreadPlacement::numaNodeCount() > 1;
+
     // 循环创建线程
     for(int i = 0; i < numThreads_; ++i)
     {
@@ -28,11 +60,25 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
         snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
         // 创建EventLoopThread对象
         EventLoopThread *t = new EventLoopThread(cb, buf);
+        int cpu = -1;
+        if (!cpus.empty())
+        {
+            cpu = cpus[i % cpus.size()];
+            t->setCpuAffinity(std::vector<int>(1, cpu));
+            ioCpus_.push_back(cpu);
+        }
         // 加入此EventLoopThread入容器
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         // 底层创建线程 绑定一个新的EventLoop 并返回该loop的地址
         // 此时已经开始执行新线程了
-        loops_.push_back(t->startLoop());                           
+        loops_.push_back(t->startLoop());
+        // 连接对象由 baseLoop 线程构造，首次访问不在 subLoop 的节点上，需要显式指定
+        if (numa)
+        {
+            int node = ThreadPlacement::numaNodeOfCpu(cpu);
+            loops_.back()->connectionPool()->setNumaNode(node);
+            loops_.back()->controlBlockPool()->setNumaNode(node);
+        }
     }
 
     // 整个服务端只有一个线程运行baseLoop
@@ -66,6 +112,80 @@ EventLoop *EventLoopThreadPool::getNextLoop()
     return loop;
 }
 
+EventLoop *EventLoopThreadPool::getLoopForPeer(const InetAddress &peerAddr)
+{
+    if (loops_.empty())
+    {
+        return baseLoop_;
+    }
+    if (selector_)
+    {
+        return selector_(loops_, peerAddr);
+    }
+
+    switch (policy_)
+    {
+        case kLeastConnections:
+        {
+            // 每次从下一个 loop 开始找，负载相同时轮流选择，不会总是 loops_[0]
+            const size_t start = nextStart();
+            EventLoop *best = loops_[start];
+            for (size_t i = 1; i < loops_.size(); ++i)
+            {
+                EventLoop *loop = loops_[(start + i) % loops_.size()];
+                if (loop->connectionCount() < best->connectionCount())
+                {
+                    best = loop;
+                }
+            }
+            return best;
+        }
+        case kLeastPendingBytes:
+        {
+            // 待发送字节数相同(通常都是 0)时取连接数少的
+            const size_t start = nextStart();
+            EventLoop *best = loops_[start];
+            for (size_t i = 1; i < loops_.size(); ++i)
+            {
+                EventLoop *loop = loops_[(start + i) % loops_.size()];
+                if (loop->pendingBytes() < best->pendingBytes()
+                    || (loop->pendingBytes() == best->pendingBytes()
+                        && loop->connectionCount() < best->connectionCount()))
+                {
+                    best = loop;
+                }
+            }
+            return best;
+        }
+        case kPeerHash:
+        {
+            // 只用 IP 不用端口，同一个客户端的多个连接落在同一个 loop
+            // 乘法哈希的低位只取决于 IP 的低位，s_addr 是网络字节序，低位是第一段
+            // 取模会让整个 /8 落在同一个 loop，所以用高位映射到 [0, n)
+            uint32_t ip = peerAddr.getSockAddr()->sin_addr.s_addr;
+            uint32_t hash = ip * 2654435761u;
+            return loops_[(static_cast<uint64_t>(hash) * loops_.size()) >> 32];
+        }
+        case kPowerOfTwoChoices:
+        {
+            std::uniform_int_distribution<size_t> pick(0, loops_.size() - 1);
+            EventLoop *a = loops_[pick(random_)];
+            EventLoop *b = loops_[pick(random_)];
+            return loadOf(b) < loadOf(a) ? b : a;
+        }
+        case kRoundRobin:
+        default:
+            return getNextLoop();
+    }
+}
+
+size_t EventLoopThreadPool::nextStart()
+{
+    size_t start = next_;
+    next_ = (next_ + 1) % loops_.size();
+    return start;
+}
+
 std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
 {
     if(loops_.empty())
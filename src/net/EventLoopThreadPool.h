@@ -5,15 +5,37 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include <random>
 
 class EventLoop;
 class EventLoopThread;
+class InetAddress;
 
 class EventLoopThreadPool
 {
 public:
     // 用户传入的函数
     using ThreadInitCallback = std::function<void(EventLoop*)>;
+    // 自定义的 subLoop 选择函数，loops 不为空
+    using LoopSelector = std::function<EventLoop*(const std::vector<EventLoop*> &loops, const InetAddress &peerAddr)>;
+
+    // 新连接分配给哪个 subLoop
+    enum BalancePolicy
+    {
+        kRoundRobin,            // 轮询
+        kLeastConnections,      // 连接数最少
+        kLeastPendingBytes,     // 待发送字节数最少，大文件下载占着的 loop 不再分到新连接
+        kPeerHash,              // 按对端 IP 哈希，同一个客户端总在同一个 loop 上
+        kPowerOfTwoChoices,     // 随机选两个，取负载(连接数和待发送字节数)较小的
+    };
+
+    // subLoop 线程放在哪些 CPU 上
+    enum PlacementPolicy
+    {
+        kNoPlacement,           // 不绑定，由调度器决定
+        kPinToCpus,             // 第 i 个 subLoop 绑定到 cpus[i % cpus.size()]
+        kSpreadNumaNodes,       // 在 cpus 中按 NUMA 节点交错选择，各节点上的 subLoop 数量均衡
+    };
     EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg);
     ~EventLoopThreadPool();
 
@@ -26,16 +48,46 @@ public:
     // 如果工作在多线程中，baseLoop_(mainLoop)会默认以轮询的方式分配Channel给subLoop
     EventLoop *getNextLoop();
 
+    /**
+     * 按 setBalancePolicy/setLoopSelector 设置的策略为新连接选择 subLoop，只在 baseLoop 线程调用
+     * 这里只做选择，调用者(TcpServer)在选定后立即把连接计入 loop 的连接数
+     */
+    EventLoop *getLoopForPeer(const InetAddress &peerAddr);
+    void setBalancePolicy(BalancePolicy policy) { policy_ = policy; }
+    void setLoopSelector(LoopSelector selector) { selector_ = std::move(selector); }
+
     std::vector<EventLoop *> getAllLoops();
 
+    /**
+     * 设置 subLoop 的放置策略，需要在 start 之前设置，cpus 为空时使用进程允许的所有 CPU
+     * 每个 subLoop 绑定到一个 CPU，多个 NUMA 节点时 loop 的连接对象池从所在节点分配内存
+     * 没有 subLoop 时 baseLoop 在用户线程运行，不做绑定
+     */
+    void setPlacement(PlacementPolicy policy, const std::vector<int> &cpus = std::vector<int>())
+    {
+        placement_ = policy;
+        cpus_ = cpus;
+    }
+    // start 之后 subLoop 绑定的 CPU，可以用 ThreadPlacement::excludeCpus 把其他线程放到剩下的 CPU 上
+    const std::vector<int>& ioCpus() const { return ioCpus_; }
+
     bool started() const { return started_; }
     const std::string name() const { return name_; }
 private:
+    // 按负载选择时扫描的起始下标，和轮询共用 next_
+    size_t nextStart();
+
     EventLoop *baseLoop_; // 用户使用muduo创建的loop 如果线程数为1 那直接使用用户创建的loop 否则创建多EventLoop
     std::string name_;
     bool started_;      // 开启线程池标志
     int numThreads_;    // 创建线程数量
     size_t next_;          // 轮询的下标
+    BalancePolicy policy_;
+    LoopSelector selector_; // 设置了就优先使用
+    std::minstd_rand random_;
+    PlacementPolicy placement_;
+    std::vector<int> cpus_;
+    std::vector<int> ioCpus_;
     std::vector<std::unique_ptr<EventLoopThread>> threads_; // 保存所有的EventLoopThread容器
     std::vector<EventLoop *> loops_;    // 保存创建的所有EventLoop
 };
@@ -0,0 +1,134 @@
+#include "FixedBlockPool.h"
+#include "Logging.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+FixedBlockPool::FixedBlockPool()
+    : blockSize_(0),
+      freeList_(nullptr),
+      freeBlocks_(0),
+      numaNode_(-1)
+{
+}
+
+FixedBlockPool::~FixedBlockPool()
+{
+    for (const Chunk &chunk : chunks_)
+    {
+        if (chunk.mappedBytes > 0)
+        {
+            ::munmap(chunk.data, chunk.mappedBytes);
+        }
+        else
+        {
+            ::operator delete(chunk.data);
+        }
+    }
+}
+
+void FixedBlockPool::setNumaNode(int node)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    numaNode_ = node;
+}
+
+// mbind 需要按页对齐的地址，指定了节点时直接 mmap，在第一次访问之前设置内存策略
+FixedBlockPool::Chunk FixedBlockPool::newChunk(size_t bytes) const
+{
+    Chunk chunk = { nullptr, 0 };
+    if (numaNode_ >= 0 && numaNode_ < static_cast<int>(sizeof(unsigned long) * 8))
+    {
+        const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        const size_t length = (bytes + page - 1) / page * page;
+        void *data = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data != MAP_FAILED)
+        {
+            unsigned long mask = 1UL << numaNode_;
+            if (::syscall(SYS_mbind, data, length, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0) < 0)
+            {
+                LOG_ERROR << "mbind error:" << errno;
+            }
+            chunk.data = static_cast<char*>(data);
+            chunk.mappedBytes = length;
+            return chunk;
+        }
+    }
+    chunk.data = static_cast<char*>(::operator new(bytes));
+    return chunk;
+}
+
+// 块按 16 字节对齐，放得下空闲链表的指针
+size_t FixedBlockPool::roundUp(size_t size)
+{
+    size = size < sizeof(FreeNode) ? sizeof(FreeNode) : size;
+    return (size + 15) & ~static_cast<size_t>(15);
+}
+
+void* FixedBlockPool::allocate(size_t size)
+{
+    size = roundUp(size);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (blockSize_ == 0)
+    {
+        blockSize_ = size;
+    }
+    if (size != blockSize_)
+    {
+        return ::operator new(size);
+    }
+    if (freeList_ == nullptr)
+    {
+        // 新申请一批块串进空闲链表
+        Chunk newBlocks = newChunk(blockSize_ * kBlocksPerChunk);
+        chunks_.push_back(newBlocks);
+        char *chunk = newBlocks.data;
+        for (size_t i = 0; i < kBlocksPerChunk; ++i)
+        {
+            FreeNode *node = reinterpret_cast<FreeNode*>(chunk + i * blockSize_);
+            node->next = freeList_;
+            freeList_ = node;
+        }
+        freeBlocks_ += kBlocksPerChunk;
+    }
+    FreeNode *node = freeList_;
+    freeList_ = node->next;
+    --freeBlocks_;
+    return node;
+}
+
+void FixedBlockPool::deallocate(void *block, size_t size)
+{
+    size = roundUp(size);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size != blockSize_)
+    {
+        ::operator delete(block);
+        return;
+    }
+    FreeNode *node = static_cast<FreeNode*>(block);
+    node->next = freeList_;
+    freeList_ = node;
+    ++freeBlocks_;
+}
+
+size_t FixedBlockPool::blockSize() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return blockSize_;
+}
+
+size_t FixedBlockPool::freeBlocks() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return freeBlocks_;
+}
+
+size_t FixedBlockPool::chunkCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return chunks_.size();
+}
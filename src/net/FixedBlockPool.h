@@ -0,0 +1,159 @@
+#ifndef FIXED_BLOCK_POOL_H
+#define FIXED_BLOCK_POOL_H
+
+#include "noncopyable.h"
+
+#include <stddef.h>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * 固定大小内存块的对象池，一次向系统申请 kBlocksPerChunk 个块
+ * 释放的块放进空闲链表下次复用，池析构时才还给系统
+ * 块的大小由第一次分配决定，大小不同的请求直接 operator new
+ * 可以在任意线程分配和释放，每个 EventLoop 一个池，锁的竞争很少
+ * 设置了 NUMA 节点时新的块用 mmap 申请并优先放在该节点上
+ */
+class FixedBlockPool : noncopyable
+{
+public:
+    static const size_t kBlocksPerChunk = 64;
+
+    FixedBlockPool();
+    ~FixedBlockPool();
+
+    void* allocate(size_t size);
+    // size 必须和 allocate 时相同
+    void deallocate(void *block, size_t size);
+
+    // 之后申请的块优先放在 node 上，-1 表示不指定
+    void setNumaNode(int node);
+
+    size_t blockSize() const;
+    size_t freeBlocks() const;
+    size_t chunkCount() const;
+
+private:
+    struct FreeNode
+    {
+        FreeNode *next;
+    };
+
+    struct Chunk
+    {
+        char *data;
+        size_t mappedBytes;     // mmap 申请的长度，0 表示用 operator new 申请
+    };
+
+    static size_t roundUp(size_t size);
+    Chunk newChunk(size_t bytes) const;
+
+    mutable std::mutex mutex_;
+    size_t blockSize_;
+    FreeNode *freeList_;
+    size_t freeBlocks_;
+    int numaNode_;
+    std::vector<Chunk> chunks_;
+};
+
+/**
+ * 从 FixedBlockPool 分配的 allocator，makePooled 用它分配 shared_ptr 的控制块
+ * allocator 的拷贝持有池的引用，最后一个控制块释放之前池不会析构
+ * 控制块和对象不要共用一个池: 两者大小不同，而池的块大小由第一次分配决定
+ */
+template <typename T>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit PoolAllocator(const std::shared_ptr<FixedBlockPool> &pool) : pool_(pool) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &other) : pool_(other.pool()) {}
+
+    T* allocate(size_t n)
+    {
+        if (n == 1)
+        {
+            return static_cast<T*>(pool_->allocate(sizeof(T)));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        if (n == 1)
+        {
+            pool_->deallocate(p, sizeof(T));
+        }
+        else
+        {
+            ::operator delete(p);
+        }
+    }
+
+    const std::shared_ptr<FixedBlockPool>& pool() const { return pool_; }
+
+private:
+    std::shared_ptr<FixedBlockPool> pool_;
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &lhs, const PoolAllocator<U> &rhs)
+{
+    return lhs.pool() == rhs.pool();
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &lhs, const PoolAllocator<U> &rhs)
+{
+    return !(lhs == rhs);
+}
+
+/**
+ * makePooled 创建的 shared_ptr 的删除器，析构对象并把块还给池，持有池的引用
+ */
+template <typename T>
+class PoolDeleter
+{
+public:
+    explicit PoolDeleter(const std::shared_ptr<FixedBlockPool> &pool) : pool_(pool) {}
+
+    void operator()(T *p) const
+    {
+        p->~T();
+        pool_->deallocate(p, sizeof(T));
+    }
+
+private:
+    std::shared_ptr<FixedBlockPool> pool_;
+};
+
+/**
+ * 对象从 pool 分配，shared_ptr 的控制块从 controlPool 分配，都不经过 malloc
+ * 最后一个 shared_ptr 释放时对象的块就还给池，剩下的 weak_ptr 只占着 controlPool 中很小的控制块
+ */
+template <typename T, typename... Args>
+std::shared_ptr<T> makePooled(const std::shared_ptr<FixedBlockPool> &pool,
+                              const std::shared_ptr<FixedBlockPool> &controlPool,
+                              Args&&... args)
+{
+    void *block = pool->allocate(sizeof(T));
+    T *object;
+    try
+    {
+        object = new (block) T(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        pool->deallocate(block, sizeof(T));
+        throw;
+    }
+    // 控制块分配失败时 shared_ptr 会调用删除器把对象的块还回去
+    return std::shared_ptr<T>(object, PoolDeleter<T>(pool), PoolAllocator<T>(controlPool));
+}
+
+#endif // FIXED_BLOCK_POOL_H
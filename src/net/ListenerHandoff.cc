@@ -0,0 +1,241 @@
+#include "ListenerHandoff.h"
+#include "EventLoop.h"
+#include "Channel.h"
+#include "Logging.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+namespace
+{
+
+bool makeAddress(const std::string &path, sockaddr_un *addr)
+{
+    ::memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr->sun_path))
+    {
+        LOG_ERROR << "ListenerHandoff path too long: " << path;
+        return false;
+    }
+    ::memcpy(addr->sun_path, path.c_str(), path.size());
+    return true;
+}
+
+// 路径上现在的文件的 inode，用来判断 path 是不是已经被新进程重新 bind
+ino_t inodeOf(const std::string &path)
+{
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 ? st.st_ino : 0;
+}
+
+} // namespace
+
+ListenerHandoff::ListenerHandoff(EventLoop *loop, const std::string &path)
+    : loop_(loop),
+      path_(path),
+      listenFd_(-1),
+      inode_(0)
+{
+}
+
+ListenerHandoff::~ListenerHandoff()
+{
+    if (listenFd_ >= 0)
+    {
+        close();
+        // 没有交出去，path 还是自己的，删掉
+        if (inode_ != 0 && inodeOf(path_) == inode_)
+        {
+            ::unlink(path_.c_str());
+        }
+    }
+}
+
+void ListenerHandoff::listen(const FdsProvider &fds, const HandoffCallback &cb)
+{
+    fds_ = fds;
+    handoffCallback_ = cb;
+
+    sockaddr_un addr;
+    if (!makeAddress(path_, &addr))
+    {
+        return;
+    }
+    // 旧进程留下的 path，旧进程自己已经不再使用
+    ::unlink(path_.c_str());
+    listenFd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0
+        || ::bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+        || ::listen(listenFd_, 4) < 0)
+    {
+        LOG_ERROR << "ListenerHandoff listen on " << path_ << " error:" << errno;
+        if (listenFd_ >= 0)
+        {
+            ::close(listenFd_);
+            listenFd_ = -1;
+        }
+        return;
+    }
+    inode_ = inodeOf(path_);
+
+    channel_.reset(new Channel(loop_, listenFd_));
+    channel_->setReadCallback(std::bind(&ListenerHandoff::handleRead, this));
+    channel_->enableReading();
+}
+
+void ListenerHandoff::handleRead()
+{
+    // 新进程连上来了，阻塞的 socket 上发送几个 fd 不会阻塞太久
+    int connfd = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (connfd < 0)
+    {
+        return;
+    }
+    std::vector<int> fds = fds_ ? fds_() : std::vector<int>();
+    bool ok = sendFds(connfd, fds);
+    ::close(connfd);
+    if (!ok)
+    {
+        LOG_ERROR << "ListenerHandoff send " << fds.size() << " fds failed";
+        return;
+    }
+
+    LOG_INFO << "ListenerHandoff handed off " << fds.size() << " listening sockets";
+    // path 已经属于新进程，只关闭自己的 fd；channel 在处理自己的事件，析构时再释放
+    close();
+    if (handoffCallback_)
+    {
+        handoffCallback_();
+    }
+}
+
+void ListenerHandoff::close()
+{
+    if (channel_)
+    {
+        channel_->disableAll();
+        channel_->remove();
+    }
+    ::close(listenFd_);
+    listenFd_ = -1;
+}
+
+std::vector<int> ListenerHandoff::receive(const std::string &path, double timeoutSeconds)
+{
+    sockaddr_un addr;
+    if (!makeAddress(path, &addr))
+    {
+        return std::vector<int>();
+    }
+    int sockfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sockfd < 0)
+    {
+        return std::vector<int>();
+    }
+    if (::connect(sockfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        // 没有旧进程，正常启动
+        LOG_INFO << "ListenerHandoff no previous process on " << path;
+        ::close(sockfd);
+        return std::vector<int>();
+    }
+    timeval tv;
+    tv.tv_sec = static_cast<time_t>(timeoutSeconds);
+    tv.tv_usec = static_cast<suseconds_t>((timeoutSeconds - static_cast<double>(tv.tv_sec)) * 1000000);
+    ::setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    std::vector<int> fds = recvFds(sockfd);
+    ::close(sockfd);
+    LOG_INFO << "ListenerHandoff received " << fds.size() << " listening sockets from " << path;
+    return fds;
+}
+
+// 数据部分是 fd 的个数，fd 放在 SCM_RIGHTS 控制消息里
+bool ListenerHandoff::sendFds(int sockfd, const std::vector<int> &fds)
+{
+    if (fds.empty() || fds.size() > static_cast<size_t>(kMaxFds))
+    {
+        return false;
+    }
+    uint32_t count = static_cast<uint32_t>(fds.size());
+    iovec iov;
+    iov.iov_base = &count;
+    iov.iov_len = sizeof(count);
+
+    union
+    {
+        cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * kMaxFds)];
+    } control;
+    ::memset(&control, 0, sizeof(control));
+
+    msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    ::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+    return ::sendmsg(sockfd, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(count));
+}
+
+std::vector<int> ListenerHandoff::recvFds(int sockfd)
+{
+    uint32_t count = 0;
+    iovec iov;
+    iov.iov_base = &count;
+    iov.iov_len = sizeof(count);
+
+    union
+    {
+        cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * kMaxFds)];
+    } control;
+
+    msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t n = ::recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+    std::vector<int> fds;
+    if (n < 0)
+    {
+        LOG_ERROR << "ListenerHandoff recvmsg error:" << errno;
+        return fds;
+    }
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            size_t num = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const int *data = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+            fds.insert(fds.end(), data, data + num);
+        }
+    }
+    // 消息不完整时收到的 fd 也不能用，关闭避免泄漏
+    if (n != static_cast<ssize_t>(sizeof(count)) || (msg.msg_flags & MSG_CTRUNC) || fds.size() != count)
+    {
+        LOG_ERROR << "ListenerHandoff bad message, " << fds.size() << " fds";
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+        fds.clear();
+    }
+    return fds;
+}
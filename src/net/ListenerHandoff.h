@@ -0,0 +1,68 @@
+#ifndef LISTENER_HANDOFF_H
+#define LISTENER_HANDOFF_H
+
+#include <sys/types.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "noncopyable.h"
+
+class EventLoop;
+class Channel;
+
+/**
+ * 热重启时把监听 socket 交给新进程
+ * 旧进程在 UNIX socket path 上等待，新进程启动时连接 path，旧进程用 SCM_RIGHTS 发送监听 fd
+ * 两个进程持有的是同一个监听 socket，旧进程关闭自己的 fd 后，accept 队列里的连接和之后的新连接
+ * 都由新进程接受，重启期间不会有连接被拒绝
+ *
+ * 旧进程:
+ *     ListenerHandoff handoff(&loop, path);
+ *     handoff.listen(std::bind(&TcpServer::listenFds, &server), [&]() { server.drain(30, ...); });
+ * 新进程:
+ *     server.adoptListenFds(ListenerHandoff::receive(path));
+ *     server.start();
+ */
+class ListenerHandoff : noncopyable
+{
+public:
+    using FdsProvider = std::function<std::vector<int>()>;
+    using HandoffCallback = std::function<void()>;
+
+    ListenerHandoff(EventLoop *loop, const std::string &path);
+    ~ListenerHandoff();
+
+    /**
+     * 在 path 上等待新进程，在 loop 线程调用
+     * 新进程连上来时发送 fds() 返回的 fd，发送成功后停止等待并调用 cb
+     */
+    void listen(const FdsProvider &fds, const HandoffCallback &cb);
+
+    /**
+     * 新进程: 连接 path 接收旧进程的监听 fd，收到的 fd 设置了 FD_CLOEXEC
+     * 没有旧进程在等待或者接收失败时返回空
+     */
+    static std::vector<int> receive(const std::string &path, double timeoutSeconds = 5.0);
+
+    // 在 UNIX socket 上发送/接收一组 fd，一次最多 kMaxFds 个
+    static bool sendFds(int sockfd, const std::vector<int> &fds);
+    static std::vector<int> recvFds(int sockfd);
+
+    static const int kMaxFds = 64;
+
+private:
+    void handleRead();
+    void close();
+
+    EventLoop *loop_;
+    const std::string path_;
+    int listenFd_;
+    ino_t inode_;       // bind 之后 path 的 inode，析构时只删除自己创建的 path
+    std::unique_ptr<Channel> channel_;
+    FdsProvider fds_;
+    HandoffCallback handoffCallback_;
+};
+
+#endif // LISTENER_HANDOFF_H
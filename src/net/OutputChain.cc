@@ -0,0 +1,273 @@
+#include "OutputChain.h"
+#include "Logging.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+size_t OutputChain::Slice::size() const
+{
+    switch (kind)
+    {
+        case kChain: return chain->readableBytes();
+        case kBuffer: return buffer->readableBytes();
+        case kString: return str.size() - static_cast<size_t>(offset);
+        case kBlock: return block->size() - static_cast<size_t>(offset);
+        default: return count;
+    }
+}
+
+int OutputChain::Slice::fillIovec(struct iovec *vec, int maxIov) const
+{
+    if (kind == kChain)
+    {
+        return chain->fillIovec(vec, maxIov);
+    }
+    size_t len = size();
+    if (len == 0 || maxIov == 0)
+    {
+        return 0;
+    }
+    switch (kind)
+    {
+        case kBuffer: vec->iov_base = const_cast<char*>(buffer->peek()); break;
+        case kString: vec->iov_base = const_cast<char*>(str.data() + offset); break;
+        default: vec->iov_base = const_cast<char*>(block->data() + offset); break;
+    }
+    vec->iov_len = len;
+    return 1;
+}
+
+void OutputChain::Slice::advance(size_t n)
+{
+    if (kind == kChain)
+    {
+        chain->retrieve(n);
+    }
+    else if (kind == kBuffer)
+    {
+        buffer->retrieve(n);
+    }
+    else if (kind == kFile)
+    {
+        offset += n;
+        count -= n;
+    }
+    else
+    {
+        offset += n;
+    }
+}
+
+OutputChain::OutputChain()
+    : bytes_(0)
+{
+}
+
+OutputChain::~OutputChain()
+{
+    clear();
+}
+
+ChainBuffer* OutputChain::tailChain()
+{
+    if (slices_.empty() || slices_.back().kind != Slice::kChain)
+    {
+        slices_.emplace_back(Slice::kChain);
+        slices_.back().chain.reset(new ChainBuffer);
+    }
+    return slices_.back().chain.get();
+}
+
+void OutputChain::append(const char *data, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    tailChain()->append(data, len);
+    bytes_ += len;
+}
+
+void OutputChain::append(Buffer *buf)
+{
+    size_t len = buf->readableBytes();
+    if (len < kCopyThreshold || (!slices_.empty() && slices_.back().kind == Slice::kChain && len < kCopyThreshold * 4))
+    {
+        append(buf->peek(), len);
+        buf->retrieveAll();
+        return;
+    }
+    slices_.emplace_back(Slice::kBuffer);
+    slices_.back().buffer.reset(new Buffer(0));
+    slices_.back().buffer->swap(*buf);
+    bytes_ += len;
+}
+
+void OutputChain::append(std::string &&str)
+{
+    if (str.size() < kCopyThreshold)
+    {
+        append(str.data(), str.size());
+        return;
+    }
+    bytes_ += str.size();
+    slices_.emplace_back(Slice::kString);
+    slices_.back().str = std::move(str);
+}
+
+void OutputChain::append(const std::shared_ptr<const std::string> &block)
+{
+    if (block->size() < kCopyThreshold)
+    {
+        append(block->data(), block->size());
+        return;
+    }
+    bytes_ += block->size();
+    slices_.emplace_back(Slice::kBlock);
+    slices_.back().block = block;
+}
+
+void OutputChain::appendFile(int fd, off64_t offset, size_t count, const std::shared_ptr<void> &holder)
+{
+    slices_.emplace_back(Slice::kFile);
+    Slice &slice = slices_.back();
+    slice.fd = fd;
+    slice.offset = offset;
+    slice.count = count;
+    slice.holder = holder;
+    bytes_ += count;
+    if (count == 0)
+    {
+        // 空的文件段不会被发送，直接关闭
+        slice.closeFile();
+        slices_.pop_back();
+    }
+}
+
+void OutputChain::append(OutputChain *other)
+{
+    for (Slice &slice : other->slices_)
+    {
+        slices_.push_back(std::move(slice));
+    }
+    bytes_ += other->bytes_;
+    // 段已经移走，不能调用 other->clear()，否则会关闭转移过来的文件
+    other->slices_.clear();
+    other->bytes_ = 0;
+}
+
+void OutputChain::pop()
+{
+    Slice &slice = slices_.front();
+    // 内存段的内存随 Slice 析构还给线程的缓存
+    slice.closeFile();
+    slices_.pop_front();
+}
+
+ssize_t OutputChain::writeFd(int fd, int *savedErrno, bool untilBlocked)
+{
+    ssize_t total = 0;
+    bool full = false;
+    *savedErrno = 0;
+    while (!slices_.empty() && *savedErrno == 0 && (untilBlocked || !full))
+    {
+        ssize_t n = slices_.front().kind == Slice::kFile ? writeFile(fd, savedErrno, &full)
+                                                          : writeMemory(fd, savedErrno, &full);
+        if (n > 0)
+        {
+            total += n;
+        }
+    }
+    return total;
+}
+
+ssize_t OutputChain::writeMemory(int fd, int *savedErrno, bool *full)
+{
+    // 收集开头连续的内存段
+    struct iovec vec[IOV_MAX];
+    int iovcnt = 0;
+    size_t expected = 0;
+    for (auto it = slices_.begin(); it != slices_.end() && it->kind != Slice::kFile && iovcnt < IOV_MAX; ++it)
+    {
+        int added = it->fillIovec(vec + iovcnt, IOV_MAX - iovcnt);
+        for (int i = iovcnt; i < iovcnt + added; ++i)
+        {
+            expected += vec[i].iov_len;
+        }
+        iovcnt += added;
+    }
+
+    ssize_t n = 0;
+    if (iovcnt > 0)
+    {
+        n = iovcnt == 1 ? ::write(fd, vec[0].iov_base, vec[0].iov_len) : ::writev(fd, vec, iovcnt);
+        if (n < 0)
+        {
+            *savedErrno = errno;
+            return n;
+        }
+    }
+    *full = static_cast<size_t>(n) < expected;
+    bytes_ -= n;
+
+    // 取走已经写出的部分
+    size_t left = static_cast<size_t>(n);
+    while (!slices_.empty() && slices_.front().kind != Slice::kFile)
+    {
+        size_t len = slices_.front().size();
+        if (left < len)
+        {
+            slices_.front().advance(left);
+            break;
+        }
+        left -= len;
+        pop();
+    }
+    return n;
+}
+
+ssize_t OutputChain::writeFile(int fd, int *savedErrno, bool *full)
+{
+    Slice &slice = slices_.front();
+    ssize_t n = ::sendfile(fd, slice.fd, &slice.offset, slice.count);
+    if (n < 0)
+    {
+        *savedErrno = errno;
+        return n;
+    }
+    if (n == 0)
+    {
+        // 文件被截断，声明的长度已经发不完，后面的段接着发会让对端错位，当作写出错处理
+        LOG_ERROR << "OutputChain::writeFile() sendfile reached EOF, " << slice.count << " bytes left";
+        *savedErrno = EIO;
+        return 0;
+    }
+    // sendfile 已经更新了 offset
+    slice.count -= n;
+    bytes_ -= n;
+    if (slice.count == 0)
+    {
+        pop();
+    }
+    else
+    {
+        *full = true;
+    }
+    return n;
+}
+
+void OutputChain::clear()
+{
+    for (const Slice &slice : slices_)
+    {
+        slice.closeFile();
+    }
+    slices_.clear();
+    bytes_ = 0;
+}
@@ -0,0 +1,96 @@
+#ifndef OUTPUT_CHAIN_H
+#define OUTPUT_CHAIN_H
+
+#include "noncopyable.h"
+#include "Buffer.h"
+#include "ChainBuffer.h"
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <deque>
+#include <memory>
+#include <string>
+
+/**
+ * TcpConnection 的发送队列，由多段数据组成，按加入的顺序发送
+ * 每一段是下面的一种:
+ *   chain   拷贝进来的数据，存放在 ChainBuffer 的固定大小的块中，追加时不搬移已有数据
+ *   Buffer  TcpConnection::send(Buffer*) 交换进来的缓冲区
+ *   string  移动进来的字符串
+ *   block   多个连接共享的不可变数据，只持有引用
+ *   file    文件区间 [offset, offset+count)，用 sendfile 发送
+ * 除了 chain 之外加入时都不拷贝数据
+ * 相邻的内存段(包括 chain 的每一块)合并成一次 writev(最多 IOV_MAX 段)
+ * 小块数据拷贝到队尾的 chain 段中，避免产生大量很小的段
+ */
+class OutputChain : noncopyable
+{
+public:
+    // 小于这个长度的字符串和 Buffer 直接拷贝到队尾的 chain 段
+    static const size_t kCopyThreshold = 256;
+
+    OutputChain();
+    ~OutputChain();
+
+    bool empty() const { return slices_.empty(); }
+    // 还没发送的字节数
+    size_t bytes() const { return bytes_; }
+
+    void append(const char *data, size_t len);
+    // 交换 buf 的内容，buf 变为空
+    void append(Buffer *buf);
+    void append(std::string &&str);
+    void append(const std::shared_ptr<const std::string> &block);
+    // holder 为空时 fd 归发送队列所有，发送完或者 clear 时关闭
+    void appendFile(int fd, off64_t offset, size_t count, const std::shared_ptr<void> &holder);
+    // 把 other 的所有段按顺序移到队尾，文件的所有权一起转移，other 变为空
+    void append(OutputChain *other);
+
+    /**
+     * 按顺序写入 fd，返回写出的字节数
+     * 内核缓冲区满(一次写没有写完)时停止，untilBlocked 为 true 时一直写到 EAGAIN，用于边缘触发
+     * 系统调用出错时停止并设置 *savedErrno，包括 EAGAIN
+     * 文件被截断导致 sendfile 读不到数据时设置 *savedErrno 为 EIO，这一段留在队列中
+     */
+    ssize_t writeFd(int fd, int *savedErrno, bool untilBlocked);
+
+    // 丢弃所有数据，关闭属于自己的文件
+    void clear();
+
+private:
+    struct Slice
+    {
+        enum Kind { kChain, kBuffer, kString, kBlock, kFile };
+
+        explicit Slice(Kind k)
+            : kind(k), fd(-1), offset(0), count(0) {}
+
+        size_t size() const;
+        // 内存段填入 vec，返回段数
+        int fillIovec(struct iovec *vec, int maxIov) const;
+        void advance(size_t n);
+        // 没有 holder 的文件归发送队列所有
+        void closeFile() const { if (kind == kFile && !holder) ::close(fd); }
+
+        Kind kind;
+        std::unique_ptr<ChainBuffer> chain;             // kChain
+        std::unique_ptr<Buffer> buffer;                 // kBuffer
+        std::string str;                                // kString
+        std::shared_ptr<const std::string> block;       // kBlock
+        std::shared_ptr<void> holder;                   // kFile 的 fd 所有者
+        int fd;
+        off64_t offset;     // kString、kBlock 已发送的字节数，kFile 的文件偏移
+        size_t count;       // kFile 剩余的字节数
+    };
+
+    // 队尾可以直接追加数据的 chain 段
+    ChainBuffer* tailChain();
+    void pop();
+    ssize_t writeMemory(int fd, int *savedErrno, bool *full);
+    ssize_t writeFile(int fd, int *savedErrno, bool *full);
+
+    std::deque<Slice> slices_;
+    size_t bytes_;
+};
+
+#endif // OUTPUT_CHAIN_H
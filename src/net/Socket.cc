@@ -4,6 +4,7 @@
 #include <string.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <linux/filter.h>
 
 #include "Socket.h"
 #include "Logging.h"
@@ -48,10 +49,7 @@ int Socket::accept(InetAddress *peeraddr)
     {
         peeraddr->setSockAddr(addr);                    
     }
-    else
-    {
-        LOG_ERROR << "accept4() failed";
-    }
+    // 失败时 errno 由调用者(Acceptor)判断是否需要记录，这里不打日志
     return connfd;
 }
 
@@ -92,4 +90,47 @@ void Socket::setKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval)); // TCP_NODELAY包含头文件 <netinet/tcp.h>
-}
\ No newline at end of file
+}
+
+void Socket::setBusyPoll(int us)
+{
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us)) < 0)
+    {
+        LOG_ERROR << "setsockopt SO_BUSY_POLL error:" << errno;
+    }
+}
+
+void Socket::setIncomingCpu(int cpu)
+{
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) < 0)
+    {
+        LOG_ERROR << "setsockopt SO_INCOMING_CPU error:" << errno;
+    }
+}
+
+bool Socket::attachReusePortCpuBpf(const std::vector<int> &cpus)
+{
+    const uint32_t groupSize = static_cast<uint32_t>(cpus.size());
+    std::vector<struct sock_filter> code;
+    // A = 当前 CPU
+    code.push_back({ BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU) });
+    for (uint32_t i = 0; i < groupSize; ++i)
+    {
+        // A == cpus[i] 时返回 i，否则跳过下一条
+        code.push_back({ BPF_JMP | BPF_JEQ | BPF_K, 0, 1, static_cast<uint32_t>(cpus[i]) });
+        code.push_back({ BPF_RET | BPF_K, 0, 0, i });
+    }
+    // 其他 CPU: A = A % groupSize
+    code.push_back({ BPF_ALU | BPF_MOD | BPF_K, 0, 0, groupSize });
+    // 返回 A 作为 socket 下标
+    code.push_back({ BPF_RET | BPF_A, 0, 0, 0 });
+    struct sock_fprog prog;
+    prog.len = static_cast<unsigned short>(code.size());
+    prog.filter = code.data();
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0)
+    {
+        LOG_ERROR << "setsockopt SO_ATTACH_REUSEPORT_CBPF error:" << errno;
+        return false;
+    }
+    return true;
+}
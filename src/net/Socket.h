@@ -2,6 +2,8 @@
 
 #include "noncopyable.h"
 
+#include <vector>
+
 class InetAddress;
 
 // 封装socket fd
@@ -30,6 +32,20 @@ public:
     void setReuseAddr(bool on);     // 设置地址复用
     void setReusePort(bool on);     // 设置端口复用
     void setKeepAlive(bool on);     // 设置长连接
+    /**
+     * SO_BUSY_POLL: 这个 socket 上的读和 epoll 等待时先在网卡队列上轮询 us 微秒
+     * 超过 net.core.busy_read 需要 CAP_NET_ADMIN
+     */
+    void setBusyPoll(int us);
+
+    // SO_REUSEPORT 组内优先把在 cpu 上收到的连接交给这个监听 socket
+    void setIncomingCpu(int cpu);
+    /**
+     * 给 SO_REUSEPORT 组挂一个 cBPF 程序: 处理 SYN 的 CPU 等于 cpus[i] 时选中第 i 个监听 socket
+     * 不在 cpus 中的 CPU 选第 CPU % cpus.size() 个
+     * 下标是组内 socket 开始 listen 的顺序，组内任意一个 socket 挂上即对整个组生效
+     */
+    bool attachReusePortCpuBpf(const std::vector<int> &cpus);
 
 private:
     const int sockfd_;
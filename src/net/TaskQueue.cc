@@ -0,0 +1,53 @@
+#include "TaskQueue.h"
+
+TaskQueue::TaskQueue()
+    : head_(new Node),
+      tail_(head_.load(std::memory_order_relaxed))
+{
+}
+
+TaskQueue::~TaskQueue()
+{
+    Task task;
+    while (pop(&task))
+    {
+    }
+    delete tail_;
+}
+
+void TaskQueue::push(Task task)
+{
+    Node *node = new Node(std::move(task));
+    Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+}
+
+bool TaskQueue::pop(Task *task)
+{
+    Node *tail = tail_;
+    Node *next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr)
+    {
+        return false;
+    }
+    // next 成为新的哑节点
+    *task = std::move(next->task);
+    tail_ = next;
+    delete tail;
+    return true;
+}
+
+size_t TaskQueue::runAll()
+{
+    // 只执行到开始时的最后一个节点，任务里再 queueInLoop 的不会在这一轮执行，避免饿死 IO 事件
+    Node *last = head_.load(std::memory_order_acquire);
+    size_t count = 0;
+    Task task;
+    while (tail_ != last && pop(&task))
+    {
+        task();
+        task.reset();
+        ++count;
+    }
+    return count;
+}
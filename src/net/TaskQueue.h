@@ -0,0 +1,51 @@
+#ifndef TASK_QUEUE_H
+#define TASK_QUEUE_H
+
+#include <atomic>
+
+#include "noncopyable.h"
+#include "Task.h"
+
+/**
+ * 无锁的多生产者单消费者任务队列(Vyukov 的 intrusive MPSC 队列)
+ * 任意线程 push，只有 EventLoop 所在线程 pop
+ *
+ * push 只有一次原子交换，不会因为锁等待其他生产者或者消费者
+ * 生产者交换完 head_ 还没来得及链接 next 时，消费者会暂时看到队列在这里结束，
+ * 这个任务由生产者随后的唤醒保证被执行
+ */
+class TaskQueue : noncopyable
+{
+public:
+    TaskQueue();
+    ~TaskQueue();
+
+    void push(Task task);
+
+    // 取出最早的任务，队列为空(或者队头的生产者还没链接完成)时返回 false
+    bool pop(Task *task);
+
+    /**
+     * 执行当前已经在队列里的任务，执行过程中新加入的任务留到下一次
+     * 返回执行的任务数
+     */
+    size_t runAll();
+
+    // 只在消费者线程调用，生产者交换完 head_ 还没链接 next 的任务也算在内
+    bool empty() const { return head_.load(std::memory_order_acquire) == tail_; }
+
+private:
+    struct Node
+    {
+        Node() : next(nullptr) {}
+        explicit Node(Task &&t) : next(nullptr), task(std::move(t)) {}
+
+        std::atomic<Node*> next;
+        Task task;
+    };
+
+    std::atomic<Node*> head_;   // 最后加入的节点，生产者修改
+    Node *tail_;                // 哑节点，它的 next 是最早的任务，只有消费者访问
+};
+
+#endif // TASK_QUEUE_H
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <functional>
 #include <string>
 #include <errno.h>
@@ -6,13 +7,16 @@
 #include <string.h>
 #include <netinet/tcp.h>
 #include <iostream>
-#include <sys/sendfile.h>
 
 #include "TcpConnection.h"
 #include "Logging.h"
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "TimeoutWheel.h"
+
+// 边缘触发时一次可读事件最多读这么多字节
+static const size_t kMaxReadPerEvent = 16 * BufferAllocator::kReadBufferSize;
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
@@ -26,38 +30,47 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop)
 }
 
 TcpConnection::TcpConnection(EventLoop *loop,
-                             const std::string &nameArg,
+                             std::string nameArg,
                              int sockfd,
                              const InetAddress &localAddr,
                              const InetAddress &peerAddr)
     : loop_(CheckLoopNotNull(loop))
-    , name_(nameArg)
+    , name_(std::move(nameArg))
     , state_(kConnecting)
     , reading_(true)
-    , socket_(new Socket(sockfd))
-    , channel_(new Channel(loop, sockfd))
+    , socket_(sockfd)
+    , channel_(loop, sockfd)
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
+    , lastReceiveTime_(Timestamp::now())
+    , lastActiveTime_(lastReceiveTime_)
+    , idleTimeout_(0.0)
     , highWaterMark_(64 * 1024 * 1024) // 64M 避免发送太快对方接受太慢
+    , pauseReadMark_(0)
+    , resumeReadMark_(0)
+    , readPaused_(false)
+    , draining_(false)
+    , pendingBytes_(0)
 {
     // 下面给channel设置相应的回调函数 poller给channel通知感兴趣的事件发生了 channel会回调相应的回调函数
-    channel_->setReadCallback(
+    channel_.setReadCallback(
         std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
-    channel_->setWriteCallback(
+    channel_.setWriteCallback(
         std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(
+    channel_.setCloseCallback(
         std::bind(&TcpConnection::handleClose, this));
-    channel_->setErrorCallback(
+    channel_.setErrorCallback(
         std::bind(&TcpConnection::handleError, this));
 
     LOG_INFO << "TcpConnection::ctor[" << name_.c_str() << "] at fd =" << sockfd;
-    socket_->setKeepAlive(true);
-     //socket_->setTcpNoDelay(true);
+    socket_.setKeepAlive(true);
+     //socket_.setTcpNoDelay(true);
 }
 
 TcpConnection::~TcpConnection()
 {
-    LOG_INFO << "TcpConnection::dtor[" << name_.c_str() << "] at fd=" << channel_->fd() << " state=" << static_cast<int>(state_);
+    // 还没有发送完的文件由 outputChain_ 析构时关闭
+    LOG_INFO << "TcpConnection::dtor[" << name_.c_str() << "] at fd=" << channel_.fd() << " state=" << static_cast<int>(state_);
 }
 
 
@@ -72,13 +85,23 @@ void TcpConnection::send(const std::string &buf)
         }
         else
         {
-            // 遇到重载函数的绑定，可以使用函数指针来指定确切的函数
-            void(TcpConnection::*fp)(const void* data, size_t len) = &TcpConnection::sendInLoop;
-            loop_->runInLoop(std::bind(
-                fp,
-                this,
-                buf.c_str(),
-                buf.size()));
+            // 跨线程时 buf 可能在执行前就被释放，拷贝一份
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, this, buf));
+        }
+    }
+}
+
+void TcpConnection::send(std::string &&buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendStringInLoop(buf);
+        }
+        else
+        {
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, this, std::move(buf)));
         }
     }
 }
@@ -89,35 +112,93 @@ void TcpConnection::send(Buffer *buf)
     {
         if (loop_->isInLoopThread())
         {
-            sendInLoop(buf->peek(), buf->readableBytes());
-            buf->retrieveAll(); 
+            bool wroteDirectly = false;
+            if (!channel_.isWriting() && !hasPendingOutput())
+            {
+                // 没有排队的数据，直接写，写不完的部分交换进发送队列
+                wroteDirectly = true;
+                ssize_t n = buf->readableBytes() > 0 ? ::write(channel_.fd(), buf->peek(), buf->readableBytes()) : 0;
+                if (n > 0)
+                {
+                    buf->retrieve(n);
+                    lastActiveTime_ = loop_->pollReturnTime();
+                }
+                if (buf->readableBytes() == 0)
+                {
+                    if (writeCompleteCallback_)
+                    {
+                        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                    }
+                    return;
+                }
+                if (n < 0 && errno != EWOULDBLOCK)
+                {
+                    LOG_ERROR << "TcpConnection::send";
+                    if (errno == EPIPE || errno == ECONNRESET)
+                    {
+                        buf->retrieveAll();
+                        return;
+                    }
+                }
+            }
+            size_t oldLen = outputChain_.bytes();
+            outputChain_.append(buf);
+            queueOutput(oldLen, !wroteDirectly);
         }
         else
         {
-            // sendInLoop有多重重载，需要使用函数指针确定
-            void (TcpConnection::*fp)(const std::string& message) = &TcpConnection::sendInLoop;
-            loop_->runInLoop(std::bind(fp, this, buf->retrieveAllAsString()));
+            // 交换出 buf 的内容交给 loop 线程，不拷贝数据
+            std::unique_ptr<Buffer> data(new Buffer(0));
+            data->swap(*buf);
+            loop_->runInLoop(std::bind(&TcpConnection::sendBufferInLoop, this, std::move(data)));
         }
     }
 }
 
-void TcpConnection::sendFile(const int fd, const size_t count)
+void TcpConnection::send(const std::shared_ptr<const std::string> &block)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+            sendBlockInLoop(block);
+        else
+            loop_->runInLoop(std::bind(&TcpConnection::sendBlockInLoop, this, block));
+    }
+}
+
+void TcpConnection::sendFile(int fd, off64_t offset, size_t count, const std::shared_ptr<void> &holder)
 {
     if (state_ == kConnected)
     {
-        this->sendFd_ = fd;
-        this->sendLen_ = count;
-   
         if (loop_->isInLoopThread())
-            sendFileInLoop();
+            sendFileInLoop(fd, offset, count, holder);
         else
-            loop_->runInLoop(std::bind(&TcpConnection::sendFileInLoop, this));
+            loop_->runInLoop(std::bind(&TcpConnection::sendFileInLoop, this, fd, offset, count, holder));
+    }
+    else if (!holder)
+    {
+        ::close(fd);
     }
 }
 
-void TcpConnection::sendInLoop(const std::string& message)
+void TcpConnection::send(OutputChain *chain)
 {
-    sendInLoop(message.data(), message.size());
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            size_t oldLen = outputChain_.bytes();
+            outputChain_.append(chain);
+            queueOutput(oldLen);
+        }
+        else
+        {
+            // 把段移到新的 OutputChain 里交给 loop 线程，不拷贝数据
+            std::unique_ptr<OutputChain> data(new OutputChain);
+            data->append(chain);
+            loop_->runInLoop(std::bind(&TcpConnection::sendChainInLoop, this, std::move(data)));
+        }
+    }
 }
 
 /**
@@ -128,6 +209,7 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     ssize_t nwrote = 0;
     size_t remaining = len;
     bool faultError = false;
+    bool wroteDirectly = false;
 
     // 之前调用过connection得shutdown，不能再进行发送了
     if (state_ == kDisconnected)
@@ -136,10 +218,11 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
         return;
     }
 
-    // channel第一次写数据，且缓冲区没有待发送数据
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    // channel第一次写数据，且发送队列中没有待发送数据
+    if (!channel_.isWriting() && !hasPendingOutput())
     {
-        nwrote = ::write(channel_->fd(), data, len);
+        nwrote = ::write(channel_.fd(), data, len);
+        wroteDirectly = true;
         if (nwrote >= 0)
         {
             // 判断有没有一次性写完
@@ -167,70 +250,186 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
 
     }
 
-    // 说明一次性并没有发送完数据，剩余数据需要保存到缓冲区中，且需要改channel注册写事件
+    // 说明一次性并没有发送完数据，剩余数据拷贝到发送队列，且需要改channel注册写事件
     if (!faultError && remaining > 0)
     {
-        size_t oldLen = outputBuffer_.readableBytes();
-        if (oldLen + remaining >= highWaterMark_ 
-        && oldLen < highWaterMark_ 
-        && highWaterMarkCallback_)
-        {
-            // TODO
-            loop_->queueInLoop(std::bind(
-                highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
-        }
-        outputBuffer_.append((char *)data + nwrote, remaining);
-        if (!channel_->isWriting())
-        {
-            channel_->enableWriting(); // 这里一定要注册channel的写事件 否则poller不会给channel通知epollout
-        }
+        size_t oldLen = outputChain_.bytes();
+        outputChain_.append(static_cast<const char*>(data) + nwrote, remaining);
+        // 上面直接写过的话内核缓冲区已经满了，等可写事件
+        queueOutput(oldLen, !wroteDirectly);
     }
 }
 
+void TcpConnection::sendStringInLoop(std::string &message)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR << "disconnected, give up writing";
+        return;
+    }
+    size_t oldLen = outputChain_.bytes();
+    outputChain_.append(std::move(message));
+    queueOutput(oldLen);
+}
 
-void TcpConnection::sendFileInLoop()
+void TcpConnection::sendBufferInLoop(std::unique_ptr<Buffer> &buf)
 {
-    ssize_t nwrote = 0;
-    bool faultError = false;
     if (state_ == kDisconnected)
     {
-        LOG_WARN << "disconnected, give up sending file";
+        LOG_ERROR << "disconnected, give up writing";
         return;
     }
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    size_t oldLen = outputChain_.bytes();
+    outputChain_.append(buf.get());
+    queueOutput(oldLen);
+}
+
+void TcpConnection::sendBlockInLoop(const std::shared_ptr<const std::string> &block)
+{
+    if (state_ == kDisconnected)
     {
-        // 没有在发缓冲区数据/文件数据时才可以发送
-        std::cout<<"sendFileinloop"<<std::endl;
-        std::cout<<sendFd_<<" "<<sendLen_<<std::endl;
-        nwrote = sendfile(socket_->fd(), sendFd_, nullptr, sendLen_);
-        std::cout<<nwrote<<std::endl;
-        if (nwrote >= 0)
+        LOG_ERROR << "disconnected, give up writing";
+        return;
+    }
+    size_t oldLen = outputChain_.bytes();
+    outputChain_.append(block);
+    queueOutput(oldLen);
+}
+
+void TcpConnection::sendFileInLoop(int fd, off64_t offset, size_t count, const std::shared_ptr<void> &holder)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_WARN << "disconnected, give up sending file";
+        if (!holder)
         {
-            sendLen_ -= nwrote;
-            if (sendLen_ == 0)
-                ::close(sendFd_);
+            ::close(fd);
         }
-        else
+        return;
+    }
+    size_t oldLen = outputChain_.bytes();
+    outputChain_.appendFile(fd, offset, count, holder);
+    queueOutput(oldLen);
+}
+
+void TcpConnection::sendChainInLoop(std::unique_ptr<OutputChain> &chain)
+{
+    if (state_ == kDisconnected)
+    {
+        // chain 析构时关闭其中属于发送队列的文件
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
+    size_t oldLen = outputChain_.bytes();
+    outputChain_.append(chain.get());
+    queueOutput(oldLen);
+}
+
+/**
+ * 之前没有在等可写事件说明队列原来是空的，直接尝试发送，发不完再注册写事件
+ * 否则数据排在后面，由 handleWrite 按顺序继续发送
+ */
+void TcpConnection::queueOutput(size_t oldLen, bool tryWrite)
+{
+    addPendingBytes(static_cast<int64_t>(outputChain_.bytes() - oldLen));
+    if (!channel_.isWriting())
+    {
+        bool faultError = false;
+        if (tryWrite && writeOutput(&faultError))
         {
-            nwrote = 0;
-            if (errno != EWOULDBLOCK)
+            if (writeCompleteCallback_)
             {
-                LOG_ERROR << "TcpConnection::sendFileInLoop";
-                if (errno == EPIPE || errno == ECONNRESET) // FIXME: any others?
-                {
-                    faultError = true;
-                }
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
             }
+            return;
+        }
+        if (faultError)
+        {
+            return;
+        }
+        channel_.enableWriting(); // 这里一定要注册channel的写事件 否则poller不会给channel通知epollout
+    }
+
+    size_t newLen = outputChain_.bytes();
+    if (newLen >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_)
+    {
+        loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), newLen));
+    }
+    if (pauseReadMark_ > 0 && newLen >= pauseReadMark_ && !readPaused_)
+    {
+        pauseReading();
+    }
+}
+
+void TcpConnection::pauseReading()
+{
+    readPaused_ = true;
+    pausedAt_ = Timestamp::now();
+    if (channel_.isReading())
+    {
+        channel_.disableReading();
+    }
+}
+
+/**
+ * 读超时顺延停止读的时间，不能因为服务端自己不读而判定对端太慢
+ * 边缘触发模式下重新注册 EPOLLIN 时内核会检查一次，已经到达的数据不会漏掉
+ */
+void TcpConnection::resumeReading()
+{
+    readPaused_ = false;
+    if (readDeadline_.valid())
+    {
+        readDeadline_ = addTime(readDeadline_, timeDifference(Timestamp::now(), pausedAt_));
+    }
+    if ((state_ == kConnected || state_ == kDisconnecting) && !channel_.isReading())
+    {
+        channel_.enableReading();
+    }
+    if (state_ == kConnected)
+    {
+        scheduleTimeout();
+    }
+}
+
+bool TcpConnection::writeOutput(bool *faultError)
+{
+    int savedErrno = 0;
+    size_t before = outputChain_.bytes();
+    // 边缘触发模式下继续写直到 EAGAIN，保证缓冲区有空间时会收到新的 EPOLLOUT
+    outputChain_.writeFd(channel_.fd(), &savedErrno, channel_.isEdgeTriggered());
+    size_t written = before - outputChain_.bytes();
+    if (written > 0)
+    {
+        addPendingBytes(-static_cast<int64_t>(written));
+        lastActiveTime_ = loop_->pollReturnTime();
+        if (readPaused_ && outputChain_.bytes() <= resumeReadMark_)
+        {
+            resumeReading();
         }
     }
-    if (!faultError && sendLen_ > 0)
+    if (savedErrno != 0 && savedErrno != EWOULDBLOCK)
     {
-        if (!channel_->isWriting())
+        errno = savedErrno;
+        LOG_ERROR << "TcpConnection::writeOutput() failed";
+        if (savedErrno == EPIPE || savedErrno == ECONNRESET)
+        {
+            *faultError = true;
+        }
+        else if (savedErrno == EIO)
         {
-            // 监听可写事件
-            channel_->enableWriting();
+            // 文件段没有发完，对端已经无法按 Content-Length 分帧，只能关闭连接
+            *faultError = true;
+            forceClose();
         }
     }
+    return outputChain_.empty();
+}
+
+void TcpConnection::addPendingBytes(int64_t delta)
+{
+    pendingBytes_ += delta;
+    loop_->addPendingBytes(delta);
 }
 
 // 关闭连接 
@@ -244,27 +443,93 @@ void TcpConnection::shutdown()
     }
 }
 
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(
+            std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
+    }
+}
+
+void TcpConnection::setIdleTimeout(double seconds)
+{
+    idleTimeout_ = seconds;
+    if (state_ == kConnected)
+    {
+        scheduleTimeout();
+    }
+}
+
+void TcpConnection::setReadTimeout(double seconds)
+{
+    readDeadline_ = seconds > 0 ? addTime(Timestamp::now(), seconds) : Timestamp::invalid();
+    if (state_ == kConnected)
+    {
+        scheduleTimeout();
+    }
+}
+
+Timestamp TcpConnection::timeoutDeadline() const
+{
+    // 停止读期间不检查读超时，恢复时重新登记
+    Timestamp deadline = readPaused_ ? Timestamp::invalid() : readDeadline_;
+    if (idleTimeout_ > 0)
+    {
+        Timestamp idleDeadline = addTime(lastActiveTime_, idleTimeout_);
+        if (!deadline.valid() || idleDeadline < deadline)
+        {
+            deadline = idleDeadline;
+        }
+    }
+    return deadline;
+}
+
+void TcpConnection::scheduleTimeout()
+{
+    if (idleTimeout_ > 0 || readDeadline_.valid())
+    {
+        loop_->timeoutWheel()->schedule(shared_from_this());
+    }
+}
+
 void TcpConnection::shutdownInLoop()
 {
-    if (!channel_->isWriting()) // 说明当前outputBuffer_的数据全部向外发送完成
+    if (!channel_.isWriting()) // 说明当前outputChain_的数据全部向外发送完成
     {
-        socket_->shutdownWrite();
+        socket_.shutdownWrite();
     }
 }
 
+void TcpConnection::setEdgeTriggered(bool on)
+{
+    channel_.setEdgeTriggered(on);
+}
+
 // 连接建立
 void TcpConnection::connectEstablished()
 {
     setState(kConnected); // 建立连接，设置一开始状态为连接态
     /**
      * TODO:tie
-     * channel_->tie(shared_from_this());
+     * channel_.tie(shared_from_this());
      * tie相当于在底层有一个强引用指针记录着，防止析构
      * 为了防止TcpConnection这个资源被误删掉，而这个时候还有许多事件要处理
      * channel->tie 会进行一次判断，是否将弱引用指针变成强引用，变成得话就防止了计数为0而被析构得可能
      */
-    channel_->tie(shared_from_this());
-    channel_->enableReading(); // 向poller注册channel的EPOLLIN读事件
+    channel_.tie(shared_from_this());
+    channel_.enableReading(); // 向poller注册channel的EPOLLIN读事件
+    lastActiveTime_ = Timestamp::now();
+    scheduleTimeout();
 
     // 新连接建立 执行回调
     connectionCallback_(shared_from_this());
@@ -276,80 +541,120 @@ void TcpConnection::connectDestroyed()
     if (state_ == kConnected)
     {
         setState(kDisconnected);
-        channel_->disableAll(); // 把channel的所有感兴趣的事件从poller中删除掉
+        channel_.disableAll(); // 把channel的所有感兴趣的事件从poller中删除掉
         connectionCallback_(shared_from_this());
     }
-    channel_->remove(); // 把channel从poller中删除掉
+    channel_.remove(); // 把channel从poller中删除掉
+    // 没发出去的数据不再计入 loop 的负载
+    addPendingBytes(-pendingBytes_);
+    // 对应 TcpServer::newConnectionInLoop 里的加一
+    loop_->addConnections(-1);
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
-    int savedErrno = 0;
-    // TcpConnection会从socket读取数据，然后写入inpuBuffer
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-    if (n > 0)
-    {
-        // 已建立连接的用户，有可读事件发生，调用用户传入的回调操作
-        // TODO:shared_from_this
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
-    }
-    else if (n == 0)
+    // 边缘触发模式下要一直读到 EAGAIN，每读一次交给用户处理一次，避免 inputBuffer_ 无限增长
+    const bool edgeTriggered = channel_.isEdgeTriggered();
+    size_t budget = kMaxReadPerEvent;
+    do
     {
-        // 没有数据，说明客户端关闭连接
-        handleClose();
-    }
-    else
+        if (budget == 0)
+        {
+            // 一次事件读的数据有上限，一直有数据的连接不能让同一个 loop 上的其他连接饿死
+            // 还没读到 EAGAIN，不会再有新的边缘，放到本轮事件处理完之后接着读
+            loop_->queueInLoop(std::bind(&TcpConnection::continueReading, shared_from_this()));
+            return;
+        }
+        int savedErrno = 0;
+        // TcpConnection会从socket读取数据，然后写入inpuBuffer
+        ssize_t n = inputBuffer_.readFd(channel_.fd(), &savedErrno);
+        if (n > 0)
+        {
+            budget -= std::min(budget, static_cast<size_t>(n));
+            lastReceiveTime_ = receiveTime;
+            lastActiveTime_ = receiveTime;
+            // 已建立连接的用户，有可读事件发生，调用用户传入的回调操作
+            // TODO:shared_from_this
+            messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+            shrinkInputBuffer();
+        }
+        else if (n == 0)
+        {
+            // 没有数据，说明客户端关闭连接
+            handleClose();
+            return;
+        }
+        else
+        {
+            if (savedErrno != EWOULDBLOCK)
+            {
+                // 出错情况
+                errno = savedErrno;
+                LOG_ERROR << "TcpConnection::handleRead() failed";
+                handleError();
+            }
+            return;
+        }
+    } while (edgeTriggered && state_ != kDisconnected && channel_.isReading());
+}
+
+// 等待期间连接可能已经关闭或者暂停读，这时不再读
+void TcpConnection::continueReading()
+{
+    if (state_ != kDisconnected && channel_.isReading())
     {
-        // 出错情况
-        errno = savedErrno;
-        LOG_ERROR << "TcpConnection::handleRead() failed";
-        handleError();
+        handleRead(loop_->pollReturnTime());
     }
 }
 
+/**
+ * 按顺序发送 outputChain_ 中的内容，全部发完后不再关注写事件
+ */
 void TcpConnection::handleWrite()
 {
-    if (channel_->isWriting())
+    if (!channel_.isWriting())
     {
-        int saveErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
-        // 正确读取数据
-        if (n > 0)
+        // state_不为写状态
+        LOG_ERROR << "TcpConnection fd=" << channel_.fd() << " is down, no more writing";
+        return;
+    }
+
+    bool faultError = false;
+    if (writeOutput(&faultError))
+    {
+        // 说明待发送数据都写给了客户端，不再关注写事件
+        channel_.disableWriting();
+        // 调用用户自定义的写完数据处理函数
+        if (writeCompleteCallback_)
         {
-            outputBuffer_.retrieve(n);
-            // 说明buffer可读数据都被TcpConnection读取完毕并写入给了客户端
-            // 此时就可以关闭连接，否则还需继续提醒写事件
-            if (outputBuffer_.readableBytes() == 0)
-            {
-                channel_->disableWriting();
-                // 调用用户自定义的写完数据处理函数
-                if (writeCompleteCallback_)
-                {
-                    // 唤醒loop_对应得thread线程，执行写完成事件回调
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
-                }
-                if (state_ == kDisconnecting)
-                {
-                    shutdownInLoop();
-                }
-            }
+            // 唤醒loop_对应得thread线程，执行写完成事件回调
+            loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
         }
-        else
+        if (state_ == kDisconnecting)
         {
-            LOG_ERROR << "TcpConnection::handleWrite() failed";
+            shutdownInLoop();
         }
     }
-    // state_不为写状态
-    else
+}
+
+/**
+ * 数据处理完就把内存还给线程的缓存，空闲的连接不占读缓冲区
+ * 突发流量把缓冲区撑大后，剩下的数据不到四分之一时缩小
+ */
+void TcpConnection::shrinkInputBuffer()
+{
+    const size_t readable = inputBuffer_.readableBytes();
+    const size_t capacity = inputBuffer_.internalCapacity();
+    if (readable == 0 || (capacity > BufferAllocator::kMaxBlock && readable < capacity / 4))
     {
-        LOG_ERROR << "TcpConnection fd=" << channel_->fd() << " is down, no more writing";
+        inputBuffer_.shrink(0);
     }
 }
 
 void TcpConnection::handleClose()
 {
     setState(kDisconnected);    // 设置状态为关闭连接状态
-    channel_->disableAll();     // 注销Channel所有感兴趣事件
+    channel_.disableAll();     // 注销Channel所有感兴趣事件
     
     TcpConnectionPtr connPtr(shared_from_this());
     connectionCallback_(connPtr);   
@@ -362,7 +667,7 @@ void TcpConnection::handleError()
     socklen_t optlen = sizeof(optval);
     int err = 0;
     // TODO:getsockopt ERROR
-    if (::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen))
+    if (::getsockopt(channel_.fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen))
     {
         err = errno;
     }
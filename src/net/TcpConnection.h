@@ -4,18 +4,20 @@
 #include <memory>
 #include <string>
 #include <atomic>
-#include <string>
+#include <sys/types.h>
+#include <unistd.h>
 #include <boost/any.hpp>
 
 #include "noncopyable.h"
 #include "Callback.h"
 #include "Buffer.h"
+#include "OutputChain.h"
 #include "Timestamp.h"
 #include "InetAddress.h"
+#include "Socket.h"
+#include "Channel.h"
 
-class Channel;
 class EventLoop;
-class Socket;
 /**
          * TcpConnection是muduo里唯一默认使用shared_ptr来管理的class，
          * 也是唯一继承enable_shared_from_this的class，这源于其模糊的生命期
@@ -29,27 +31,61 @@ class TcpConnection : noncopyable,
 {
 public:
     TcpConnection(EventLoop *loop,
-                const std::string &nameArg,
+                std::string nameArg,
                 int sockfd,
                 const InetAddress &localAddr,
                 const InetAddress &peerAddr);
     ~TcpConnection();
 
     EventLoop* getLoop() const { return loop_; }
+    int fd() const { return socket_.fd(); }
     const std::string& name() const { return name_; }
     const InetAddress& localAddress() const { return localAddr_; }
     const InetAddress& peerAddress() const { return peerAddr_; }
 
     bool connected() const { return state_ == kConnected; }
 
-    // 发送数据
+    // 最近一次收到数据的时间，用于判断连接是否空闲
+    Timestamp lastReceiveTime() const { return lastReceiveTime_; }
+
+    /**
+     * 超时设置，由所属 loop 的 TimeoutWheel 检查，超时后 forceClose
+     * 空闲超时: 超过 seconds 秒没有收发数据，0 表示不检查
+     * 读超时: 从现在起 seconds 秒后到期，上层每进入一个读取阶段(如请求头、请求体)重新设置，0 取消
+     * 建立连接前可以在任意线程设置空闲超时，其他情况只能在 loop 线程调用
+     */
+    void setIdleTimeout(double seconds);
+    void setReadTimeout(double seconds);
+    // 空闲截止时间和读截止时间中较早的一个，都没有设置时返回无效时间戳
+    Timestamp timeoutDeadline() const;
+
+    /**
+     * 发送数据，和 sendFile 一起按调用顺序排队发送
+     * 右值字符串、Buffer(交换内容)和共享的不可变数据直接放进发送队列，不拷贝
+     */
     void send(const std::string &buf);
+    void send(std::string &&buf);
     void send(Buffer *buf);
-    void sendFile(const int fd, const size_t count);
+    void send(const std::shared_ptr<const std::string> &block);
+    /**
+     * 发送文件 fd 中 [offset, offset+count) 的内容，和 send 的数据按调用顺序排队发送
+     * holder 为空时 fd 的所有权交给 TcpConnection，发送完成或连接销毁时关闭
+     * holder 不为空时 fd 由 holder 管理(例如共享的文件缓存)，发送期间持有 holder 的引用
+     */
+    void sendFile(int fd, off64_t offset, size_t count,
+                  const std::shared_ptr<void> &holder = std::shared_ptr<void>());
+    /**
+     * 把调用者组装好的多段数据(比如响应头、响应体和文件)一起放进发送队列，只尝试发送一次，
+     * 相邻的内存段合并成一次 writev，后面紧跟 sendfile
+     * chain 的内容被移走，连接已经断开时不动 chain，由调用者析构时关闭其中的文件
+     */
+    void send(OutputChain *chain);
     //void setTcpNoDelay(bool on);
 
     // 关闭连接
     void shutdown();
+    // 不等待数据发送完，直接关闭连接
+    void forceClose();
 
     // 保存用户自定义的回调函数
     void setConnectionCallback(const ConnectionCallback &cb)
@@ -62,12 +98,34 @@ public:
     { closeCallback_ = cb; }
     void setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark)
     { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
+
+    /**
+     * 流量控制: 待发送数据达到 highWaterMark 时停止读(取消 EPOLLIN)，发送到 lowWaterMark 以下时恢复
+     * 对端只发请求不读响应时发送队列不会无限增长，highWaterMark 为 0 表示不限制
+     * 停止读期间读超时暂停计时
+     */
+    void setFlowControl(size_t highWaterMark, size_t lowWaterMark)
+    { pauseReadMark_ = highWaterMark; resumeReadMark_ = lowWaterMark; }
+    bool isReadPaused() const { return readPaused_; }
+
+    // 服务器正在优雅关闭，上层处理完当前请求后应当关闭连接，只在 loop 线程访问
+    void setDraining() { draining_ = true; }
+    bool draining() const { return draining_; }
     
     // context_ 目前主要用于存储 HttpContext
     void setContext(const boost::any &context) { context_ = context; }
     const boost::any &getContext() const { return context_; }
     boost::any *getMutableContext() { return &context_; }
 
+    /**
+     * 使用边缘触发的 epoll，需要在 connectEstablished 之前设置
+     * 读写时一直读/写到 EAGAIN，EPOLLOUT 一直保持注册，减少 epoll_ctl 调用
+     */
+    void setEdgeTriggered(bool on);
+
+    // 设置 socket 的 SO_BUSY_POLL(微秒)，见 Socket::setBusyPoll
+    void setSocketBusyPoll(int us) { socket_.setBusyPoll(us); }
+
     // TcpServer会调用
     void connectEstablished(); // 连接建立
     void connectDestroyed();   // 连接销毁
@@ -85,27 +143,52 @@ private:
     // 注册到channel上的回调函数，poller通知后会调用这些函数处理
     // 然后这些函数最后会再调用从用户那里传来的回调函数
     void handleRead(Timestamp receiveTime);
+    // 边缘触发时一次事件读满上限后由 loop 排队调用，继续读剩下的数据
+    void continueReading();
     void handleWrite();
     void handleClose();
     void handleError();
+    void shrinkInputBuffer();
 
     void sendInLoop(const void* message, size_t len);
-    void sendInLoop(const std::string& message);
-    void sendFileInLoop();
+    void sendStringInLoop(std::string &message);
+    void sendBufferInLoop(std::unique_ptr<Buffer> &buf);
+    void sendBlockInLoop(const std::shared_ptr<const std::string> &block);
+    void sendFileInLoop(int fd, off64_t offset, size_t count, const std::shared_ptr<void> &holder);
+    void sendChainInLoop(std::unique_ptr<OutputChain> &chain);
+    /**
+     * 数据加入 outputChain_ 之后调用，oldLen 是加入前的待发送字节数
+     * 调用者刚刚直接写过一次且没写完时 tryWrite 为 false，内核缓冲区已满，再写只会得到 EAGAIN
+     */
+    void queueOutput(size_t oldLen, bool tryWrite = true);
+    // 尽量写出 outputChain_，全部写完返回 true
+    bool writeOutput(bool *faultError);
+    bool hasPendingOutput() const { return !outputChain_.empty(); }
+    // 待发送字节数变化时同步到所属 loop 的负载统计
+    void addPendingBytes(int64_t delta);
     void shutdownInLoop();
+    void forceCloseInLoop();
+    void scheduleTimeout();
+    void pauseReading();
+    void resumeReading();
     
     EventLoop *loop_;           // 属于哪个subLoop（如果是单线程则为mainLoop）
     const std::string name_;
     std::atomic_int state_;     // 连接状态
     bool reading_;
 
-    std::unique_ptr<Socket> socket_;;
-    std::unique_ptr<Channel> channel_;
+    // 直接作为成员，和连接一起从 loop 的对象池分配，不需要单独 new
+    Socket socket_;
+    Channel channel_;
 
     const InetAddress localAddr_;   // 本服务器地址
     const InetAddress peerAddr_;    // 对端地址
-    int sendFd_;     // sendFile 保存在本地的 fd
-    size_t sendLen_; // 当前需要发送的数据长度
+    Timestamp lastReceiveTime_;     // 最近一次收到数据的时间
+    Timestamp lastActiveTime_;      // 最近一次收到或发出数据的时间
+    double idleTimeout_;
+    Timestamp readDeadline_;
+    Timestamp scheduledDeadline_;   // 在 TimeoutWheel 中登记的截止时间，由 TimeoutWheel 维护
+    friend class TimeoutWheel;
 
     /**
      * 用户自定义的这些事件的处理函数，然后传递给 TcpServer 
@@ -117,9 +200,15 @@ private:
     CloseCallback closeCallback_;                   // 客户端关闭连接的回调
     HighWaterMarkCallback highWaterMarkCallback_;   // 超出水位实现的回调
     size_t highWaterMark_;
+    size_t pauseReadMark_;      // 流量控制的高低水位
+    size_t resumeReadMark_;
+    bool readPaused_;           // 因为待发送数据太多停止了读
+    bool draining_;
+    Timestamp pausedAt_;
 
     Buffer inputBuffer_;    // 读取数据的缓冲区
-    Buffer outputBuffer_;   // 发送数据的缓冲区
+    OutputChain outputChain_;   // 待发送的数据和文件段
+    int64_t pendingBytes_;      // outputChain_ 中还没发出去的字节数，同步到 loop 的负载统计
     boost::any context_;
 };
 
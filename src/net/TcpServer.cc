@@ -1,9 +1,14 @@
 #include <functional>
+#include <future>
+#include <stdio.h>
 #include <string.h>
+#include <algorithm>
+#include <unistd.h>
 
 #include "TcpServer.h"
 #include "TcpConnection.h"
 #include "Logging.h"
+#include "FixedBlockPool.h"
 
 // 检查传入的 baseLoop 指针是否有意义
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
@@ -20,16 +25,30 @@ TcpServer::TcpServer(EventLoop *loop,
                      const std::string &nameArg,
                      Option option)
     : loop_(CheckLoopNotNull(loop)),
+    listenAddr_(listenAddr),
     ipPort_(listenAddr.toIpPort()),
     name_(nameArg),
     acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
     threadPool_(new EventLoopThreadPool(loop, name_)),
+    acceptStrategy_(kMainLoopAccept),
+    steering_(kSteerByHash),
     connectionCallback_(),
     messageCallback_(),
     writeCompleteCallback_(),
     threadInitCallback_(),
     started_(0),
-    nextConnId_(1)    
+    acceptBatch_(Acceptor::kDefaultAcceptBatch),
+    nextConnId_(1),
+    connNamePrefix_(name_ + "-" + ipPort_ + "#"),
+    edgeTriggered_(false),
+    idleTimeout_(0.0),
+    pauseReadMark_(0),
+    resumeReadMark_(0),
+    busyPollUs_(0),
+    socketBusyPollUs_(0),
+    draining_(false),
+    closingAcceptors_(0),
+    connectionCount_(0)
 {
     // 当有新用户连接时，Acceptor类中绑定的acceptChannel_会有读事件发生执行handleRead()调用TcpServer::newConnection回调
     acceptor_->setNewConnectionCallback(
@@ -38,11 +57,29 @@ TcpServer::TcpServer(EventLoop *loop,
 
 TcpServer::~TcpServer()
 {
+    // subLoop 的 Acceptor 要在各自的 loop 线程里注销 channel，等它完成，之后 subLoop 才会退出
+    for (std::unique_ptr<Acceptor> &acceptor : loopAcceptors_)
+    {
+        std::promise<void> done;
+        Acceptor *raw = acceptor.get();
+        acceptor.release();
+        raw->loop()->runInLoop([raw, &done]() {
+            delete raw;
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
     for(auto &item : connections_)
     {
-        TcpConnectionPtr conn(item.second);
+        if (!item)
+        {
+            continue;
+        }
+        TcpConnectionPtr conn(item);
         // 把原始的智能指针复位 让栈空间的TcpConnectionPtr conn指向该对象 当conn出了其作用域 即可释放智能指针指向的对象
-        item.second.reset();    
+        item.reset();    
         // 销毁连接
         conn->getLoop()->runInLoop(
             std::bind(&TcpConnection::connectDestroyed, conn));
@@ -64,23 +101,271 @@ void TcpServer::start()
     {
         // 启动底层的lopp线程池
         threadPool_->start(threadInitCallback_);
-        // acceptor_.get()绑定时候需要地址
-        loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        if (busyPollUs_ > 0)
+        {
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                ioLoop->setBusyPoll(busyPollUs_);
+            }
+        }
+        if (acceptStrategy_ == kReusePortPerLoop)
+        {
+            startLoopAcceptors();
+        }
+        else
+        {
+            acceptor_->setAcceptBatch(acceptBatch_);
+            // acceptor_.get()绑定时候需要地址
+            loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+            // 接管的多余的监听 socket
+            for (std::unique_ptr<Acceptor> &acceptor : loopAcceptors_)
+            {
+                acceptor->setAcceptBatch(acceptBatch_);
+                loop_->runInLoop(std::bind(&Acceptor::listen, acceptor.get()));
+            }
+        }
+    }
+}
+
+/**
+ * 每个 subLoop 一个绑定同一地址的 SO_REUSEPORT 监听 socket，内核把新连接直接排到其中一个的队列上
+ * 在当前线程按顺序 listen，保证第 i 个监听 socket 在 reuseport 组中的下标是 i
+ */
+void TcpServer::startLoopAcceptors()
+{
+    // baseLoop 的 Acceptor 不再使用，释放它绑定的 socket
+    acceptor_.reset();
+
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    const int numLoops = static_cast<int>(loops.size());
+    // 按 CPU 分配连接时第 i 个 socket 对应第 i 个 subLoop 绑定的 CPU，没有绑定时退回内核默认的哈希
+    const std::vector<int> &cpus = threadPool_->ioCpus();
+    const bool steerByCpu = steering_ != kSteerByHash && numLoops > 1 && !cpus.empty();
+    if (steering_ != kSteerByHash && numLoops > 1 && cpus.empty())
+    {
+        LOG_WARN << "TcpServer [" << name_ << "] CPU steering needs thread placement, falls back to hash steering";
+    }
+    /**
+     * 接管的 socket 都要保留，它们的 accept 队列里可能已经有连接，关闭就丢了
+     * 比 loop 多时按顺序轮流分给各个 loop，有的 loop 不止一个 Acceptor
+     */
+    const int numAcceptors = std::max(numLoops, static_cast<int>(adoptedFds_.size()));
+    for (int i = 0; i < numAcceptors; ++i)
+    {
+        EventLoop *ioLoop = loops[i % numLoops];
+        std::unique_ptr<Acceptor> acceptor(static_cast<size_t>(i) < adoptedFds_.size()
+            ? new Acceptor(ioLoop, adoptedFds_[i])
+            : new Acceptor(ioLoop, listenAddr_, true));
+        acceptor->setNewConnectionCallback(
+            std::bind(&TcpServer::newConnectionInLoop, this, ioLoop, std::placeholders::_1, std::placeholders::_2));
+        acceptor->setAcceptBatch(acceptBatch_);
+        if (steerByCpu && steering_ == kSteerByIncomingCpu)
+        {
+            acceptor->setIncomingCpu(cpus[i % numLoops]);
+        }
+        acceptor->listen();
+        loopAcceptors_.push_back(std::move(acceptor));
+    }
+    adoptedFds_.clear();
+    // 新连接只分给前 numLoops 个 socket，多出来的接管 socket 只接受队列里剩下的连接
+    if (steerByCpu && steering_ == kSteerByCpuBpf && !loopAcceptors_[0]->attachReusePortCpuBpf(cpus))
+    {
+        LOG_WARN << "TcpServer [" << name_ << "] falls back to hash steering";
+    }
+}
+
+void TcpServer::adoptListenFds(const std::vector<int> &fds)
+{
+    if (fds.empty())
+    {
+        return;
+    }
+    adoptedFds_ = fds;
+    if (acceptStrategy_ != kReusePortPerLoop)
+    {
+        /**
+         * 第一个替换掉构造时 bind 的 socket
+         * 旧进程是 kReusePortPerLoop 时会交过来多个，其余的也在 baseLoop 上 accept，不能关闭丢掉排队的连接
+         */
+        acceptor_.reset(new Acceptor(loop_, adoptedFds_[0]));
+        acceptor_->setNewConnectionCallback(
+            std::bind(&TcpServer::newConnection, this, std::placeholders::_1, std::placeholders::_2));
+        for (size_t i = 1; i < adoptedFds_.size(); ++i)
+        {
+            std::unique_ptr<Acceptor> acceptor(new Acceptor(loop_, adoptedFds_[i]));
+            acceptor->setNewConnectionCallback(
+                std::bind(&TcpServer::newConnection, this, std::placeholders::_1, std::placeholders::_2));
+            loopAcceptors_.push_back(std::move(acceptor));
+        }
+        adoptedFds_.clear();
+    }
+}
+
+std::vector<int> TcpServer::listenFds() const
+{
+    std::vector<int> fds;
+    if (acceptor_)
+    {
+        fds.push_back(acceptor_->fd());
+    }
+    for (const std::unique_ptr<Acceptor> &acceptor : loopAcceptors_)
+    {
+        fds.push_back(acceptor->fd());
+    }
+    return fds;
+}
+
+size_t TcpServer::connectionCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return connectionCount_;
+}
+
+void TcpServer::drain(double timeoutSeconds, const std::function<void()> &done)
+{
+    // 在 loop 线程里也放到 pendingFunctors 中执行，Acceptor 的 channel 可能在本轮的活跃列表里，不能在处理事件时析构
+    loop_->queueInLoop(std::bind(&TcpServer::drainInLoop, this, timeoutSeconds, done));
+}
+
+void TcpServer::drainInLoop(double timeoutSeconds, const std::function<void()> &done)
+{
+    if (draining_.exchange(true))
+    {
+        return;
+    }
+    LOG_INFO << "TcpServer [" << name_ << "] draining " << connectionCount() << " connections";
+    drainDone_ = done;
+
+    /**
+     * 关闭监听 socket，新连接被拒绝；socket 交给了新进程时由新进程继续 accept
+     * subLoop 的 Acceptor 在自己的线程里析构，析构之前还可能接受新连接，都析构完才能结束 drain
+     */
+    acceptor_.reset();
+    closingAcceptors_ = loopAcceptors_.size();
+    for (std::unique_ptr<Acceptor> &acceptor : loopAcceptors_)
+    {
+        Acceptor *raw = acceptor.release();
+        raw->loop()->runInLoop([this, raw]() {
+            delete raw;
+            loop_->queueInLoop(std::bind(&TcpServer::acceptorClosed, this));
+        });
+    }
+    loopAcceptors_.clear();
+
+    std::vector<TcpConnectionPtr> conns;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const TcpConnectionPtr &conn : connections_)
+        {
+            if (conn)
+            {
+                conns.push_back(conn);
+            }
+        }
+    }
+    for (const TcpConnectionPtr &conn : conns)
+    {
+        conn->getLoop()->runInLoop(std::bind(&TcpServer::drainConnection, this, conn));
+    }
+
+    drainTimer_ = loop_->runAfter(timeoutSeconds, std::bind(&TcpServer::forceCloseAll, this));
+    finishDrain();
+}
+
+void TcpServer::acceptorClosed()
+{
+    --closingAcceptors_;
+    finishDrain();
+}
+
+// 在连接所属的 loop 线程调用
+void TcpServer::drainConnection(const TcpConnectionPtr &conn)
+{
+    if (!conn->connected() || conn->draining())
+    {
+        return;
+    }
+    conn->setDraining();
+    if (drainCallback_)
+    {
+        drainCallback_(conn);
+    }
+    else
+    {
+        conn->shutdown();
     }
 }
 
+void TcpServer::forceCloseAll()
+{
+    std::vector<TcpConnectionPtr> conns;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const TcpConnectionPtr &conn : connections_)
+        {
+            if (conn)
+            {
+                conns.push_back(conn);
+            }
+        }
+    }
+    LOG_WARN << "TcpServer [" << name_ << "] drain timeout, force close " << conns.size() << " connections";
+    for (const TcpConnectionPtr &conn : conns)
+    {
+        conn->forceClose();
+    }
+}
+
+// 在 baseLoop 线程调用，监听 socket 都已关闭并且没有连接时才结束
+void TcpServer::finishDrain()
+{
+    if (!drainDone_ || closingAcceptors_ > 0 || connectionCount() > 0)
+    {
+        return;
+    }
+    loop_->cancel(drainTimer_);
+    std::function<void()> done;
+    done.swap(drainDone_);
+    LOG_INFO << "TcpServer [" << name_ << "] drained";
+    done();
+}
+
+uint64_t TcpServer::acceptedConnections() const
+{
+    uint64_t total = acceptor_ ? acceptor_->acceptedCount() : 0;
+    for (const std::unique_ptr<Acceptor> &acceptor : loopAcceptors_)
+    {
+        total += acceptor->acceptedCount();
+    }
+    return total;
+}
+
+uint64_t TcpServer::rejectedConnections() const
+{
+    uint64_t total = acceptor_ ? acceptor_->rejectedCount() : 0;
+    for (const std::unique_ptr<Acceptor> &acceptor : loopAcceptors_)
+    {
+        total += acceptor->rejectedCount();
+    }
+    return total;
+}
+
 // 有一个新用户连接，acceptor会执行这个回调操作，负责将mainLoop接收到的请求连接(acceptChannel_会有读事件发生)通过回调轮询分发给subLoop去处理
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
-    // 轮询算法 选择一个subLoop 来管理connfd对应的channel
-    EventLoop *ioLoop = threadPool_->getNextLoop();
-    // 提示信息
-    char buf[64] = {0};
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    // 这里没有设置为原子类是因为其只在mainloop中执行 不涉及线程安全问题
-    ++nextConnId_;  
-    // 新连接名字
-    std::string connName = name_ + buf;
+    // 按负载均衡策略选择一个subLoop 来管理connfd对应的channel
+    newConnectionInLoop(threadPool_->getLoopForPeer(peerAddr), sockfd, peerAddr);
+}
+
+void TcpServer::newConnectionInLoop(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr)
+{
+    // 新连接名字，kReusePortPerLoop 时多个 subLoop 同时建立连接，nextConnId_ 是原子变量
+    // 一次分配拼好，之后移动给 TcpConnection
+    char id[16];
+    snprintf(id, sizeof(id), "%d", nextConnId_++);
+    std::string connName;
+    connName.reserve(connNamePrefix_.size() + strlen(id));
+    connName.append(connNamePrefix_).append(id);
 
     LOG_INFO << "TcpServer::newConnection [" << name_.c_str() << "] - new connection [" << connName.c_str() << "] from " << peerAddr.toIpPort().c_str();
     
@@ -94,17 +379,35 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     }
 
     InetAddress localAddr(local);
-    TcpConnectionPtr conn(new TcpConnection(ioLoop,
-                                            connName,
-                                            sockfd,
-                                            localAddr,
-                                            peerAddr));
-    connections_[connName] = conn;
+    // 选定 loop 时就计入连接数，同一批 accept 的连接不会因为 connectEstablished 还没执行都分到同一个 loop
+    ioLoop->addConnections(1);
+    /**
+     * 连接对象从 ioLoop 的对象池分配，Socket、Channel 是它的成员
+     * 控制块从另一个池分配: TimeoutWheel 的过期条目里的 weak_ptr 要到检查时才释放，不能占着连接对象的块
+     */
+    TcpConnectionPtr conn = makePooled<TcpConnection>(
+        ioLoop->connectionPool(), ioLoop->controlBlockPool(), ioLoop, std::move(connName), sockfd, localAddr, peerAddr);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (static_cast<size_t>(sockfd) >= connections_.size())
+        {
+            connections_.resize(std::max<size_t>(sockfd + 1, connections_.size() * 2));
+        }
+        connections_[sockfd] = conn;
+        ++connectionCount_;
+    }
     // 下面的回调都是用户设置给TcpServer => TcpConnection的，至于Channel绑定的则是TcpConnection设置的四个，
     //handleRead,handleWrite... 这下面的回调用于handlexxx函数中
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setEdgeTriggered(edgeTriggered_);
+    conn->setIdleTimeout(idleTimeout_);
+    conn->setFlowControl(pauseReadMark_, resumeReadMark_);
+    if (socketBusyPollUs_ > 0)
+    {
+        conn->setSocketBusyPoll(socketBusyPollUs_);
+    }
 
     // 设置了如何关闭连接的回调
     conn->setCloseCallback(
@@ -112,22 +415,37 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     //添加计时器
     // ioLoop->runEvery(3.0, std::bind(&TcpServer::printThroughput, this));
     
+    // kReusePortPerLoop 时已经在 ioLoop 线程里，直接建立连接
     ioLoop->runInLoop(
         std::bind(&TcpConnection::connectEstablished, conn));
+    // drain 开始时还没停下的 subLoop Acceptor 接受的连接
+    if (draining_)
+    {
+        ioLoop->runInLoop(std::bind(&TcpServer::drainConnection, this, conn));
+    }
 }
 
+// 在连接所属的 subLoop 中调用，connections_ 有锁保护，不需要再转到 baseLoop
 void TcpServer::removeConnection(const TcpConnectionPtr &conn)
 {
-    loop_->runInLoop(
-        std::bind(&TcpServer::removeConnectionInLoop, this, conn));
-}
-
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
-{
-    LOG_INFO << "TcpServer::removeConnectionInLoop [" << name_.c_str() << "] - connection " << conn->name().c_str();
+    LOG_INFO << "TcpServer::removeConnection [" << name_.c_str() << "] - connection " << conn->name().c_str();
 
-    connections_.erase(conn->name());
+    bool drained = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int fd = conn->fd();
+        if (static_cast<size_t>(fd) < connections_.size() && connections_[fd] == conn)
+        {
+            connections_[fd].reset();
+            --connectionCount_;
+            drained = draining_ && connectionCount_ == 0;
+        }
+    }
+    if (drained)
+    {
+        loop_->queueInLoop(std::bind(&TcpServer::finishDrain, this));
+    }
     EventLoop *ioLoop = conn->getLoop();
     ioLoop->queueInLoop(
         std::bind(&TcpConnection::connectDestroyed, conn));
-}
\ No newline at end of file
+}
@@ -4,8 +4,9 @@
 #include <functional>
 #include <string>
 #include <memory>
-#include <unordered_map>
 #include <atomic>
+#include <mutex>
+#include <vector>
 
 #include "EventLoop.h"
 #include "EventLoopThreadPool.h"
@@ -23,6 +24,7 @@ class TcpServer : noncopyable
 {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
+    using DrainCallback = std::function<void(const TcpConnectionPtr&)>;
 
     enum Option
     {
@@ -30,6 +32,24 @@ public:
         kReusePort,
     };
 
+    // 接受新连接的方式
+    enum AcceptStrategy
+    {
+        kMainLoopAccept,    // baseLoop 上一个 Acceptor，新连接轮询分给 subLoop
+        kReusePortPerLoop,  // 每个 subLoop 有自己的 SO_REUSEPORT 监听 socket，由内核分配连接，不经过 baseLoop
+    };
+
+    /**
+     * kReusePortPerLoop 时内核把连接分给哪个监听 socket
+     * 按 CPU 分配时第 i 个 subLoop 对应 ioCpus()[i]，需要用 setThreadPlacement 绑定 CPU，否则按哈希分配
+     */
+    enum ReusePortSteering
+    {
+        kSteerByHash,           // 内核默认，按四元组哈希
+        kSteerByIncomingCpu,    // SO_INCOMING_CPU，优先交给绑定在处理这个连接的 CPU 上的 subLoop
+        kSteerByCpuBpf,         // reuseport cBPF 程序，交给绑定在处理 SYN 的 CPU 上的 subLoop，其他 CPU 取模
+    };
+
     TcpServer(EventLoop *loop,
                 const InetAddress &ListenAddr,
                 const std::string &nameArg,
@@ -45,8 +65,78 @@ public:
     // 设置底层subLoop的个数
     void setThreadNum(int numThreads);
 
+    // kMainLoopAccept 时新连接分配给 subLoop 的策略，见 EventLoopThreadPool
+    void setBalancePolicy(EventLoopThreadPool::BalancePolicy policy) { threadPool_->setBalancePolicy(policy); }
+    void setLoopSelector(EventLoopThreadPool::LoopSelector selector) { threadPool_->setLoopSelector(std::move(selector)); }
+
+    // subLoop 线程的 CPU 放置策略，需要在 start 之前设置，见 EventLoopThreadPool::setPlacement
+    void setThreadPlacement(EventLoopThreadPool::PlacementPolicy policy, const std::vector<int> &cpus = std::vector<int>())
+    { threadPool_->setPlacement(policy, cpus); }
+    const std::vector<int>& ioCpus() const { return threadPool_->ioCpus(); }
+
+    // 新连接使用边缘触发的 epoll，需要在 start 之前设置
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+    // 新连接的空闲超时(秒)，超时没有收发数据的连接由所在 subLoop 批量关闭，0 表示不检查
+    void setIdleTimeout(double seconds) { idleTimeout_ = seconds; }
+
+    // 新连接的流量控制水位，见 TcpConnection::setFlowControl
+    void setFlowControl(size_t highWaterMark, size_t lowWaterMark)
+    { pauseReadMark_ = highWaterMark; resumeReadMark_ = lowWaterMark; }
+
+    /**
+     * 设置接受连接的方式，需要在 start 之前设置
+     * 按 CPU 分配连接需要同时用 setThreadPlacement 把 subLoop 线程绑定到 CPU 上
+     */
+    void setAcceptStrategy(AcceptStrategy strategy, ReusePortSteering steering = kSteerByHash)
+    {
+        acceptStrategy_ = strategy;
+        steering_ = steering;
+    }
+
+    // 每次可读事件最多 accept 的连接数，需要在 start 之前设置
+    void setAcceptBatch(int batch) { acceptBatch_ = batch; }
+
+    /**
+     * 处理连接的 loop 的忙轮询时间，见 EventLoop::setBusyPoll，需要在 start 之前设置
+     * socketBusyPollUs 大于 0 时新连接设置 SO_BUSY_POLL
+     * 适合 subLoop 线程独占 CPU 的低延迟服务
+     */
+    void setBusyPoll(int spinUs, int socketBusyPollUs = 0)
+    {
+        busyPollUs_ = spinUs;
+        socketBusyPollUs_ = socketBusyPollUs;
+    }
+
+    // 所有 Acceptor 累计接受和因为 fd 用完拒绝的连接数，调用者定期读取可以得到接受速率
+    uint64_t acceptedConnections() const;
+    uint64_t rejectedConnections() const;
+
     // 开启服务器监听
     void start();
+
+    /**
+     * 优雅关闭，可以在任意线程调用，在 baseLoop 线程执行
+     * 关闭监听 socket 不再接受新连接，已有连接在各自的 loop 线程里 setDraining 并调用 drainCallback_，
+     * 没有设置时直接 shutdown，发完待发送的数据(包括 sendFile)后半关闭
+     * 所有连接关闭后，或者 timeoutSeconds 秒后强制关闭剩下的连接之后，在 baseLoop 线程调用 done，
+     * 通常在 done 中 quit baseLoop，subLoop 随 TcpServer 析构退出
+     */
+    void drain(double timeoutSeconds, const std::function<void()> &done);
+    // 连接开始 drain 时的回调，上层决定连接什么时候关闭，比如 HTTP 在两个请求之间关闭
+    void setDrainCallback(const DrainCallback &cb) { drainCallback_ = cb; }
+    bool draining() const { return draining_; }
+    size_t connectionCount() const;
+
+    /**
+     * 热重启，见 ListenerHandoff
+     * listenFds: 监听 socket 的 fd，在 baseLoop 线程调用
+     * adoptListenFds: 使用旧进程交过来的监听 socket，代替自己 bind 的 socket，需要在 start 之前设置
+     * kReusePortPerLoop 时按顺序轮流分给各个 subLoop，不够的自己创建；
+     * 否则第一个代替 baseLoop 的 Acceptor，其余的也在 baseLoop 上 accept。多出来的都不会关闭
+     */
+    std::vector<int> listenFds() const;
+    void adoptListenFds(const std::vector<int> &fds);
     
     EventLoop* getLoop() const { return loop_; }
 
@@ -56,33 +146,66 @@ public:
 
 private:
     void newConnection(int sockfd, const InetAddress &peerAddr);
+    // 在 ioLoop 上为 sockfd 建立 TcpConnection，kReusePortPerLoop 时由 ioLoop 自己的 Acceptor 调用
+    void newConnectionInLoop(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
+    void startLoopAcceptors();
     void removeConnection(const TcpConnectionPtr &conn);
-    void removeConnectionInLoop(const TcpConnectionPtr &conn);
+    void drainInLoop(double timeoutSeconds, const std::function<void()> &done);
+    void drainConnection(const TcpConnectionPtr &conn);
+    void forceCloseAll();
+    void acceptorClosed();
+    void finishDrain();
     void printThroughput() {std::cout<<"timer3"<<std::endl;};
 
     /**
      * key:     std::string
      * value:   std::shared_ptr<TcpConnection> 
      */
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    // 按 fd 索引的连接表，连接销毁前 fd 不会关闭，不会被新连接复用
+    using ConnectionMap = std::vector<TcpConnectionPtr>;
 
     
     EventLoop *loop_;                    // 用户定义的baseLoop
+    const InetAddress listenAddr_;
     const std::string ipPort_;           // 传入的IP地址和端口号
     const std::string name_;             // TcpServer名字
     std::unique_ptr<Acceptor> acceptor_; // Acceptor对象负责监视
     
     std::shared_ptr<EventLoopThreadPool> threadPool_; // 线程池
 
+    AcceptStrategy acceptStrategy_;
+    ReusePortSteering steering_;
+    /**
+     * kReusePortPerLoop 时每个 subLoop 的 Acceptor，第 i 个在 getAllLoops()[i % loop 数] 上
+     * 其他方式时是接管的多余的监听 socket，在 baseLoop 上
+     */
+    std::vector<std::unique_ptr<Acceptor>> loopAcceptors_;
+
     ConnectionCallback  connectionCallback_;        // 有新连接时的回调函数
     MessageCallback messageCallback_;               // 有读写消息时的回调函数
     WriteCompleteCallback writeCompleteCallback_;   // 消息发送完成以后的回调函数
 
     ThreadInitCallback threadInitCallback_;  // loop线程初始化的回调函数
+    DrainCallback drainCallback_;
     std::atomic_int started_;                // TcpServer
 
-    int nextConnId_;            // 连接索引
-    ConnectionMap connections_; // 保存所有的连接
+    int acceptBatch_;
+    std::atomic_int nextConnId_;    // 连接索引
+    const std::string connNamePrefix_;  // name_ + "-" + ipPort_ + "#"，后面接连接索引
+    bool edgeTriggered_;            // 新连接是否使用边缘触发
+    double idleTimeout_;
+    size_t pauseReadMark_;
+    size_t resumeReadMark_;
+    int busyPollUs_;
+    int socketBusyPollUs_;
+    std::vector<int> adoptedFds_;   // 从旧进程接管的监听 socket，startLoopAcceptors 使用后清空
+    std::atomic_bool draining_;
+    std::function<void()> drainDone_;   // 只在 baseLoop 线程访问
+    TimerId drainTimer_;
+    size_t closingAcceptors_;           // drain 时还没析构完的 loopAcceptors_，只在 baseLoop 线程访问
+    mutable std::mutex mutex_;      // kReusePortPerLoop 时各个 subLoop 会同时增删连接
+    ConnectionMap connections_;     // 保存所有的连接
+    size_t connectionCount_;
 
 };
 
@@ -0,0 +1,98 @@
+#include "TimeoutWheel.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logging.h"
+
+#include <math.h>
+#include <algorithm>
+
+TimeoutWheel::TimeoutWheel(EventLoop *loop, double granularity, int buckets)
+    : loop_(loop),
+      granularity_(granularity),
+      buckets_(buckets),
+      nextTick_(0),
+      size_(0),
+      running_(false),
+      evicted_(0)
+{
+}
+
+void TimeoutWheel::schedule(const TcpConnectionPtr &conn)
+{
+    Timestamp deadline = conn->timeoutDeadline();
+    if (!deadline.valid())
+    {
+        return;
+    }
+    // 已经有更早的条目，到时候再按最新的截止时间处理
+    if (conn->scheduledDeadline_.valid() && !(deadline < conn->scheduledDeadline_))
+    {
+        return;
+    }
+    if (!running_)
+    {
+        running_ = true;
+        lastTick_ = Timestamp::now();
+        timerId_ = loop_->runEvery(granularity_, std::bind(&TimeoutWheel::onTick, this));
+    }
+    insert(conn, deadline);
+}
+
+void TimeoutWheel::insert(const TcpConnectionPtr &conn, Timestamp deadline)
+{
+    // 放进截止时间之后的第一次检查对应的桶，太远的先放在最后一个桶
+    double wait = timeDifference(deadline, lastTick_) - granularity_;
+    uint64_t ahead = wait > 0 ? static_cast<uint64_t>(::ceil(wait / granularity_)) : 0;
+    ahead = std::min<uint64_t>(ahead, buckets_.size() - 1);
+    buckets_[(nextTick_ + ahead) % buckets_.size()].push_back(Entry{conn, deadline});
+    conn->scheduledDeadline_ = deadline;
+    ++size_;
+}
+
+void TimeoutWheel::onTick()
+{
+    Timestamp now = Timestamp::now();
+    lastTick_ = now;
+    checking_.swap(buckets_[nextTick_ % buckets_.size()]);
+    ++nextTick_;
+    size_ -= checking_.size();
+
+    for (const Entry &entry : checking_)
+    {
+        TcpConnectionPtr conn = entry.conn.lock();
+        if (!conn || !conn->connected() || !(conn->scheduledDeadline_ == entry.deadline))
+        {
+            continue;
+        }
+        conn->scheduledDeadline_ = Timestamp::invalid();
+        Timestamp deadline = conn->timeoutDeadline();
+        if (!deadline.valid())
+        {
+            continue;
+        }
+        if (!(now < deadline))
+        {
+            evicting_.push_back(conn);
+        }
+        else
+        {
+            insert(conn, deadline);
+        }
+    }
+    checking_.clear();
+
+    // 到期的连接一起关闭，关闭在 pendingFunctors 中执行，不影响本轮的检查
+    for (const TcpConnectionPtr &conn : evicting_)
+    {
+        LOG_INFO << "TimeoutWheel close timed out connection " << conn->name();
+        conn->forceClose();
+    }
+    evicted_ += static_cast<int64_t>(evicting_.size());
+    evicting_.clear();
+
+    if (size_ == 0)
+    {
+        running_ = false;
+        loop_->cancel(timerId_);
+    }
+}
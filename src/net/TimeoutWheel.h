@@ -0,0 +1,61 @@
+#ifndef TIMEOUT_WHEEL_H
+#define TIMEOUT_WHEEL_H
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "TimerId.h"
+#include "Callback.h"
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+class EventLoop;
+class TcpConnection;
+
+/**
+ * 连接超时检查，每个 EventLoop 一个，见 EventLoop::timeoutWheel
+ *
+ * 按截止时间把连接放进 granularity 秒一格的桶里，runEvery 每格检查一个桶，
+ * 这个桶里已经到期的连接一起关闭
+ * 连接收发数据只会推迟截止时间，这时不移动桶里的条目，检查到它时再按新的截止时间放进后面的桶；
+ * 只有截止时间提前(例如开始读请求头)才放入新的条目，旧条目检查时发现不是最新的就丢弃
+ * 没有连接需要检查时停止定时器
+ */
+class TimeoutWheel : noncopyable
+{
+public:
+    static const int kDefaultBuckets = 64;
+
+    TimeoutWheel(EventLoop *loop, double granularity = 1.0, int buckets = kDefaultBuckets);
+
+    // 按 conn->timeoutDeadline() 安排检查，只在 loop 线程调用
+    void schedule(const TcpConnectionPtr &conn);
+
+    // 因超时关闭的连接数
+    int64_t evictedCount() const { return evicted_; }
+
+private:
+    struct Entry
+    {
+        std::weak_ptr<TcpConnection> conn;
+        Timestamp deadline;     // 放入时的截止时间，和连接当前登记的不同说明条目已经过期
+    };
+
+    void insert(const TcpConnectionPtr &conn, Timestamp deadline);
+    void onTick();
+
+    EventLoop *loop_;
+    const double granularity_;
+    std::vector<std::vector<Entry>> buckets_;
+    uint64_t nextTick_;         // 下一次检查的桶的序号
+    Timestamp lastTick_;        // 上一次检查的时间
+    size_t size_;               // 所有桶中的条目数，包括过期的
+    bool running_;
+    TimerId timerId_;
+    std::vector<Entry> checking_;               // 正在检查的桶，复用避免分配
+    std::vector<TcpConnectionPtr> evicting_;    // 本轮要关闭的连接
+    int64_t evicted_;
+};
+
+#endif // TIMEOUT_WHEEL_H
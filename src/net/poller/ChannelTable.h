@@ -0,0 +1,73 @@
+#ifndef CHANNEL_TABLE_H
+#define CHANNEL_TABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <vector>
+
+class Channel;
+
+/**
+ * Poller 中 fd -> Channel* 的注册表
+ * fd 是内核从小到大分配的整数，直接用数组下标代替哈希表，查找、插入、删除都是 O(1)
+ * 每个槽位有一个代数，同一个 fd 每次重新注册加一
+ * 注册给内核的数据带上代数，事件返回时和当前代数比较，可以识别已经失效的旧注册产生的事件
+ */
+class ChannelTable
+{
+public:
+    ChannelTable() : count_(0) {}
+
+    Channel* find(int fd) const
+    {
+        return static_cast<size_t>(fd) < slots_.size() ? slots_[fd].channel : nullptr;
+    }
+
+    uint32_t generation(int fd) const
+    {
+        return static_cast<size_t>(fd) < slots_.size() ? slots_[fd].generation : 0;
+    }
+
+    // 返回这次注册的代数
+    uint32_t insert(int fd, Channel *channel)
+    {
+        const size_t need = static_cast<size_t>(fd) + 1;
+        if (need > slots_.size())
+        {
+            slots_.resize(std::max(need, slots_.size() * 2));
+        }
+        Slot &slot = slots_[fd];
+        if (slot.channel == nullptr)
+        {
+            ++count_;
+        }
+        slot.channel = channel;
+        return ++slot.generation;
+    }
+
+    void erase(int fd)
+    {
+        if (static_cast<size_t>(fd) < slots_.size() && slots_[fd].channel != nullptr)
+        {
+            slots_[fd].channel = nullptr;
+            --count_;
+        }
+    }
+
+    size_t size() const { return count_; }
+
+private:
+    struct Slot
+    {
+        Slot() : channel(nullptr), generation(0) {}
+
+        Channel *channel;
+        uint32_t generation;
+    };
+
+    std::vector<Slot> slots_;
+    size_t count_;
+};
+
+#endif // CHANNEL_TABLE_H
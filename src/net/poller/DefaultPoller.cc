@@ -1,17 +1,26 @@
 #include "Poller.h"
 #include "EPollPoller.h"
+#include "PollPoller.h"
+#include "IoUringPoller.h"
 
 #include <stdlib.h>
 // 获取默认的Poller实现方式
 Poller* Poller::newDefaultPoller(EventLoop *loop)
 {
+    if (::getenv("MUDUO_USE_IO_URING"))
+    {
+        if (IoUringPoller::available())
+        {
+            return new IoUringPoller(loop); // 生成io_uring实例
+        }
+        LOG_WARN << "io_uring is not available, use epoll instead";
+    }
     if (::getenv("MUDUO_USE_POLL"))
     {
-        return nullptr; // 生成poll实例
+        return new PollPoller(loop); // 生成poll实例
     }
     else
     {
         return new EPollPoller(loop); // 生成epoll实例
     }
 }
-
@@ -41,10 +41,13 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
             events_.resize(events_.size() * 2);
         }
     }
-    // 超时
+    // 超时，忙轮询时 0 超时的 poll 不记录
     else if (numEvents == 0)
     {
-        LOG_DEBUG << "timeout!";
+        if (timeoutMs != 0)
+        {
+            LOG_DEBUG << "timeout!";
+        }
     }
     // 出错
     else
@@ -72,14 +75,10 @@ void EPollPoller::updateChannel(Channel *channel)
     // 未添加状态和已删除状态都有可能会被再次添加到epoll中
     if (index == kNew || index == kDeleted)
     {
-        // 添加到键值对 
+        // 添加到注册表，fd 的代数加一
         if (index == kNew)
         {
-            int fd = channel->fd();
-            channels_[fd] = channel; 
-        }
-        else // index == kAdd
-        {
+            channels_.insert(channel->fd(), channel);
         }
         // 修改channel的状态，此时是已添加状态
         channel->set_index(kAdded);
@@ -103,13 +102,24 @@ void EPollPoller::updateChannel(Channel *channel)
     }
 }
 
-// 填写活跃的连接
+/**
+ * 填写活跃的连接
+ * 事件中是 fd 和注册时的代数，不是 Channel 指针，在注册表中查找当前的 channel
+ * fd 被 dup 或者 fork 给别的进程后，关闭时没有从 epoll 中删除的旧注册仍然会产生事件，
+ * 这时 fd 已经没有 channel 或者代数不同，丢弃这个事件，不会访问已经析构的 Channel
+ */
 void EPollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels) const
 {
     for (int i = 0; i < numEvents; ++i)
     {
-        // void* => Channel*
-        Channel *channel = static_cast<Channel*>(events_[i].data.ptr);
+        const int fd = static_cast<int>(static_cast<uint32_t>(events_[i].data.u64));
+        const uint32_t generation = static_cast<uint32_t>(events_[i].data.u64 >> 32);
+        Channel *channel = channels_.find(fd);
+        if (channel == nullptr || channels_.generation(fd) != generation)
+        {
+            LOG_DEBUG << "EPollPoller drop stale event fd=" << fd;
+            continue;
+        }
         channel->set_revents(events_[i].events);
         activeChannels->push_back(channel);
     }
@@ -117,10 +127,9 @@ void EPollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels)
 
 void EPollPoller::removeChannel(Channel *channel)
 {
-    // 从Map中删除
+    // 从注册表中删除
     int fd = channel->fd();
-    channels_.erase(fd); 
-
+    channels_.erase(fd);
 
     int index = channel->index();
     if (index == kAdded)
@@ -139,8 +148,8 @@ void EPollPoller::update(int operation, Channel *channel)
 
     int fd = channel->fd();
     event.events = channel->events();
-    event.data.fd = fd;
-    event.data.ptr = channel;
+    // 低 32 位是 fd，高 32 位是注册时的代数
+    event.data.u64 = (static_cast<uint64_t>(channels_.generation(fd)) << 32) | static_cast<uint32_t>(fd);
 
     if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
     {
@@ -0,0 +1,320 @@
+#include "IoUringPoller.h"
+#include "Logging.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <linux/io_uring.h>
+
+#include <algorithm>
+
+const int kNew = -1;    // 某个channel还没添加至Poller
+const int kAdded = 1;   // 某个channel已经添加至Poller
+const int kDeleted = 2; // 某个channel没有感兴趣的事件，暂时不在 io_uring 中
+
+namespace
+{
+
+// 优先使用 COOP_TASKRUN 减少内核打断用户线程，老内核不认识这个标志时去掉重试
+int setupRing(unsigned entries, unsigned cqEntries, io_uring_params *params)
+{
+    ::memset(params, 0, sizeof(*params));
+    params->flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+    params->cq_entries = cqEntries;
+    int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    if (fd < 0 && errno == EINVAL)
+    {
+        ::memset(params, 0, sizeof(*params));
+        params->flags = IORING_SETUP_CQSIZE;
+        params->cq_entries = cqEntries;
+        fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+    return fd;
+}
+
+} // namespace
+
+bool IoUringPoller::available()
+{
+    // 等待超时需要 IORING_ENTER_EXT_ARG(5.11)，seccomp 禁用 io_uring 时 setup 也会失败
+    static const bool kAvailable = [] {
+        io_uring_params params;
+        int fd = setupRing(4, 8, &params);
+        if (fd < 0)
+        {
+            return false;
+        }
+        ::close(fd);
+        return (params.features & IORING_FEAT_EXT_ARG) != 0;
+    }();
+    return kAvailable;
+}
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+    : Poller(loop),
+      multishot_(false),
+      sqeTail_(0),
+      generation_(0),
+      round_(0)
+{
+    io_uring_params params;
+    ringFd_ = setupRing(kSqEntries, kCqEntries, &params);
+    if (ringFd_ < 0)
+    {
+        LOG_FATAL << "io_uring_setup() error:" << errno;
+    }
+    // multishot poll 没有单独的特性位，和 IORING_FEAT_RSRC_TAGS 同在 5.13 加入
+    multishot_ = params.features & IORING_FEAT_RSRC_TAGS;
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+    {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ringFd_, IORING_OFF_SQ_RING);
+    cqRing_ = singleMmap ? sqRing_
+                         : ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                  ringFd_, IORING_OFF_CQ_RING);
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ringFd_, IORING_OFF_SQES);
+    if (sqRing_ == MAP_FAILED || cqRing_ == MAP_FAILED || sqes == MAP_FAILED)
+    {
+        LOG_FATAL << "io_uring mmap error:" << errno;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char *sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char *cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // SQE 按顺序使用，索引数组固定为 i -> i
+    for (unsigned i = 0; i < sqEntries_; ++i)
+    {
+        sqArray_[i] = i;
+    }
+    sqeTail_ = *sqTail_;
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    ::munmap(sqes_, sqesSize_);
+    if (cqRing_ != sqRing_)
+    {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    ::munmap(sqRing_, sqRingSize_);
+    ::close(ringFd_);
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+    // 把这一轮积累的注册修改一起提交，同时等待至少一个完成事件
+    unsigned pending = sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    int ret = enter(pending, 1, timeoutMs);
+    int saveErrno = errno;
+    Timestamp now(Timestamp::now());
+    if (ret < 0 && saveErrno != EINTR && saveErrno != ETIME && saveErrno != EBUSY)
+    {
+        errno = saveErrno;
+        LOG_ERROR << "IoUringPoller::poll() failed";
+    }
+
+    ++round_;
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    if (head == tail && timeoutMs != 0)
+    {
+        LOG_DEBUG << "timeout!";
+    }
+    for (; head != tail; ++head)
+    {
+        handleCompletion(cqes_[head & cqMask_], activeChannels);
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+    // 同一个 channel 可能有多个完成事件，合并后再交给 channel
+    for (Channel *channel : *activeChannels)
+    {
+        channel->set_revents(registrations_[channel->fd()].revents);
+    }
+    return now;
+}
+
+void IoUringPoller::handleCompletion(const io_uring_cqe &cqe, ChannelList *activeChannels)
+{
+    // userData 为 0 的是删除请求自己的完成事件
+    if (cqe.user_data == 0)
+    {
+        return;
+    }
+    const int fd = static_cast<int>(static_cast<uint32_t>(cqe.user_data));
+    auto it = registrations_.find(fd);
+    if (it == registrations_.end() || it->second.userData != cqe.user_data)
+    {
+        // 已经被删除或替换的请求
+        return;
+    }
+    Registration &reg = it->second;
+    Channel *channel = channels_.find(fd);
+    const bool more = cqe.flags & IORING_CQE_F_MORE;
+
+    int revents = cqe.res;
+    if (cqe.res < 0)
+    {
+        if (more)
+        {
+            return;
+        }
+        // 暂时性的错误重新提交，否则 channel 再也收不到事件
+        if (cqe.res == -EAGAIN || cqe.res == -EINTR || cqe.res == -ENOMEM)
+        {
+            arm(channel);
+            return;
+        }
+        // 其他错误当作连接出错交给 channel，TcpConnection 会在 handleClose 中关闭连接
+        LOG_ERROR << "io_uring poll fd=" << fd << " error:" << -cqe.res;
+        reg.userData = 0;
+        revents = EPOLLERR | EPOLLHUP;
+    }
+
+    if (reg.round != round_)
+    {
+        reg.round = round_;
+        reg.revents = revents;
+        activeChannels->push_back(channel);
+    }
+    else
+    {
+        reg.revents |= revents;
+    }
+    // poll 请求已经结束(oneshot 或者内核终止了 multishot)，重新提交
+    // 这时 channel 的回调还没有执行，SQE 到下一轮 poll 才提交，那时仍然就绪的 fd 会立即完成
+    if (!more && cqe.res >= 0)
+    {
+        arm(channel);
+    }
+}
+
+void IoUringPoller::updateChannel(Channel *channel)
+{
+    const int index = channel->index();
+    if (index == kNew || index == kDeleted)
+    {
+        if (index == kNew)
+        {
+            channels_.insert(channel->fd(), channel);
+        }
+        channel->set_index(kAdded);
+        if (!channel->isNoneEvent())
+        {
+            arm(channel);
+        }
+    }
+    else
+    {
+        // io_uring 的 poll 请求不能原地修改事件，删除旧请求再提交新的
+        cancel(channel->fd());
+        if (channel->isNoneEvent())
+        {
+            channel->set_index(kDeleted);
+        }
+        else
+        {
+            arm(channel);
+        }
+    }
+}
+
+void IoUringPoller::removeChannel(Channel *channel)
+{
+    int fd = channel->fd();
+    channels_.erase(fd);
+    if (channel->index() == kAdded)
+    {
+        cancel(fd);
+    }
+    registrations_.erase(fd);
+    channel->set_index(kNew);
+}
+
+io_uring_sqe* IoUringPoller::getSqe()
+{
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (sqeTail_ - head >= sqEntries_)
+    {
+        // 提交队列满了，先提交一批，不等待完成事件
+        enter(sqeTail_ - head, 0, 0);
+    }
+    io_uring_sqe *sqe = &sqes_[sqeTail_ & sqMask_];
+    ++sqeTail_;
+    ::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+void IoUringPoller::arm(Channel *channel)
+{
+    const int fd = channel->fd();
+    if (++generation_ == 0)
+    {
+        ++generation_;
+    }
+    Registration &reg = registrations_[fd];
+    reg.userData = (static_cast<uint64_t>(generation_) << 32) | static_cast<uint32_t>(fd);
+
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = static_cast<uint32_t>(channel->events()) & ~static_cast<uint32_t>(EPOLLET);
+    sqe->len = channel->isEdgeTriggered() ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = reg.userData;
+}
+
+void IoUringPoller::cancel(int fd)
+{
+    auto it = registrations_.find(fd);
+    if (it == registrations_.end() || it->second.userData == 0)
+    {
+        return;
+    }
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = it->second.userData;
+    sqe->user_data = 0;
+    it->second.userData = 0;
+}
+
+int IoUringPoller::enter(unsigned toSubmit, unsigned minComplete, int timeoutMs)
+{
+    __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+
+    __kernel_timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+    io_uring_getevents_arg arg;
+    ::memset(&arg, 0, sizeof(arg));
+    arg.ts = timeoutMs >= 0 ? reinterpret_cast<uint64_t>(&ts) : 0;
+
+    unsigned flags = IORING_ENTER_EXT_ARG;
+    if (minComplete > 0)
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+    return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd_, toSubmit, minComplete, flags,
+                                      &arg, sizeof(arg)));
+}
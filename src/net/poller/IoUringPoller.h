@@ -0,0 +1,87 @@
+#ifndef IOURINGPOLLER_H
+#define IOURINGPOLLER_H
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+#include "Poller.h"
+#include "Timestamp.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/**
+ * io_uring 实现，设置环境变量 MUDUO_USE_IO_URING 时使用，内核不支持时退回 epoll
+ *
+ * 每个 Channel 对应一个 IORING_OP_POLL_ADD 请求，完成事件里的 poll 掩码
+ * 就是 Channel 的 revents，所以上层的 Channel 回调不需要改动
+ * io_uring 的 poll 本身是边缘触发的:
+ *   水平触发的 Channel 用 oneshot 请求，每次完成后重新提交，提交时内核会重新检查就绪状态
+ *   边缘触发的 Channel 用 multishot 请求，一直有效，不需要重新提交
+ * 注册、修改、删除和重新提交只往提交队列里放 SQE，不产生系统调用，
+ * 一轮循环里所有的提交和等待事件合并成一次 io_uring_enter
+ */
+class IoUringPoller : public Poller
+{
+public:
+    IoUringPoller(EventLoop *loop);
+    ~IoUringPoller() override;
+
+    // 当前内核能否使用，只检测一次
+    static bool available();
+
+    Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+    void updateChannel(Channel *channel) override;
+    void removeChannel(Channel *channel) override;
+    bool supportsEdgeTriggered() const override { return multishot_; }
+
+private:
+    static const unsigned kSqEntries = 1024;
+    static const unsigned kCqEntries = 8192;
+
+    /**
+     * 一个 fd 当前有效的 poll 请求
+     * userData 高 32 位是代数，低 32 位是 fd；被删除或替换的请求留下的完成事件代数不匹配，直接丢弃
+     */
+    struct Registration
+    {
+        uint64_t userData;
+        int revents;        // 本轮收到的事件
+        unsigned round;     // 最近一次加入 activeChannels 的轮次
+    };
+
+    io_uring_sqe* getSqe();
+    void arm(Channel *channel);
+    void cancel(int fd);
+    int enter(unsigned toSubmit, unsigned minComplete, int timeoutMs);
+    void handleCompletion(const io_uring_cqe &cqe, ChannelList *activeChannels);
+
+    int ringFd_;
+    bool multishot_;        // 内核是否支持 multishot poll(5.13)
+
+    // mmap 出来的提交队列和完成队列
+    void *sqRing_;
+    size_t sqRingSize_;
+    void *cqRing_;
+    size_t cqRingSize_;
+    io_uring_sqe *sqes_;
+    size_t sqesSize_;
+
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    unsigned *sqArray_;
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned cqMask_;
+    io_uring_cqe *cqes_;
+
+    unsigned sqeTail_;      // 已填写的 SQE 位置，提交时写回 *sqTail_
+    uint32_t generation_;
+    unsigned round_;
+    std::unordered_map<int, Registration> registrations_;
+};
+
+#endif // IOURINGPOLLER_H
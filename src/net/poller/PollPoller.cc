@@ -0,0 +1,99 @@
+#include "PollPoller.h"
+#include "Logging.h"
+
+#include <errno.h>
+#include <algorithm>
+
+PollPoller::PollPoller(EventLoop *loop)
+    : Poller(loop)
+{
+}
+
+PollPoller::~PollPoller() = default;
+
+Timestamp PollPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+    int numEvents = ::poll(pollfds_.data(), pollfds_.size(), timeoutMs);
+    int saveErrno = errno;
+    Timestamp now(Timestamp::now());
+    if (numEvents > 0)
+    {
+        fillActiveChannels(numEvents, activeChannels);
+    }
+    else if (numEvents == 0)
+    {
+        if (timeoutMs != 0)
+        {
+            LOG_DEBUG << "timeout!";
+        }
+    }
+    else if (saveErrno != EINTR)
+    {
+        errno = saveErrno;
+        LOG_ERROR << "PollPoller::poll() failed";
+    }
+    return now;
+}
+
+void PollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels) const
+{
+    for (auto pfd = pollfds_.begin(); pfd != pollfds_.end() && numEvents > 0; ++pfd)
+    {
+        if (pfd->revents > 0)
+        {
+            --numEvents;
+            Channel *channel = channels_.find(pfd->fd);
+            // POLLIN/POLLOUT 等和 EPOLLIN/EPOLLOUT 的取值相同，Channel 可以直接使用
+            channel->set_revents(pfd->revents);
+            activeChannels->push_back(channel);
+        }
+    }
+}
+
+/**
+ * 新的 channel 加到 pollfds_ 末尾
+ * 没有感兴趣事件的 channel 把 fd 设为 -fd-1，poll 会忽略它，之后还能恢复
+ */
+void PollPoller::updateChannel(Channel *channel)
+{
+    if (channel->index() < 0)
+    {
+        struct pollfd pfd;
+        pfd.fd = channel->fd();
+        pfd.events = static_cast<short>(channel->events());
+        pfd.revents = 0;
+        pollfds_.push_back(pfd);
+        channel->set_index(static_cast<int>(pollfds_.size()) - 1);
+        channels_.insert(pfd.fd, channel);
+    }
+    else
+    {
+        struct pollfd &pfd = pollfds_[channel->index()];
+        pfd.fd = channel->isNoneEvent() ? -channel->fd() - 1 : channel->fd();
+        pfd.events = static_cast<short>(channel->events());
+        pfd.revents = 0;
+    }
+}
+
+// 和最后一个元素交换后删除，O(1)
+void PollPoller::removeChannel(Channel *channel)
+{
+    int idx = channel->index();
+    if (idx < 0)
+    {
+        return;
+    }
+    channels_.erase(channel->fd());
+    if (static_cast<size_t>(idx) != pollfds_.size() - 1)
+    {
+        int backFd = pollfds_.back().fd;
+        std::iter_swap(pollfds_.begin() + idx, pollfds_.end() - 1);
+        if (backFd < 0)
+        {
+            backFd = -backFd - 1;
+        }
+        channels_.find(backFd)->set_index(idx);
+    }
+    pollfds_.pop_back();
+    channel->set_index(-1);
+}
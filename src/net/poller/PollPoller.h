@@ -0,0 +1,32 @@
+#ifndef POLLPOLLER_H
+#define POLLPOLLER_H
+
+#include <vector>
+#include <poll.h>
+
+#include "Poller.h"
+#include "Timestamp.h"
+
+/**
+ * poll(2) 实现，设置环境变量 MUDUO_USE_POLL 时使用
+ * pollfds_ 和 Channel 一一对应，Channel::index() 是它在 pollfds_ 中的下标
+ * 不支持边缘触发，Channel 会退回水平触发
+ */
+class PollPoller : public Poller
+{
+public:
+    PollPoller(EventLoop *loop);
+    ~PollPoller() override;
+
+    Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+    void updateChannel(Channel *channel) override;
+    void removeChannel(Channel *channel) override;
+
+private:
+    void fillActiveChannels(int numEvents, ChannelList *activeChannels) const;
+
+    using PollFdList = std::vector<struct pollfd>;
+    PollFdList pollfds_;
+};
+
+#endif // POLLPOLLER_H
@@ -4,9 +4,9 @@
 #include "noncopyable.h"
 #include "Channel.h"
 #include "Timestamp.h"
+#include "ChannelTable.h"
 
 #include <vector>
-#include <unordered_map>
 
 
 // muduo库中多路事件分发器的核心IO复用模块
@@ -26,6 +26,9 @@ public:
     // 判断 channel是否注册到 poller当中
     bool hasChannel(Channel *channel) const;
 
+    // 是否支持边缘触发(EPOLLET)，只有 epoll 支持
+    virtual bool supportsEdgeTriggered() const { return false; }
+
     // EventLoop可以通过该接口获取默认的IO复用实现方式(默认epoll)
     /** 
      * 它的实现并不在 Poller.cc 文件中
@@ -36,9 +39,8 @@ public:
     static Poller* newDefaultPoller(EventLoop *Loop);
 
 protected:  
-    using ChannelMap = std::unordered_map<int, Channel*>;
-    // 储存 channel 的映射，（sockfd -> channel*）
-    ChannelMap channels_;
+    // 储存 channel 的映射，（sockfd -> channel*），按 fd 索引的数组
+    ChannelTable channels_;
     
 private:
     EventLoop *ownerLoop_; // 定义Poller所属的事件循环EventLoop
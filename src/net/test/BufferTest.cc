@@ -0,0 +1,215 @@
+#include "Buffer.h"
+#include "BufferAllocator.h"
+#include "ChainBuffer.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string>
+#include <thread>
+
+void testLazyAllocation()
+{
+    Buffer buf;
+    assert(buf.internalCapacity() == 0);
+    assert(buf.readableBytes() == 0);
+    assert(buf.writableBytes() == 0);
+    assert(buf.retrieveAllAsString().empty());
+
+    buf.append("hello", 5);
+    assert(buf.internalCapacity() == Buffer::kInitialSize);
+    assert(buf.retrieveAllAsString() == "hello");
+
+    // 没有分配内存时 prepend 也可以用
+    Buffer head(0);
+    int32_t len = 42;
+    head.prepend(&len, sizeof len);
+    assert(head.readableBytes() == sizeof len);
+}
+
+void testGrowAndShrink()
+{
+    Buffer buf;
+    std::string data;
+    for (int i = 0; i < 300000; ++i)
+    {
+        data.push_back(static_cast<char>('a' + i % 26));
+    }
+    for (size_t i = 0; i < data.size(); i += 1000)
+    {
+        buf.append(data.data() + i, std::min<size_t>(1000, data.size() - i));
+    }
+    assert(buf.readableBytes() == data.size());
+    assert(std::string(buf.peek(), buf.readableBytes()) == data);
+    assert(buf.internalCapacity() >= data.size());
+
+    // 剩下少量数据时缩小到刚好能放下的档位
+    buf.retrieve(data.size() - 100);
+    buf.shrink(0);
+    assert(buf.internalCapacity() == BufferAllocator::kMinBlock);
+    assert(std::string(buf.peek(), buf.readableBytes()) == data.substr(data.size() - 100));
+
+    buf.retrieveAll();
+    buf.shrink(0);
+    assert(buf.internalCapacity() == 0);
+    buf.append("x", 1);
+    assert(buf.retrieveAllAsString() == "x");
+}
+
+void testCopyAndSwap()
+{
+    Buffer a;
+    a.append("abc", 3);
+    Buffer b(a);
+    Buffer c;
+    c = a;
+    a.retrieveAll();
+    assert(b.retrieveAllAsString() == "abc");
+    assert(c.readableBytes() == 3);
+
+    Buffer empty(0);
+    empty.swap(c);
+    assert(empty.retrieveAllAsString() == "abc");
+    assert(c.readableBytes() == 0 && c.internalCapacity() == 0);
+}
+
+void testThreadCache()
+{
+    // 同一档位释放后再分配拿到的是同一块内存
+    size_t capacity = 0;
+    char *block = BufferAllocator::allocate(3000, &capacity);
+    assert(capacity == 4096);
+    size_t cached = BufferAllocator::threadCachedBytes();
+    BufferAllocator::deallocate(block, capacity);
+    assert(BufferAllocator::threadCachedBytes() == cached + capacity);
+    size_t again = 0;
+    assert(BufferAllocator::allocate(4000, &again) == block);
+    assert(again == capacity);
+    BufferAllocator::deallocate(block, again);
+
+    // 别的线程分配的内存可以在这个线程释放
+    char *remote = nullptr;
+    std::thread t([&remote, &capacity]() { remote = BufferAllocator::allocate(1000, &capacity); });
+    t.join();
+    BufferAllocator::deallocate(remote, capacity);
+
+    // 超过档位的内存不缓存
+    char *large = BufferAllocator::allocate(BufferAllocator::kMaxBlock + 1, &capacity);
+    assert(capacity > BufferAllocator::kMaxBlock);
+    cached = BufferAllocator::threadCachedBytes();
+    BufferAllocator::deallocate(large, capacity);
+    assert(BufferAllocator::threadCachedBytes() == cached);
+}
+
+void testReadFd()
+{
+    int fds[2];
+    assert(::pipe(fds) == 0);
+    ::fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    ::fcntl(fds[1], F_SETPIPE_SZ, 1024 * 1024);
+    std::string data(100000, 'r');
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<char>(i % 251);
+    }
+    assert(::write(fds[1], data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+
+    // 空的 Buffer 先读到线程的读缓冲区，再按读到的长度分配
+    Buffer buf;
+    int savedErrno = 0;
+    std::string got;
+    while (got.size() < data.size())
+    {
+        ssize_t n = buf.readFd(fds[0], &savedErrno);
+        assert(n > 0);
+        got += buf.retrieveAllAsString();
+    }
+    assert(got == data);
+
+    // 已经有数据时读到的数据接在后面
+    buf.append("head", 4);
+    assert(::write(fds[1], "tail", 4) == 4);
+    assert(buf.readFd(fds[0], &savedErrno) == 4);
+    assert(buf.retrieveAllAsString() == "headtail");
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+void testChainBuffer()
+{
+    ChainBuffer chain;
+    std::string data;
+    for (int i = 0; i < 100000; ++i)
+    {
+        data.push_back(static_cast<char>(i % 251));
+    }
+    for (size_t i = 0; i < data.size(); i += 777)
+    {
+        chain.append(data.data() + i, std::min<size_t>(777, data.size() - i));
+    }
+    assert(chain.readableBytes() == data.size());
+    assert(chain.contiguousBytes() == ChainBuffer::kBlockSize);
+
+    struct iovec vec[16];
+    int iovcnt = chain.fillIovec(vec, 16);
+    assert(iovcnt == static_cast<int>((data.size() + ChainBuffer::kBlockSize - 1) / ChainBuffer::kBlockSize));
+
+    // 跨块的前缀搬到一块中
+    chain.retrieve(ChainBuffer::kBlockSize - 10);
+    const char *view = chain.linearize(100);
+    assert(std::string(view, 100) == data.substr(ChainBuffer::kBlockSize - 10, 100));
+    assert(chain.contiguousBytes() >= 100);
+    assert(chain.readableBytes() == data.size() - ChainBuffer::kBlockSize + 10);
+
+    std::string rest = chain.retrieveAllAsString();
+    assert(rest == data.substr(ChainBuffer::kBlockSize - 10));
+    assert(chain.empty() && chain.peek() == nullptr);
+}
+
+void testChainBufferFd()
+{
+    int fds[2];
+    assert(::pipe(fds) == 0);
+    ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    ::fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    ::fcntl(fds[1], F_SETPIPE_SZ, 1024 * 1024);
+
+    // 写出时跨块 writev，读入时 readv 进多个块
+    ChainBuffer out;
+    std::string data(200000, 'w');
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<char>(i % 253);
+    }
+    out.append(data);
+    int savedErrno = 0;
+    while (!out.empty())
+    {
+        assert(out.writeFd(fds[1], &savedErrno) > 0);
+    }
+
+    ChainBuffer in;
+    while (in.readableBytes() < data.size())
+    {
+        assert(in.readFd(fds[0], &savedErrno) > 0);
+    }
+    assert(in.readFd(fds[0], &savedErrno) < 0 && savedErrno == EAGAIN);
+    assert(in.retrieveAllAsString() == data);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+int main()
+{
+    testLazyAllocation();
+    testGrowAndShrink();
+    testCopyAndSwap();
+    testThreadCache();
+    testReadFd();
+    testChainBuffer();
+    testChainBufferFd();
+    printf("BufferTest passed\n");
+    return 0;
+}
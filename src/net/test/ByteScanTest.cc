@@ -0,0 +1,117 @@
+#include "ByteScan.h"
+#include "Timestamp.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// 参考实现
+const char* refFind(const char *begin, const char *end, const char *needle, size_t len)
+{
+    return std::search(begin, end, needle, needle + len);
+}
+
+std::vector<const char*> refLines(const char *begin, const char *end, size_t maxLines)
+{
+    std::vector<const char*> lines;
+    const char *lineStart = begin;
+    while (lines.size() < maxLines)
+    {
+        const char *crlf = refFind(lineStart, end, "\r\n", 2);
+        if (crlf == end)
+            break;
+        lines.push_back(crlf);
+        if (crlf == lineStart)
+            break;
+        lineStart = crlf + 2;
+    }
+    return lines;
+}
+
+// 由 '\r' '\n' '-' 'a' 组成的随机数据，容易出现各种边界情况
+std::string randomData(size_t len)
+{
+    static const char kAlphabet[] = "\r\n-a:";
+    std::string data(len, 'a');
+    for (size_t i = 0; i < len; ++i)
+    {
+        data[i] = kAlphabet[rand() % 5];
+    }
+    return data;
+}
+
+void testLevel(ByteScan::Level level)
+{
+    if (!ByteScan::setLevel(level))
+    {
+        printf("%s not supported\n", ByteScan::levelName(level));
+        return;
+    }
+    for (int round = 0; round < 20000; ++round)
+    {
+        std::string data = randomData(rand() % 200);
+        const char *begin = data.data();
+        const char *end = begin + data.size();
+
+        assert(ByteScan::findCRLF(begin, end) == refFind(begin, end, "\r\n", 2));
+        assert(ByteScan::findDoubleCRLF(begin, end) == refFind(begin, end, "\r\n\r\n", 4));
+        assert(ByteScan::findByte(begin, end, ':') == std::find(begin, end, ':'));
+
+        std::string needle = "\r\n--" + randomData(rand() % 6);
+        assert(ByteScan::find(begin, end, needle.data(), needle.size()) ==
+               refFind(begin, end, needle.data(), needle.size()));
+        assert(ByteScan::find(begin, end, "-", 1) == refFind(begin, end, "-", 1));
+
+        const char *lines[8];
+        size_t maxLines = 1 + rand() % 8;
+        size_t n = ByteScan::findLines(begin, end, lines, maxLines);
+        std::vector<const char*> expect = refLines(begin, end, maxLines);
+        assert(n == expect.size());
+        assert(std::equal(expect.begin(), expect.end(), lines));
+    }
+    printf("%s ok\n", ByteScan::levelName(level));
+}
+
+// 典型的请求首部块，比较各实现找出所有行的耗时
+void benchmark()
+{
+    std::string head = "GET /index.html HTTP/1.1\r\n"
+                       "Host: www.example.com\r\n"
+                       "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 Chrome/120.0\r\n"
+                       "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+                       "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+                       "Accept-Encoding: gzip, deflate, br\r\n"
+                       "Connection: keep-alive\r\n"
+                       "Cookie: session=0123456789abcdef0123456789abcdef\r\n\r\n";
+    const ByteScan::Level levels[] = { ByteScan::kScalar, ByteScan::kSse2, ByteScan::kAvx2 };
+    for (ByteScan::Level level : levels)
+    {
+        if (!ByteScan::setLevel(level))
+            continue;
+        const int kLoops = 1000000;
+        const char *lines[64];
+        size_t total = 0;
+        Timestamp start = Timestamp::now();
+        for (int i = 0; i < kLoops; ++i)
+        {
+            total += ByteScan::findLines(head.data(), head.data() + head.size(), lines, 64);
+        }
+        double seconds = timeDifference(Timestamp::now(), start);
+        printf("%-6s findLines %.1f ns/head (%zu)\n", ByteScan::levelName(level), seconds * 1e9 / kLoops, total);
+    }
+}
+
+int main()
+{
+    printf("default level: %s\n", ByteScan::levelName(ByteScan::level()));
+    assert(ByteScan::level() != ByteScan::kSse2);
+    testLevel(ByteScan::kScalar);
+    testLevel(ByteScan::kSse2);
+    testLevel(ByteScan::kAvx2);
+    benchmark();
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "ChannelTable.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Timestamp.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+void testTable()
+{
+    ChannelTable table;
+    Channel *a = reinterpret_cast<Channel*>(0x10);
+    Channel *b = reinterpret_cast<Channel*>(0x20);
+    assert(table.find(0) == nullptr && table.find(100) == nullptr);
+
+    assert(table.insert(5, a) == 1);
+    assert(table.find(5) == a && table.size() == 1);
+    assert(table.find(4) == nullptr);
+
+    // 同一个 fd 重新注册，代数加一
+    table.erase(5);
+    assert(table.find(5) == nullptr && table.size() == 0);
+    assert(table.generation(5) == 1);
+    assert(table.insert(5, b) == 2);
+    assert(table.find(5) == b && table.generation(5) == 2);
+
+    table.insert(1000, a);
+    assert(table.find(1000) == a && table.find(5) == b && table.size() == 2);
+    table.erase(1000);
+    table.erase(1000);
+    table.erase(5000);
+    assert(table.size() == 1);
+}
+
+/**
+ * 旧 fd 被 dup 过，关闭时 epoll 中的注册没有删除
+ * 新连接拿到同一个 fd，旧注册的事件不能分发给新的 channel
+ */
+void testStaleEvent()
+{
+    EventLoop loop;
+    int oldPipe[2];
+    assert(::pipe(oldPipe) == 0);
+    int keep = ::dup(oldPipe[0]);
+
+    Channel oldChannel(&loop, oldPipe[0]);
+    oldChannel.enableReading();
+    ::close(oldPipe[0]);
+    // fd 已经关闭，EPOLL_CTL_DEL 失败，旧注册留在 epoll 中
+    oldChannel.disableAll();
+    oldChannel.remove();
+
+    int newPipe[2];
+    assert(::pipe(newPipe) == 0);
+    assert(newPipe[0] == oldPipe[0]);
+    int reads = 0;
+    Channel newChannel(&loop, newPipe[0]);
+    newChannel.setReadCallback([&reads, &newPipe](Timestamp) {
+        char buf[16];
+        ::read(newPipe[0], buf, sizeof buf);
+        ++reads;
+    });
+    newChannel.enableReading();
+
+    assert(::write(oldPipe[1], "x", 1) == 1);
+    loop.runAfter(0.05, [&loop]() { loop.quit(); });
+    loop.loop();
+    assert(reads == 0);
+
+    assert(::write(newPipe[1], "y", 1) == 1);
+    loop.runAfter(0.05, [&loop]() { loop.quit(); });
+    loop.loop();
+    assert(reads == 1);
+
+    newChannel.disableAll();
+    newChannel.remove();
+    ::close(keep);
+    ::close(oldPipe[1]);
+    ::close(newPipe[0]);
+    ::close(newPipe[1]);
+}
+
+// 按连接数对比 unordered_map 和数组的注册、查找、删除
+void benchmark(int connections)
+{
+    const int kLookups = 20;
+    std::vector<Channel*> channels(connections);
+    for (int i = 0; i < connections; ++i)
+    {
+        channels[i] = reinterpret_cast<Channel*>(static_cast<uintptr_t>(i + 1) * 64);
+    }
+
+    size_t hits = 0;
+    Timestamp start = Timestamp::now();
+    {
+        std::unordered_map<int, Channel*> map;
+        for (int fd = 0; fd < connections; ++fd)
+        {
+            map[fd] = channels[fd];
+        }
+        for (int round = 0; round < kLookups; ++round)
+        {
+            for (int fd = 0; fd < connections; ++fd)
+            {
+                hits += map.find(fd)->second == channels[fd];
+            }
+        }
+        for (int fd = 0; fd < connections; ++fd)
+        {
+            map.erase(fd);
+        }
+    }
+    Timestamp middle = Timestamp::now();
+    {
+        ChannelTable table;
+        for (int fd = 0; fd < connections; ++fd)
+        {
+            table.insert(fd, channels[fd]);
+        }
+        for (int round = 0; round < kLookups; ++round)
+        {
+            for (int fd = 0; fd < connections; ++fd)
+            {
+                hits += table.find(fd) == channels[fd];
+            }
+        }
+        for (int fd = 0; fd < connections; ++fd)
+        {
+            table.erase(fd);
+        }
+    }
+    Timestamp end = Timestamp::now();
+    assert(hits == static_cast<size_t>(connections) * kLookups * 2);
+
+    double ops = static_cast<double>(connections) * (kLookups + 2);
+    double mapNs = (middle.microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) * 1000.0 / ops;
+    double tableNs = (end.microSecondsSinceEpoch() - middle.microSecondsSinceEpoch()) * 1000.0 / ops;
+    printf("connections=%d unordered_map=%.2fns/op ChannelTable=%.2fns/op\n", connections, mapNs, tableNs);
+}
+
+int main()
+{
+    testTable();
+    testStaleEvent();
+    benchmark(10000);
+    benchmark(100000);
+    benchmark(500000);
+    printf("ChannelTableTest passed\n");
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "EventLoopThreadPool.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "TcpServer.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+const uint16_t kPort = 19530;
+const int kLoops = 4;
+
+/**
+ * 负载都相同时(比如同一批 accept 的连接，或者只选择不计数)轮流选择，不会总是第一个 loop
+ */
+void testTies(EventLoopThreadPool::BalancePolicy policy)
+{
+    EventLoop baseLoop;
+    EventLoopThreadPool pool(&baseLoop, "ties");
+    pool.setThreadNum(kLoops);
+    pool.setBalancePolicy(policy);
+    pool.start();
+
+    std::map<EventLoop*, int> chosen;
+    for (int i = 0; i < kLoops * 5; ++i)
+    {
+        ++chosen[pool.getLoopForPeer(InetAddress())];
+    }
+    assert(chosen.size() == static_cast<size_t>(kLoops));
+    for (auto &item : chosen)
+    {
+        assert(item.second == 5);
+    }
+}
+
+/**
+ * 一批连接连续选择 loop，每次选中后立即计数(和 TcpServer 一样)，最后每个 loop 分到的一样多
+ * 其中一个 loop 上已有连接时，先补齐其他 loop
+ */
+void testBatch()
+{
+    EventLoop baseLoop;
+    EventLoopThreadPool pool(&baseLoop, "batch");
+    pool.setThreadNum(kLoops);
+    pool.setBalancePolicy(EventLoopThreadPool::kLeastConnections);
+    pool.start();
+
+    std::vector<EventLoop*> loops = pool.getAllLoops();
+    loops[1]->addConnections(3);
+    for (int i = 0; i < 3 * (kLoops - 1); ++i)
+    {
+        EventLoop *loop = pool.getLoopForPeer(InetAddress());
+        assert(loop != loops[1]);
+        loop->addConnections(1);
+    }
+    for (int i = 0; i < kLoops * 100; ++i)
+    {
+        pool.getLoopForPeer(InetAddress())->addConnections(1);
+    }
+    for (EventLoop *loop : loops)
+    {
+        assert(loop->connectionCount() == 103);
+        loop->addConnections(-103);
+    }
+}
+
+/**
+ * 按对端 IP 哈希时，同一网段(第一段相同)的地址也大致平均分到各个 loop
+ * 同一个 IP 总是选中同一个 loop
+ */
+void testPeerHash()
+{
+    EventLoop baseLoop;
+    EventLoopThreadPool pool(&baseLoop, "hash");
+    pool.setThreadNum(kLoops);
+    pool.setBalancePolicy(EventLoopThreadPool::kPeerHash);
+    pool.start();
+
+    const int kPeers = 1 << 16;
+    std::map<EventLoop*, int> chosen;
+    for (int i = 0; i < kPeers; ++i)
+    {
+        sockaddr_in addr;
+        ::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl((10u << 24) | static_cast<uint32_t>(i));
+        EventLoop *loop = pool.getLoopForPeer(InetAddress(addr));
+        assert(pool.getLoopForPeer(InetAddress(addr)) == loop);
+        ++chosen[loop];
+    }
+    assert(chosen.size() == static_cast<size_t>(kLoops));
+    for (auto &item : chosen)
+    {
+        // 每个 loop 分到的数量和平均值相差不超过 10%
+        int average = kPeers / kLoops;
+        assert(item.second > average * 9 / 10 && item.second < average * 11 / 10);
+    }
+}
+
+/**
+ * baseLoop 开始运行前连接已经在 accept 队列里，一次可读事件 accept 整批连接
+ * 按连接数选择时仍然平均分到各个 subLoop
+ */
+void testServer()
+{
+    const int kClients = kLoops * 10;
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "spread");
+    server.setThreadNum(kLoops);
+    server.setBalancePolicy(EventLoopThreadPool::kLeastConnections);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    std::mutex mutex;
+    std::vector<EventLoop*> ioLoops;
+    server.setThreadInitCallback([&](EventLoop *ioLoop) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ioLoops.push_back(ioLoop);
+    });
+    server.start();
+
+    std::vector<int> clients;
+    for (int i = 0; i < kClients; ++i)
+    {
+        int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        ::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(kPort);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        assert(::connect(sockfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+        clients.push_back(sockfd);
+    }
+
+    std::vector<int> counts;
+    loop.runAfter(0.5, [&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (EventLoop *ioLoop : ioLoops)
+        {
+            counts.push_back(ioLoop->connectionCount());
+        }
+        loop.quit();
+    });
+    loop.loop();
+    assert(counts == std::vector<int>(kLoops, kClients / kLoops));
+    for (int sockfd : clients)
+    {
+        ::close(sockfd);
+    }
+}
+
+int main()
+{
+    testTies(EventLoopThreadPool::kLeastConnections);
+    testTies(EventLoopThreadPool::kLeastPendingBytes);
+    testBatch();
+    testPeerHash();
+    testServer();
+    printf("EventLoopThreadPoolTest passed\n");
+    return 0;
+}
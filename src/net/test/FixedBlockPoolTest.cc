@@ -0,0 +1,175 @@
+#include "FixedBlockPool.h"
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "Logging.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Object
+{
+    explicit Object(int v) : value(v), name(std::to_string(v)) { ++alive; }
+    ~Object() { --alive; }
+
+    int value;
+    std::string name;
+    static int alive;
+};
+
+int Object::alive = 0;
+
+void testBlocks()
+{
+    FixedBlockPool pool;
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < FixedBlockPool::kBlocksPerChunk + 1; ++i)
+    {
+        blocks.push_back(pool.allocate(40));
+    }
+    assert(pool.blockSize() == 48);
+    assert(pool.chunkCount() == 2);
+    assert(pool.freeBlocks() == FixedBlockPool::kBlocksPerChunk - 1);
+
+    // 释放后再分配复用同一块
+    void *last = blocks.back();
+    pool.deallocate(last, 40);
+    assert(pool.allocate(40) == last);
+
+    // 大小不同的请求不进池
+    void *other = pool.allocate(100);
+    pool.deallocate(other, 100);
+    assert(pool.freeBlocks() == FixedBlockPool::kBlocksPerChunk - 1);
+
+    for (void *block : blocks)
+    {
+        pool.deallocate(block, 40);
+    }
+    assert(pool.freeBlocks() == FixedBlockPool::kBlocksPerChunk * 2);
+    assert(pool.chunkCount() == 2);
+}
+
+/**
+ * makePooled 的对象和控制块分别从两个池分配
+ * 对象释放后块马上复用，剩下的 weak_ptr 只占着控制块
+ */
+void testMakePooled()
+{
+    std::shared_ptr<FixedBlockPool> pool = std::make_shared<FixedBlockPool>();
+    std::shared_ptr<FixedBlockPool> controlPool = std::make_shared<FixedBlockPool>();
+    std::vector<std::weak_ptr<Object>> weaks;
+    for (int i = 0; i < 1000; ++i)
+    {
+        std::shared_ptr<Object> object = makePooled<Object>(pool, controlPool, i);
+        assert(object->value == i);
+        weaks.push_back(object);
+    }
+    assert(Object::alive == 0);
+    assert(pool->chunkCount() == 1);
+    assert(weaks[0].expired());
+    const size_t controlBlocks = controlPool->chunkCount() * FixedBlockPool::kBlocksPerChunk;
+    assert(controlPool->freeBlocks() == controlBlocks - 1000);
+    weaks.clear();
+    assert(controlPool->freeBlocks() == controlBlocks);
+
+    // 控制块在多轮之间复用同一批块
+    for (int round = 0; round < 3; ++round)
+    {
+        std::vector<std::shared_ptr<Object>> objects;
+        for (int i = 0; i < 100; ++i)
+        {
+            objects.push_back(makePooled<Object>(pool, controlPool, i));
+        }
+        assert(Object::alive == 100);
+        assert(objects[42]->name == "42");
+    }
+    assert(controlPool->freeBlocks() == controlBlocks);
+
+    // 在别的线程释放
+    std::shared_ptr<Object> remote = makePooled<Object>(pool, controlPool, 7);
+    std::thread t([&remote]() { remote.reset(); });
+    t.join();
+    assert(Object::alive == 0);
+
+    // 池的引用在删除器和控制块的 allocator 里，最后一个 weak_ptr 释放之后池才析构
+    std::shared_ptr<Object> keep = makePooled<Object>(pool, controlPool, 2);
+    std::weak_ptr<Object> weak = keep;
+    pool.reset();
+    controlPool.reset();
+    assert(keep->name == "2");
+    keep.reset();
+    assert(Object::alive == 0 && weak.expired());
+}
+
+/**
+ * 设置了空闲超时的连接不断建立和关闭，TimeoutWheel 中的过期条目要到超时才清理，
+ * 连接对象的块仍然在连接关闭后马上复用，池不会随连接数增长
+ */
+void testConnectionChurn()
+{
+    const uint16_t kPort = 19540;
+    const int kConnections = 2000;
+    const int kBatch = 32;      // 每批连接都关闭之后再建立下一批，同时存在的连接不超过一个 chunk
+    Logger::setLogLevel(Logger::ERROR);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "churn");
+    server.setThreadNum(1);
+    server.setIdleTimeout(60.0);
+    std::atomic<int> closed(0);
+    server.setConnectionCallback([&closed](const TcpConnectionPtr &conn) {
+        if (!conn->connected())
+        {
+            ++closed;
+        }
+    });
+    EventLoop *ioLoop = nullptr;
+    server.setThreadInitCallback([&ioLoop](EventLoop *loop) { ioLoop = loop; });
+    server.start();
+
+    size_t chunks = 0;
+    std::thread client([&]() {
+        for (int i = 0; i < kConnections; ++i)
+        {
+            int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr;
+            ::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(kPort);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            assert(::connect(sockfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+            ::close(sockfd);
+            while ((i + 1) % kBatch == 0 && closed < i + 1)
+            {
+                usleep(100);
+            }
+        }
+        while (closed < kConnections)
+        {
+            usleep(1000);
+        }
+        ioLoop->runInLoop([&]() {
+            chunks = ioLoop->connectionPool()->chunkCount();
+            loop.queueInLoop([&loop]() { loop.quit(); });
+        });
+    });
+    loop.loop();
+    client.join();
+    assert(chunks == 1);
+}
+
+int main()
+{
+    testBlocks();
+    testMakePooled();
+    testConnectionChurn();
+    printf("FixedBlockPoolTest passed\n");
+    return 0;
+}
@@ -0,0 +1,267 @@
+#include "ListenerHandoff.h"
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const uint16_t kPort = 19527;
+const char *kPath = "/tmp/ListenerHandoffTest.sock";
+
+int connectTo(uint16_t port)
+{
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(sockfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        ::close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+// 绑定 port 的 SO_REUSEPORT 监听 socket，模拟旧进程交过来的 fd
+int listenReusePort(uint16_t port)
+{
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    ::setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(::bind(sockfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+    assert(::listen(sockfd, 128) == 0);
+    return sockfd;
+}
+
+// 读到 EOF，返回读到的字节数
+size_t readAll(int sockfd, bool slow)
+{
+    char buf[64 * 1024];
+    size_t total = 0;
+    ssize_t n;
+    while ((n = ::read(sockfd, buf, sizeof buf)) > 0)
+    {
+        total += n;
+        if (slow)
+        {
+            usleep(1000);
+        }
+    }
+    return total;
+}
+
+void testSendFds()
+{
+    int pair[2];
+    int pipefd[2];
+    assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    assert(::pipe(pipefd) == 0);
+
+    std::vector<int> fds;
+    fds.push_back(pipefd[1]);
+    assert(ListenerHandoff::sendFds(pair[0], fds));
+    std::vector<int> got = ListenerHandoff::recvFds(pair[1]);
+    assert(got.size() == 1 && got[0] != pipefd[1]);
+
+    // 收到的 fd 和发送的是同一个管道
+    assert(::write(got[0], "x", 1) == 1);
+    char c = 0;
+    assert(::read(pipefd[0], &c, 1) == 1 && c == 'x');
+
+    assert(!ListenerHandoff::sendFds(pair[0], std::vector<int>()));
+    ::close(got[0]);
+    ::close(pipefd[0]);
+    ::close(pipefd[1]);
+    ::close(pair[0]);
+    ::close(pair[1]);
+}
+
+/**
+ * 连接上还有 4MB 没发完时开始 drain
+ * 新连接被拒绝，已有连接收完全部数据后关闭，然后调用 done
+ */
+void testDrain()
+{
+    const size_t kBytes = 4 * 1024 * 1024;
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "drain");
+    server.setThreadNum(1);
+    std::atomic<bool> connected(false);
+    server.setConnectionCallback([&connected, kBytes](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->send(std::string(kBytes, 'd'));
+            connected = true;
+        }
+    });
+    server.start();
+
+    size_t received = 0;
+    bool refused = false;
+    std::thread client([&]() {
+        int sockfd = connectTo(kPort);
+        assert(sockfd >= 0);
+        while (!connected)
+        {
+            usleep(1000);
+        }
+        server.drain(5.0, [&loop]() { loop.quit(); });
+        usleep(50 * 1000);
+        refused = connectTo(kPort) < 0;
+        received = readAll(sockfd, true);
+        ::close(sockfd);
+    });
+    loop.loop();
+    client.join();
+
+    assert(refused);
+    assert(received == kBytes);
+    assert(server.connectionCount() == 0);
+    printf("drain ok\n");
+}
+
+/**
+ * 旧服务器把监听 socket 交出去后 drain 退出，新的一方用收到的 fd 继续 accept
+ * 交接前后连接都不会被拒绝
+ */
+void testHandoff()
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort + 1), "old");
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.start();
+    ListenerHandoff handoff(&loop, kPath);
+    handoff.listen(std::bind(&TcpServer::listenFds, &server), [&server, &loop]() {
+        server.drain(1.0, [&loop]() { loop.quit(); });
+    });
+
+    std::vector<int> fds;
+    std::thread next([&fds]() {
+        fds = ListenerHandoff::receive(kPath);
+    });
+    loop.loop();
+    next.join();
+    assert(fds.size() == 1);
+
+    // 旧服务器已经关闭了自己的 fd，连接排进同一个 accept 队列
+    int client = connectTo(kPort + 1);
+    assert(client >= 0);
+    int accepted = ::accept(fds[0], nullptr, nullptr);
+    assert(accepted >= 0);
+    ::close(accepted);
+    ::close(client);
+    ::close(fds[0]);
+
+    // 没有旧进程时返回空
+    assert(ListenerHandoff::receive(kPath).empty());
+    printf("handoff ok\n");
+}
+
+/**
+ * 没有连接时 drain 也要等 subLoop 的 Acceptor 都析构之后才调用 done
+ * subLoop 忙的时候 Acceptor 晚一点析构，done 里监听 socket 应该都已经关闭
+ */
+void testDrainWaitsForAcceptors()
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort + 2), "acceptors");
+    server.setThreadNum(2);
+    server.setAcceptStrategy(TcpServer::kReusePortPerLoop);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    std::mutex mutex;
+    std::vector<EventLoop*> ioLoops;
+    server.setThreadInitCallback([&](EventLoop *ioLoop) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ioLoops.push_back(ioLoop);
+    });
+    server.start();
+
+    bool refused = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ioLoops.back()->runInLoop([]() { usleep(200 * 1000); });
+    }
+    server.drain(5.0, [&]() {
+        refused = connectTo(kPort + 2) < 0;
+        loop.quit();
+    });
+    loop.loop();
+    assert(refused);
+    printf("drain waits for acceptors ok\n");
+}
+
+/**
+ * 接管的监听 socket 比 subLoop 多，或者不是 kReusePortPerLoop，多出来的也要继续 accept
+ * 交接之前排在每个 socket 队列里的连接都不能丢
+ */
+void testAdoptExtraFds(TcpServer::AcceptStrategy strategy)
+{
+    const uint16_t port = kPort + 3;
+    const int kSockets = 3;
+    const int kClients = 30;
+    std::vector<int> fds;
+    for (int i = 0; i < kSockets; ++i)
+    {
+        fds.push_back(listenReusePort(port));
+    }
+    // 内核按哈希把连接分到三个 socket 的队列里
+    std::vector<int> clients;
+    for (int i = 0; i < kClients; ++i)
+    {
+        int sockfd = connectTo(port);
+        assert(sockfd >= 0);
+        clients.push_back(sockfd);
+    }
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "adopt");
+    server.setThreadNum(1);
+    server.setAcceptStrategy(strategy);
+    std::atomic<int> connected(0);
+    server.setConnectionCallback([&connected](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            ++connected;
+        }
+    });
+    server.adoptListenFds(fds);
+    server.start();
+    loop.runAfter(0.3, [&loop]() { loop.quit(); });
+    loop.loop();
+    assert(connected == kClients);
+    assert(server.listenFds().size() == static_cast<size_t>(kSockets));
+    for (int sockfd : clients)
+    {
+        ::close(sockfd);
+    }
+}
+
+int main()
+{
+    testSendFds();
+    testDrain();
+    testHandoff();
+    testDrainWaitsForAcceptors();
+    testAdoptExtraFds(TcpServer::kReusePortPerLoop);
+    testAdoptExtraFds(TcpServer::kMainLoopAccept);
+    printf("adopt extra fds ok\n");
+    printf("ListenerHandoffTest passed\n");
+    return 0;
+}
@@ -0,0 +1,229 @@
+#include "OutputChain.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <memory>
+#include <string>
+
+// 非阻塞的 socketpair，发送端缓冲区尽量小，容易出现写不完的情况
+void makePair(int fds[2])
+{
+    assert(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+    int size = 4096;
+    ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+}
+
+// 读出对端现在能读到的所有数据
+std::string drain(int fd)
+{
+    std::string data;
+    char buf[64 * 1024];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+    {
+        data.append(buf, n);
+    }
+    return data;
+}
+
+// 交替写和读直到发完，返回对端收到的数据
+std::string flush(OutputChain *chain, int fds[2])
+{
+    std::string received;
+    while (!chain->empty())
+    {
+        int savedErrno = 0;
+        size_t before = chain->bytes();
+        ssize_t n = chain->writeFd(fds[0], &savedErrno, false);
+        assert(savedErrno == 0 || savedErrno == EAGAIN);
+        assert(chain->bytes() == before - n);
+        received += drain(fds[1]);
+    }
+    return received;
+}
+
+std::string pattern(size_t len, char seed)
+{
+    std::string data(len, '\0');
+    for (size_t i = 0; i < len; ++i)
+    {
+        data[i] = static_cast<char>(seed + i % 23);
+    }
+    return data;
+}
+
+// 临时文件，内容为 content，返回只读的 fd
+int makeFile(const std::string &content)
+{
+    char path[] = "/tmp/OutputChainTestXXXXXX";
+    int fd = ::mkstemp(path);
+    assert(fd >= 0);
+    ::unlink(path);
+    assert(::write(fd, content.data(), content.size()) == static_cast<ssize_t>(content.size()));
+    return fd;
+}
+
+bool isOpen(int fd)
+{
+    return ::fcntl(fd, F_GETFD) != -1;
+}
+
+/**
+ * 各种段按加入的顺序发出，小段拷贝进 chain，大段不拷贝
+ */
+void testOrder()
+{
+    int fds[2];
+    makePair(fds);
+    OutputChain chain;
+    std::string expected;
+
+    std::string small = pattern(100, 'a');
+    chain.append(small.data(), small.size());
+    expected += small;
+
+    Buffer buf;
+    std::string big = pattern(5000, 'b');
+    buf.append(big);
+    chain.append(&buf);
+    assert(buf.readableBytes() == 0);
+    expected += big;
+
+    std::string str = pattern(3000, 'c');
+    expected += str;
+    chain.append(std::move(str));
+
+    std::shared_ptr<const std::string> block(new std::string(pattern(7000, 'd')));
+    chain.append(block);
+    expected += *block;
+
+    chain.append("tail", 4);
+    expected += "tail";
+
+    assert(chain.bytes() == expected.size());
+    assert(flush(&chain, fds) == expected);
+    assert(chain.bytes() == 0);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+/**
+ * 内核缓冲区满时只写出一部分，剩下的下次从断开的位置继续
+ * untilBlocked 时一直写到 EAGAIN
+ */
+void testPartialWrite()
+{
+    int fds[2];
+    makePair(fds);
+    OutputChain chain;
+    std::string data = pattern(1024 * 1024, 'p');
+    chain.append(std::string(data));
+
+    int savedErrno = 0;
+    ssize_t n = chain.writeFd(fds[0], &savedErrno, false);
+    assert(n > 0 && static_cast<size_t>(n) < data.size());
+    assert(savedErrno == 0);
+    assert(chain.bytes() == data.size() - n);
+
+    // 缓冲区已满，untilBlocked 写到 EAGAIN 为止
+    chain.writeFd(fds[0], &savedErrno, true);
+    assert(savedErrno == EAGAIN);
+
+    std::string received = drain(fds[1]);
+    assert(received.size() == data.size() - chain.bytes());
+    received += flush(&chain, fds);
+    assert(received == data);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+/**
+ * 内存段和文件段交错，文件段用 sendfile 发送，没有 holder 的文件发完后关闭
+ * 文件被截断时发完剩下的数据后报 EIO，后面的段不再发送
+ */
+void testFileSegments()
+{
+    int fds[2];
+    makePair(fds);
+    std::string content = pattern(200 * 1024, 'f');
+    int owned = makeFile(content);
+    int shared = makeFile(content);
+    // 共享的文件由 holder 管理，发送队列不关闭
+    std::shared_ptr<void> holder = std::make_shared<int>(shared);
+
+    OutputChain chain;
+    std::string expected;
+    chain.append("HTTP/1.1 200 OK\r\n\r\n", 19);
+    expected += "HTTP/1.1 200 OK\r\n\r\n";
+    chain.appendFile(owned, 1000, 100 * 1024, std::shared_ptr<void>());
+    expected += content.substr(1000, 100 * 1024);
+    chain.append("--", 2);
+    expected += "--";
+    chain.appendFile(shared, 0, content.size(), holder);
+    expected += content;
+
+    assert(flush(&chain, fds) == expected);
+    assert(!isOpen(owned));
+    assert(isOpen(shared));
+
+    // 超出文件长度的部分发不出去，继续发后面的段会让对端错位
+    chain.appendFile(shared, content.size() - 10, 100, holder);
+    chain.append("end", 3);
+    int savedErrno = 0;
+    ssize_t n = chain.writeFd(fds[0], &savedErrno, true);
+    assert(n == 10 && savedErrno == EIO);
+    assert(drain(fds[1]) == content.substr(content.size() - 10));
+    assert(chain.bytes() == 90 + 3);
+    chain.clear();
+    ::close(shared);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+/**
+ * append(OutputChain*) 保持顺序，文件的所有权随段转移，原来的 chain 析构时不关闭
+ * clear 关闭属于自己的文件
+ */
+void testMoveChain()
+{
+    int fds[2];
+    makePair(fds);
+    std::string content = pattern(1000, 'm');
+    int owned = makeFile(content);
+
+    OutputChain chain;
+    chain.append("head", 4);
+    {
+        OutputChain other;
+        other.append("body", 4);
+        other.appendFile(owned, 0, content.size(), std::shared_ptr<void>());
+        chain.append(&other);
+        assert(other.empty() && other.bytes() == 0);
+    }
+    assert(isOpen(owned));
+    assert(chain.bytes() == 8 + content.size());
+    assert(flush(&chain, fds) == "headbody" + content);
+    assert(!isOpen(owned));
+
+    int dropped = makeFile(content);
+    chain.appendFile(dropped, 0, content.size(), std::shared_ptr<void>());
+    chain.clear();
+    assert(!isOpen(dropped) && chain.empty());
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+int main()
+{
+    testOrder();
+    testPartialWrite();
+    testFileSegments();
+    testMoveChain();
+    printf("OutputChainTest passed\n");
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "EventLoop.h"
+#include "Channel.h"
+#include "IoUringPoller.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/**
+ * 两个管道之间来回传一个字节，每个 Poller 实现都跑一遍
+ * 实现和其他测试一样通过环境变量 MUDUO_USE_POLL / MUDUO_USE_IO_URING 选择
+ */
+void pingPong(const char *name, bool edgeTriggered)
+{
+    const int kRounds = 10000;
+    int ping[2];
+    int pong[2];
+    assert(::pipe2(ping, O_NONBLOCK | O_CLOEXEC) == 0);
+    assert(::pipe2(pong, O_NONBLOCK | O_CLOEXEC) == 0);
+
+    EventLoop loop;
+    int rounds = 0;
+    Channel server(&loop, ping[0]);
+    Channel client(&loop, pong[0]);
+    server.setReadCallback([&](Timestamp) {
+        char c;
+        // 边缘触发时要把管道读空
+        while (::read(ping[0], &c, 1) == 1)
+        {
+            assert(::write(pong[1], &c, 1) == 1);
+        }
+    });
+    client.setReadCallback([&](Timestamp) {
+        char c;
+        while (::read(pong[0], &c, 1) == 1)
+        {
+            if (++rounds == kRounds)
+            {
+                loop.quit();
+            }
+            else
+            {
+                assert(::write(ping[1], &c, 1) == 1);
+            }
+        }
+    });
+    server.setEdgeTriggered(edgeTriggered);
+    client.setEdgeTriggered(edgeTriggered);
+    server.enableReading();
+    client.enableReading();
+
+    assert(::write(ping[1], "x", 1) == 1);
+    loop.loop();
+    assert(rounds == kRounds);
+
+    server.disableAll();
+    server.remove();
+    client.disableAll();
+    client.remove();
+    ::close(ping[0]);
+    ::close(ping[1]);
+    ::close(pong[0]);
+    ::close(pong[1]);
+    printf("%s%s ok\n", name, server.isEdgeTriggered() ? " edge-triggered" : "");
+}
+
+void run(const char *name, const char *env)
+{
+    ::unsetenv("MUDUO_USE_POLL");
+    ::unsetenv("MUDUO_USE_IO_URING");
+    if (env)
+    {
+        ::setenv(env, "1", 1);
+    }
+    pingPong(name, false);
+    pingPong(name, true);
+}
+
+int main()
+{
+    run("epoll", nullptr);
+    run("poll", "MUDUO_USE_POLL");
+    if (IoUringPoller::available())
+    {
+        run("io_uring", "MUDUO_USE_IO_URING");
+    }
+    else
+    {
+        printf("io_uring not available\n");
+    }
+    printf("PollerTest passed\n");
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include "Task.h"
+#include "TaskQueue.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Timestamp.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+void testTask()
+{
+    // 小对象放在内部缓冲区，move-only 的对象也能放进去
+    std::unique_ptr<int> p(new int(42));
+    int got = 0;
+    int *out = &got;
+    Task small([out]() { *out = 1; });
+    small();
+    assert(got == 1);
+
+    std::shared_ptr<int> shared(new int(7));
+    Task bound(std::bind([out](const std::shared_ptr<int> &v) { *out = *v; }, shared));
+    assert(shared.use_count() == 2);
+    Task moved(std::move(bound));
+    assert(!bound);
+    moved();
+    assert(got == 7);
+    moved.reset();
+    assert(shared.use_count() == 1);
+
+    // 超过 kInlineSize 的对象放在堆上
+    char big[Task::kInlineSize * 2] = "big";
+    Task large([big, out]() { *out = big[0]; });
+    Task assigned;
+    assigned = std::move(large);
+    assigned();
+    assert(got == 'b');
+
+    // 可以从 std::function 构造
+    std::function<void()> fn = [out]() { *out = 3; };
+    Task fromFunction(fn);
+    fromFunction();
+    assert(got == 3);
+    printf("task ok\n");
+}
+
+// 多个生产者各自按顺序投递，消费者看到的每个生产者的序号必须递增且不丢失
+void testQueue()
+{
+    const int kProducers = 4;
+    const int kPerProducer = 200000;
+    TaskQueue queue;
+    std::vector<int> lastSeen(kProducers, -1);
+    std::atomic<int> done(0);
+
+    std::vector<std::thread> producers;
+    for (int id = 0; id < kProducers; ++id)
+    {
+        producers.emplace_back([&queue, &lastSeen, &done, id]() {
+            for (int i = 0; i < kPerProducer; ++i)
+            {
+                queue.push([&lastSeen, id, i]() {
+                    assert(lastSeen[id] == i - 1);
+                    lastSeen[id] = i;
+                });
+            }
+            ++done;
+        });
+    }
+
+    size_t total = 0;
+    while (done < kProducers || total < static_cast<size_t>(kProducers) * kPerProducer)
+    {
+        total += queue.runAll();
+    }
+    for (std::thread &t : producers)
+    {
+        t.join();
+    }
+    assert(total == static_cast<size_t>(kProducers) * kPerProducer);
+    for (int id = 0; id < kProducers; ++id)
+    {
+        assert(lastSeen[id] == kPerProducer - 1);
+    }
+    printf("queue ok\n");
+}
+
+// 跨线程投递到 EventLoop，测量一批任务的耗时
+void testEventLoop()
+{
+    EventLoopThread thread;
+    EventLoop *loop = thread.startLoop();
+
+    const int kThreads = 4;
+    const int kPerThread = 100000;
+    std::atomic<int> count(0);
+    Timestamp start(Timestamp::now());
+    std::vector<std::thread> producers;
+    for (int i = 0; i < kThreads; ++i)
+    {
+        producers.emplace_back([loop, &count]() {
+            for (int j = 0; j < kPerThread; ++j)
+            {
+                loop->queueInLoop([&count]() { ++count; });
+            }
+        });
+    }
+    for (std::thread &t : producers)
+    {
+        t.join();
+    }
+    while (count < kThreads * kPerThread)
+    {
+        usleep(1000);
+    }
+    printf("event loop ok, %d tasks in %.3f s\n", kThreads * kPerThread, timeDifference(Timestamp::now(), start));
+}
+
+// 一次投递一个任务，等它执行完再投递下一个，测量往返延迟
+double pingPong(EventLoop *loop, int rounds)
+{
+    std::atomic<int> done(0);
+    Timestamp start(Timestamp::now());
+    for (int i = 1; i <= rounds; ++i)
+    {
+        loop->queueInLoop([&done]() { done.store(done.load(std::memory_order_relaxed) + 1, std::memory_order_release); });
+        while (done.load(std::memory_order_acquire) < i)
+        {
+        }
+    }
+    return timeDifference(Timestamp::now(), start) * 1000000.0 / rounds;
+}
+
+void testBusyPoll()
+{
+    EventLoopThread thread;
+    EventLoop *loop = thread.startLoop();
+    const int kRounds = 20000;
+
+    // 空转的 loop 线程和投递线程需要各占一个 CPU，单核上对比没有意义
+    if (std::thread::hardware_concurrency() >= 2)
+    {
+        double blocking = pingPong(loop, kRounds);
+        loop->setBusyPoll(200);
+        double spinning = pingPong(loop, kRounds);
+        printf("round trip blocking %.2f us, spinning %.2f us\n", blocking, spinning);
+    }
+    loop->setBusyPoll(200);
+    pingPong(loop, 100);
+
+    // 空闲超过时间预算后回到阻塞的 poll，之后投递的任务仍然能唤醒 loop
+    for (int i = 0; i < 3; ++i)
+    {
+        usleep(10 * 1000);
+        std::atomic<bool> ran(false);
+        loop->queueInLoop([&ran]() { ran = true; });
+        for (int wait = 0; !ran && wait < 1000; ++wait)
+        {
+            usleep(1000);
+        }
+        assert(ran);
+    }
+    loop->setBusyPoll(0);
+    printf("busy poll ok\n");
+}
+
+int main()
+{
+    testTask();
+    testQueue();
+    testEventLoop();
+    testBusyPoll();
+    return 0;
+}
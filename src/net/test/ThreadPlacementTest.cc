@@ -0,0 +1,112 @@
+#include "ThreadPlacement.h"
+#include "Thread.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "FixedBlockPool.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <algorithm>
+#include <future>
+#include <string>
+#include <vector>
+
+std::string currentThreadName()
+{
+    char name[16] = {0};
+    ::prctl(PR_GET_NAME, name);
+    return name;
+}
+
+void testParse()
+{
+    using ThreadPlacement::parseCpuList;
+    assert(parseCpuList("0-3,8,10-11\n") == std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+    assert(parseCpuList("5,1,1") == std::vector<int>({1, 5}));
+    assert(parseCpuList("").empty());
+    assert(parseCpuList("3-1").empty());
+    assert(parseCpuList("1,x").empty());
+
+    std::vector<int> allowed = ThreadPlacement::allowedCpus();
+    assert(!allowed.empty());
+    assert(ThreadPlacement::excludeCpus(allowed).empty());
+    assert(ThreadPlacement::numaNodeCount() >= 1);
+
+    // 交错之后还是同样的 CPU
+    std::vector<int> spread = ThreadPlacement::spreadAcrossNodes(allowed);
+    std::sort(spread.begin(), spread.end());
+    assert(spread == allowed);
+}
+
+void testThread()
+{
+    std::vector<int> one(1, ThreadPlacement::allowedCpus().back());
+    std::vector<int> seen;
+    std::string name;
+    Thread thread([&seen, &name]() {
+        seen = ThreadPlacement::allowedCpus();
+        name = currentThreadName();
+    }, "PlacementTestThreadName");
+    thread.setCpuAffinity(one);
+    thread.start();
+    thread.join();
+    assert(seen == one);
+    // 内核只保留前 15 个字符
+    assert(name == "PlacementTestTh");
+}
+
+void testLoopPool()
+{
+    EventLoop baseLoop;
+    EventLoopThreadPool pool(&baseLoop, "io");
+    const int cpu = ThreadPlacement::allowedCpus().front();
+    pool.setThreadNum(2);
+    pool.setPlacement(EventLoopThreadPool::kPinToCpus, std::vector<int>(1, cpu));
+    pool.start();
+    assert(pool.ioCpus() == std::vector<int>(2, cpu));
+
+    std::vector<EventLoop*> loops = pool.getAllLoops();
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        std::promise<std::string> result;
+        loops[i]->runInLoop([&result]() {
+            char buf[64];
+            snprintf(buf, sizeof buf, "%s@%d", currentThreadName().c_str(), ::sched_getcpu());
+            result.set_value(buf);
+        });
+        char expected[64];
+        snprintf(expected, sizeof expected, "io%zu@%d", i, cpu);
+        assert(result.get_future().get() == expected);
+    }
+}
+
+void testNumaPool()
+{
+    FixedBlockPool pool;
+    pool.setNumaNode(0);
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < FixedBlockPool::kBlocksPerChunk * 2; ++i)
+    {
+        void *block = pool.allocate(200);
+        ::memset(block, static_cast<int>(i), 200);
+        blocks.push_back(block);
+    }
+    assert(pool.chunkCount() == 2);
+    for (void *block : blocks)
+    {
+        pool.deallocate(block, 200);
+    }
+}
+
+int main()
+{
+    testParse();
+    testThread();
+    testLoopPool();
+    testNumaPool();
+    printf("ThreadPlacementTest passed\n");
+    return 0;
+}
@@ -1,5 +1,37 @@
 #include "Timer.h"
 
+std::atomic<int64_t> Timer::s_numCreated_(0);
+
+Timer::Timer()
+    : interval_(0.0),
+      repeat_(false),
+      sequence_(0),
+      state_(kFree),
+      prev_(nullptr),
+      next_(nullptr),
+      tick_(0),
+      level_(0),
+      slot_(0)
+{
+}
+
+void Timer::init(TimerCallback cb, Timestamp when, double interval)
+{
+    callback_ = std::move(cb);
+    expiration_ = when;
+    interval_ = interval;
+    repeat_ = interval > 0.0; // 一次性定时器设置为0
+    sequence_.store(s_numCreated_.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    state_ = kPending;
+}
+
+void Timer::release()
+{
+    callback_ = nullptr;
+    sequence_.store(0, std::memory_order_relaxed);
+    state_ = kFree;
+}
+
 void Timer::restart(Timestamp now)
 {
     if (repeat_)
@@ -7,8 +39,8 @@ void Timer::restart(Timestamp now)
         // 如果是重复定时事件，则继续添加定时事件，得到新事件到期事件
         expiration_ = addTime(now, interval_);
     }
-    else 
+    else
     {
         expiration_ = Timestamp();
     }
-}
\ No newline at end of file
+}
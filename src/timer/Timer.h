@@ -3,35 +3,53 @@
 
 #include "noncopyable.h"
 #include "Timestamp.h"
+#include <stdint.h>
+#include <atomic>
 #include <functional>
 
 /**
  * Timer用于描述一个定时器
  * 定时器回调函数，下一次超时时刻，重复定时器的时间间隔等
+ *
+ * Timer 节点由 TimerQueue 的对象池分配，到期或取消后回收复用，
+ * 每次分配都会得到新的 sequence，TimerId 用它判断节点是否还是原来那个定时器
  */
 class Timer : noncopyable
 {
 public:
     using TimerCallback = std::function<void()>;
 
-    Timer(TimerCallback cb, Timestamp when, double interval)
-        : callback_(move(cb)),
-          expiration_(when),
-          interval_(interval),
-          repeat_(interval > 0.0) // 一次性定时器设置为0
+    // 节点在 TimerQueue 中的状态
+    enum State
     {
-    }
+        kFree,          // 在对象池中
+        kPending,       // 在定时器队列中等待到期
+        kExpired,       // 已到期，正在执行本轮的回调
+        kCanceled,      // 本轮到期后被取消，回调结束后回收
+        kRestarted,     // 本轮到期后被重新设置了到期时间，回调结束后重新插入
+    };
+
+    Timer();
+
+    // 从对象池取出时设置回调和到期时间
+    void init(TimerCallback cb, Timestamp when, double interval);
+    // 回收时释放回调持有的资源
+    void release();
 
     // 调用此定时器的回调函数
-    void run() const 
-    { 
-        callback_(); 
+    void run() const
+    {
+        callback_();
     }
 
     // 返回此定时器超时时间
     Timestamp expiration() const  { return expiration_; }
+    void setExpiration(Timestamp when) { expiration_ = when; }
 
     bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_.load(std::memory_order_relaxed); }
+    State state() const { return state_; }
+    void setState(State state) { state_ = state; }
 
     // 重启定时器(如果是非重复事件则到期时间置为0)
     void restart(Timestamp now);
@@ -43,10 +61,23 @@ public:
     */
 
 private:
-    const TimerCallback callback_;  // 定时器回调函数
+    friend class TimingWheel;
+
+    TimerCallback callback_;        // 定时器回调函数
     Timestamp expiration_;          // 下一次的超时时刻
-    const double interval_;         // 超时时间间隔(超时后设置下一次超时时间)，如果是一次性定时器，该值为0
-    const bool repeat_;             // 是否重复(false 表示是一次性定时器)
+    double interval_;               // 超时时间间隔(超时后设置下一次超时时间)，如果是一次性定时器，该值为0
+    bool repeat_;                   // 是否重复(false 表示是一次性定时器)
+    std::atomic<int64_t> sequence_; // 本次分配的序号，在池中时为 0
+    State state_;
+
+    // 时间轮的侵入式双向链表
+    Timer *prev_;
+    Timer *next_;
+    uint64_t tick_;                 // 到期的 tick
+    int level_;                     // 所在的层和槽
+    int slot_;
+
+    static std::atomic<int64_t> s_numCreated_;
 };
 
-#endif // TIMER_H
\ No newline at end of file
+#endif // TIMER_H
@@ -0,0 +1,36 @@
+#ifndef TIMER_ID_H
+#define TIMER_ID_H
+
+#include <stdint.h>
+
+class Timer;
+
+/**
+ * 定时器句柄，EventLoop::runAt/runAfter/runEvery 返回，用于取消或重新设置定时器
+ * Timer 节点回收后会被复用，所以同时记录 sequence，定时器已经结束的句柄操作时什么也不做
+ */
+class TimerId
+{
+public:
+    TimerId()
+        : timer_(nullptr),
+          sequence_(0)
+    {
+    }
+
+    TimerId(Timer *timer, int64_t sequence)
+        : timer_(timer),
+          sequence_(sequence)
+    {
+    }
+
+    bool valid() const { return timer_ != nullptr; }
+
+    friend class TimerQueue;
+
+private:
+    Timer *timer_;
+    int64_t sequence_;
+};
+
+#endif // TIMER_ID_H
@@ -7,6 +7,7 @@
 #include <sys/timerfd.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdlib.h>
 
 int createTimerfd()
 {
@@ -23,11 +24,19 @@ int createTimerfd()
     return timerfd;
 }
 
-TimerQueue::TimerQueue(EventLoop* loop)
+TimerQueue::Mode TimerQueue::defaultMode()
+{
+    return ::getenv("MUDUO_PRECISE_TIMERS") ? kPrecise : kWheel;
+}
+
+TimerQueue::TimerQueue(EventLoop* loop, Mode mode)
     : loop_(loop),
+      mode_(mode),
       timerfd_(createTimerfd()),
       timerfdChannel_(loop_, timerfd_),
-      timers_()
+      timers_(),
+      base_(Timestamp::now()),
+      callingExpiredTimers_(false)
 {
     timerfdChannel_.setReadCallback(
         std::bind(&TimerQueue::handleRead, this)); //定时器读触发事件(超时)
@@ -35,22 +44,20 @@ TimerQueue::TimerQueue(EventLoop* loop)
 }
 
 TimerQueue::~TimerQueue()
-{   
+{
     timerfdChannel_.disableAll();
     timerfdChannel_.remove();
     ::close(timerfd_);
-    // 删除所有定时器
-    for (const Entry& timer : timers_)
-    {
-        delete timer.second; //非智能指针
-    }
+    // 所有 Timer 都在 chunks_ 里，随 chunks_ 一起释放
 }
 
-void TimerQueue::addTimer(TimerCallback cb,
-                          Timestamp when,
-                          double interval)
+TimerId TimerQueue::addTimer(TimerCallback cb,
+                             Timestamp when,
+                             double interval)
 {
-    Timer* timer = new Timer(std::move(cb), when, interval);
+    Timer* timer = allocTimer();
+    timer->init(std::move(cb), when, interval);
+    TimerId timerId(timer, timer->sequence());
     /*
     EventLoop调用方法，加入一个定时器事件，会向里传入定时器回调函数，超时时间和间隔时间（为0.0则为一次性定时器），
     addTimer方法根据这些属性构造新的定时器。
@@ -59,17 +66,79 @@ void TimerQueue::addTimer(TimerCallback cb,
     */
     loop_->runInLoop(
         std::bind(&TimerQueue::addTimerInLoop, this, timer));
+    return timerId;
+}
+
+void TimerQueue::cancel(TimerId timerId)
+{
+    loop_->runInLoop(
+        std::bind(&TimerQueue::cancelInLoop, this, timerId));
+}
+
+void TimerQueue::restart(TimerId timerId, Timestamp when)
+{
+    loop_->runInLoop(
+        std::bind(&TimerQueue::restartInLoop, this, timerId, when));
 }
 
 void TimerQueue::addTimerInLoop(Timer* timer)
 {
-    // 是否取代了最早的定时触发时间
-    bool eraliestChanged = insert(timer);
+    insert(timer);
+    // 正在执行到期回调时，回调结束后会统一重新设置timerfd_
+    if (!callingExpiredTimers_)
+    {
+        rearm();
+    }
+}
+
+void TimerQueue::cancelInLoop(TimerId timerId)
+{
+    Timer* timer = timerId.timer_;
+    if (!timer || timer->sequence() != timerId.sequence_)
+    {
+        return;
+    }
+    switch (timer->state())
+    {
+        case Timer::kPending:
+            remove(timer);
+            releaseTimer(timer);
+            break;
+        case Timer::kExpired:
+        case Timer::kRestarted:
+            // 在本轮到期的定时器的回调中取消，还没执行的回调不再执行，结束后回收
+            timer->setState(Timer::kCanceled);
+            break;
+        default:
+            break;
+    }
+}
 
-    // 我们需要重新设置timerfd_触发时间
-    if (eraliestChanged)
+void TimerQueue::restartInLoop(TimerId timerId, Timestamp when)
+{
+    Timer* timer = timerId.timer_;
+    if (!timer || timer->sequence() != timerId.sequence_)
     {
-        resetTimerfd(timerfd_, timer->expiration());
+        return;
+    }
+    switch (timer->state())
+    {
+        case Timer::kPending:
+            remove(timer);
+            timer->setExpiration(when);
+            insert(timer);
+            if (!callingExpiredTimers_)
+            {
+                rearm();
+            }
+            break;
+        case Timer::kExpired:
+        case Timer::kRestarted:
+            timer->setExpiration(when);
+            timer->setState(Timer::kRestarted);
+            break;
+        default:
+            break;
     }
 }
 
@@ -102,92 +171,194 @@ void TimerQueue::resetTimerfd(int timerfd_, Timestamp expiration)
     }
 }
 
-void ReadTimerFd(int timerfd) 
+void TimerQueue::rearm()
+{
+    if (empty())
+    {
+        return;
+    }
+    Timestamp next = nextExpiration();
+    // 已经设置了更早的时间就不用再设置，被取消的定时器最多导致一次空的唤醒
+    if (armed_ == Timestamp::invalid() || next < armed_)
+    {
+        resetTimerfd(timerfd_, next);
+        armed_ = next;
+    }
+}
+
+void ReadTimerFd(int timerfd)
 {
     uint64_t read_byte;
     ssize_t readn = ::read(timerfd, &read_byte, sizeof(read_byte));
-    
+
     if (readn != sizeof(read_byte)) {
         LOG_ERROR << "TimerQueue::ReadTimerFd read_size < 0";
     }
 }
 
-// 返回删除的定时器节点 （std::vector<Entry> expired）
-std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now)
+// 把到期的定时器从队列中取出，放到 expired_
+void TimerQueue::getExpired(Timestamp now)
 {
-    std::vector<Entry> expired;
-    // TODO:???
-    Entry sentry(now, reinterpret_cast<Timer*>(UINTPTR_MAX));
-    TimerList::iterator end = timers_.lower_bound(sentry); //返回第一个大于等于x的数（x的下界），如果没找到，返回末尾的迭代器位置
-    std::copy(timers_.begin(), end, back_inserter(expired));
-    //在原来的set上去掉这些过期的定时器
-    timers_.erase(timers_.begin(), end);
-    
-    return expired;
+    if (mode_ == kWheel)
+    {
+        int64_t elapsed = now.microSecondsSinceEpoch() - base_.microSecondsSinceEpoch();
+        uint64_t nowTick = elapsed > 0 ? static_cast<uint64_t>(elapsed / kMicroSecondsPerTick) : 0;
+        wheel_.advance(nowTick, &expired_);
+    }
+    else
+    {
+        // 哨兵的指针取最大值，到期时间等于 now 的定时器也会被取出
+        Entry sentry(now, reinterpret_cast<Timer*>(UINTPTR_MAX));
+        TimerList::iterator end = timers_.lower_bound(sentry); //返回第一个大于等于x的数（x的下界），如果没找到，返回末尾的迭代器位置
+        for (TimerList::iterator it = timers_.begin(); it != end; ++it)
+        {
+            expired_.push_back(it->second);
+        }
+        //在原来的set上去掉这些过期的定时器
+        timers_.erase(timers_.begin(), end);
+    }
+    for (Timer* timer : expired_)
+    {
+        timer->setState(Timer::kExpired);
+    }
 }
 
 void TimerQueue::handleRead()
 {
     Timestamp now = Timestamp::now();
     ReadTimerFd(timerfd_); //只是读一下，存入一个int中就行
+    // timerfd_ 已经触发，不再处于设置状态
+    armed_ = Timestamp::invalid();
 
-    std::vector<Entry> expired = getExpired(now);
-    //返回删除的定时器节点
+    getExpired(now);
 
-    // 遍历到期的定时器，调用回调函数
+    // 遍历到期的定时器，调用回调函数，前面的回调可能取消了后面的定时器
     callingExpiredTimers_ = true;
-    for (const Entry& it : expired)
+    for (Timer* timer : expired_)
     {
-        it.second->run(); //timer->cakkback()   
+        if (timer->state() != Timer::kCanceled)
+        {
+            timer->run();
+        }
     }
     callingExpiredTimers_ = false;
-    
-    // 重新设置这些定时器
-    reset(expired, now);
 
+    // 重新设置这些定时器
+    reset(now);
 }
 
-void TimerQueue::reset(const std::vector<Entry>& expired, Timestamp now)
+void TimerQueue::reset(Timestamp now)
 {
-    Timestamp nextExpire;
-    for (const Entry& it : expired)
+    for (Timer* timer : expired_)
     {
-        // 重复任务则继续执行
-        if (it.second->repeat())
-        {
-            auto timer = it.second;
-            timer->restart(Timestamp::now());
-            insert(timer);
-        }
-        else
+        switch (timer->state())
         {
-            delete it.second;
+            case Timer::kExpired:
+                // 重复任务则继续执行
+                if (timer->repeat())
+                {
+                    timer->restart(now);
+                    insert(timer);
+                }
+                else
+                {
+                    releaseTimer(timer);
+                }
+                break;
+            case Timer::kRestarted:
+                // 回调中重新设置了到期时间
+                insert(timer);
+                break;
+            default:
+                releaseTimer(timer);
+                break;
         }
+    }
+    expired_.clear();
 
-        // 如果重新插入了定时器，需要继续重置timerfd
-        if (!timers_.empty())
+    // 所有定时器都处理完后只设置一次timerfd
+    rearm();
+}
+
+void TimerQueue::insert(Timer* timer)
+{
+    timer->setState(Timer::kPending);
+    if (mode_ == kWheel)
+    {
+        if (wheel_.empty())
         {
-            resetTimerfd(timerfd_, (timers_.begin()->second)->expiration());
+            // 时间轮空闲了一段时间，从现在开始计算
+            int64_t elapsed = Timestamp::now().microSecondsSinceEpoch() - base_.microSecondsSinceEpoch();
+            wheel_.skipTo(elapsed > 0 ? static_cast<uint64_t>(elapsed / kMicroSecondsPerTick) : 0);
         }
+        wheel_.insert(timer, tickOf(timer->expiration()));
+    }
+    else
+    {
+        // 定时器管理红黑树插入此新定时器，set自动排序
+        timers_.insert(Entry(timer->expiration(), timer));
     }
 }
 
-bool TimerQueue::insert(Timer* timer)
+void TimerQueue::remove(Timer* timer)
 {
-    bool earliestChanged = false;
-    Timestamp when = timer->expiration();
-    TimerList::iterator it = timers_.begin();
-    if (it == timers_.end() || when < it->first)
+    if (mode_ == kWheel)
+    {
+        wheel_.remove(timer);
+    }
+    else
     {
-        //内部实现的插入方法获取此定时器的超时时间，如果比先前的时间小就说明第一个触发。那么我们会设置好布尔变量。因此这涉及到timerfd_的触发时间。
-        // 说明最早的定时器已经被替换了
-        earliestChanged = true;
+        timers_.erase(Entry(timer->expiration(), timer));
     }
+}
+
+bool TimerQueue::empty() const
+{
+    return mode_ == kWheel ? wheel_.empty() : timers_.empty();
+}
+
+Timestamp TimerQueue::nextExpiration() const
+{
+    return mode_ == kWheel ? timeOfTick(wheel_.nextTick()) : timers_.begin()->first;
+}
 
-    // 定时器管理红黑树插入此新定时器，set自动排序
-    timers_.insert(Entry(when, timer));
+uint64_t TimerQueue::tickOf(Timestamp when) const
+{
+    int64_t elapsed = when.microSecondsSinceEpoch() - base_.microSecondsSinceEpoch();
+    if (elapsed <= 0)
+    {
+        return 0;
+    }
+    return static_cast<uint64_t>((elapsed + kMicroSecondsPerTick - 1) / kMicroSecondsPerTick);
+}
 
-    return earliestChanged;
+Timestamp TimerQueue::timeOfTick(uint64_t tick) const
+{
+    return Timestamp(base_.microSecondsSinceEpoch() + static_cast<int64_t>(tick) * kMicroSecondsPerTick);
 }
 
+Timer* TimerQueue::allocTimer()
+{
+    std::lock_guard<std::mutex> lock(poolMutex_);
+    if (freeTimers_.empty())
+    {
+        // 整块分配，节点地址在 TimerQueue 析构前一直有效，过期的 TimerId 也能安全地比较 sequence
+        chunks_.emplace_back(new Timer[kTimersPerChunk]);
+        Timer* chunk = chunks_.back().get();
+        for (size_t i = kTimersPerChunk; i > 0; --i)
+        {
+            freeTimers_.push_back(&chunk[i - 1]);
+        }
+    }
+    Timer* timer = freeTimers_.back();
+    freeTimers_.pop_back();
+    return timer;
+}
 
+void TimerQueue::releaseTimer(Timer* timer)
+{
+    // 先在锁外释放回调持有的资源
+    timer->release();
+    std::lock_guard<std::mutex> lock(poolMutex_);
+    freeTimers_.push_back(timer);
+}
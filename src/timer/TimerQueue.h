@@ -3,56 +3,111 @@
 
 #include "Timestamp.h"
 #include "Channel.h"
+#include "TimerId.h"
+#include "TimingWheel.h"
 
 #include <vector>
 #include <set>
+#include <memory>
+#include <mutex>
 
 class EventLoop;
 class Timer;
 
+/**
+ * 定时器队列，所有定时器共用一个 timerfd
+ * 两种实现:
+ *   kWheel   分层时间轮，精度 1ms，插入、取消、重新设置都是 O(1)，适合每个连接一个超时定时器的场景
+ *   kPrecise 按到期时间排序的红黑树，精确到微秒
+ * 默认使用时间轮，设置环境变量 MUDUO_PRECISE_TIMERS 使用红黑树
+ * 一轮到期处理完后只重新设置一次 timerfd
+ */
 class TimerQueue
 {
 public:
     using TimerCallback = std::function<void()>;
 
-    explicit TimerQueue(EventLoop* loop);
+    enum Mode
+    {
+        kWheel,
+        kPrecise,
+    };
+
+    explicit TimerQueue(EventLoop* loop, Mode mode = defaultMode());
     ~TimerQueue();
 
+    static Mode defaultMode();
+    Mode mode() const { return mode_; }
+
     // 插入定时器（回调函数，到期时间，是否重复）
-    void addTimer(TimerCallback cb,
-                  Timestamp when,
-                  double interval);
-    
+    TimerId addTimer(TimerCallback cb,
+                     Timestamp when,
+                     double interval);
+
+    // 取消定时器，定时器已经结束时什么也不做
+    void cancel(TimerId timerId);
+    // 把还没结束的定时器的下一次到期时间改成 when
+    void restart(TimerId timerId, Timestamp when);
+
 private:
     using Entry = std::pair<Timestamp, Timer*>; // 以时间戳作为键值获取定时器
     using TimerList = std::set<Entry>;          // 底层使用红黑树管理，自动按照时间戳进行排序
 
+    // 时间轮的 tick 长度
+    static const int64_t kMicroSecondsPerTick = 1000;
+    // 对象池每次分配的 Timer 个数
+    static const size_t kTimersPerChunk = 256;
+
     // 在本loop中添加定时器
     // 线程安全
     void addTimerInLoop(Timer* timer);
+    void cancelInLoop(TimerId timerId);
+    void restartInLoop(TimerId timerId, Timestamp when);
 
     // 定时器读事件触发的函数
     void handleRead();
 
     // 重新设置timerfd_
     void resetTimerfd(int timerfd_, Timestamp expiration);
-    
+    // 最早的到期时间比已经设置的早时重新设置 timerfd_
+    void rearm();
+
     // 移除所有已到期的定时器
     // 1.获取到期的定时器
     // 2.重置这些定时器（销毁或者重复定时任务）
-    std::vector<Entry> getExpired(Timestamp now);
-    void reset(const std::vector<Entry>& expired, Timestamp now);
+    void getExpired(Timestamp now);
+    void reset(Timestamp now);
+
+    // 插入和删除定时器的内部方法
+    void insert(Timer* timer);
+    void remove(Timer* timer);
+    bool empty() const;
+    Timestamp nextExpiration() const;
 
-    // 插入定时器的内部方法
-    bool insert(Timer* timer);
+    // 到期时间向上取整到 tick，保证不会提前触发
+    uint64_t tickOf(Timestamp when) const;
+    Timestamp timeOfTick(uint64_t tick) const;
+
+    // 定时器节点的对象池，其他线程的 addTimer 也会分配，所以加锁
+    Timer* allocTimer();
+    void releaseTimer(Timer* timer);
 
     EventLoop* loop_;           // 所属的EventLoop
+    const Mode mode_;
     const int timerfd_;         // timerfd是Linux提供的定时器接口
     Channel timerfdChannel_;    // 封装timerfd_文件描述符
     // Timer list sorted by expiration
     TimerList timers_;          // 定时器队列（内部实现是红黑树）
+    TimingWheel wheel_;
+    const Timestamp base_;      // tick 0 对应的时间
+    Timestamp armed_;           // timerfd_ 当前设置的到期时间，无效表示没有设置
 
+    std::vector<Timer*> expired_;           // 本轮到期的定时器，复用避免每次分配
     bool callingExpiredTimers_; // 标明正在获取超时定时器
+
+    std::mutex poolMutex_;
+    std::vector<Timer*> freeTimers_;
+    std::vector<std::unique_ptr<Timer[]>> chunks_;
 };
 
-#endif // TIMER_QUEUE_H
\ No newline at end of file
+#endif // TIMER_QUEUE_H
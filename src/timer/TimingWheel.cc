@@ -0,0 +1,197 @@
+#include "TimingWheel.h"
+#include "Timer.h"
+
+#include <string.h>
+#include <algorithm>
+
+TimingWheel::TimingWheel()
+    : currentTick_(0),
+      size_(0)
+{
+    ::memset(slots_, 0, sizeof(slots_));
+    ::memset(bitmap_, 0, sizeof(bitmap_));
+}
+
+void TimingWheel::insert(Timer *timer, uint64_t tick)
+{
+    timer->tick_ = tick;
+    // 已经过期的放到当前 tick 的槽里，下一次 advance 就会取出
+    uint64_t slotTick = std::max(tick, currentTick_);
+    uint64_t delta = slotTick - currentTick_;
+
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (1ULL << (kRootBits + kLevelBits * level)))
+    {
+        ++level;
+    }
+    const uint64_t range = 1ULL << (kRootBits + kLevelBits * (kLevels - 1));
+    if (delta >= range)
+    {
+        // 超出最上层的范围，先放在最远的槽，下放时按真正的 tick 重新插入
+        slotTick = currentTick_ + range - 1;
+    }
+    int slot = static_cast<int>((slotTick >> shiftOf(level)) & (slotsOf(level) - 1));
+    link(timer, level, slot);
+    ++size_;
+}
+
+void TimingWheel::remove(Timer *timer)
+{
+    unlink(timer);
+    --size_;
+}
+
+uint64_t TimingWheel::nextTick() const
+{
+    uint64_t next = UINT64_MAX;
+    // 第 0 层的槽就是到期的 tick
+    int offset = nextSlot(0, static_cast<int>(currentTick_ & (kRootSlots - 1)));
+    if (offset >= 0)
+    {
+        next = currentTick_ + offset;
+    }
+    // 上层的槽在它的起始边界下放
+    for (int level = 1; level < kLevels; ++level)
+    {
+        const int shift = shiftOf(level);
+        uint64_t boundary = (currentTick_ + (1ULL << shift) - 1) >> shift;
+        offset = nextSlot(level, static_cast<int>(boundary & (kLevelSlots - 1)));
+        if (offset >= 0)
+        {
+            next = std::min(next, (boundary + offset) << shift);
+        }
+    }
+    return next;
+}
+
+void TimingWheel::advance(uint64_t nowTick, std::vector<Timer*> *expired)
+{
+    // 直接跳到下一个有事的 tick，中间的空 tick 不用逐个处理
+    while (size_ > 0)
+    {
+        uint64_t tick = nextTick();
+        if (tick > nowTick)
+        {
+            break;
+        }
+        currentTick_ = tick;
+        cascade(tick);
+        Timer *timer = detach(0, static_cast<int>(tick & (kRootSlots - 1)));
+        while (timer)
+        {
+            Timer *next = timer->next_;
+            timer->prev_ = timer->next_ = nullptr;
+            expired->push_back(timer);
+            --size_;
+            timer = next;
+        }
+        ++currentTick_;
+    }
+    if (currentTick_ <= nowTick)
+    {
+        currentTick_ = nowTick + 1;
+    }
+}
+
+void TimingWheel::skipTo(uint64_t tick)
+{
+    if (size_ == 0 && tick > currentTick_)
+    {
+        currentTick_ = tick;
+    }
+}
+
+void TimingWheel::link(Timer *timer, int level, int slot)
+{
+    Timer *&head = slots_[level][slot];
+    timer->level_ = level;
+    timer->slot_ = slot;
+    timer->prev_ = nullptr;
+    timer->next_ = head;
+    if (head)
+    {
+        head->prev_ = timer;
+    }
+    head = timer;
+    bitmap_[level][slot / 64] |= 1ULL << (slot % 64);
+}
+
+void TimingWheel::unlink(Timer *timer)
+{
+    const int level = timer->level_;
+    const int slot = timer->slot_;
+    if (timer->prev_)
+    {
+        timer->prev_->next_ = timer->next_;
+    }
+    else
+    {
+        slots_[level][slot] = timer->next_;
+    }
+    if (timer->next_)
+    {
+        timer->next_->prev_ = timer->prev_;
+    }
+    timer->prev_ = timer->next_ = nullptr;
+    if (!slots_[level][slot])
+    {
+        bitmap_[level][slot / 64] &= ~(1ULL << (slot % 64));
+    }
+}
+
+Timer* TimingWheel::detach(int level, int slot)
+{
+    Timer *head = slots_[level][slot];
+    slots_[level][slot] = nullptr;
+    bitmap_[level][slot / 64] &= ~(1ULL << (slot % 64));
+    return head;
+}
+
+void TimingWheel::cascade(uint64_t tick)
+{
+    // 从上往下，上层下放的定时器可能马上又要从下一层继续下放
+    for (int level = kLevels - 1; level > 0; --level)
+    {
+        const int shift = shiftOf(level);
+        if (tick & ((1ULL << shift) - 1))
+        {
+            continue;
+        }
+        Timer *timer = detach(level, static_cast<int>((tick >> shift) & (kLevelSlots - 1)));
+        while (timer)
+        {
+            Timer *next = timer->next_;
+            --size_;
+            insert(timer, timer->tick_);
+            timer = next;
+        }
+    }
+}
+
+int TimingWheel::nextSlot(int level, int from) const
+{
+    const int slots = slotsOf(level);
+    const int words = slots / 64;
+    const int first = from / 64;
+    const int bit = from % 64;
+    // 依次检查 from 所在的字的高位、其他字、再绕回 from 所在字的低位
+    for (int i = 0; i <= words; ++i)
+    {
+        const int w = (first + i) % words;
+        uint64_t bits = bitmap_[level][w];
+        if (i == 0)
+        {
+            bits &= ~0ULL << bit;
+        }
+        else if (i == words)
+        {
+            bits &= bit == 0 ? 0 : (1ULL << bit) - 1;
+        }
+        if (bits)
+        {
+            int pos = w * 64 + __builtin_ctzll(bits);
+            return (pos - from + slots) % slots;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,74 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include "noncopyable.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+class Timer;
+
+/**
+ * 分层时间轮，TimerQueue 的默认实现
+ *
+ * 时间以 tick 为单位，共 4 层:
+ *   第 0 层 256 个槽，每槽 1 个 tick
+ *   第 1~3 层各 64 个槽，每槽是下一层一整圈
+ * 定时器按距离当前 tick 的远近放进对应的层，上层的槽转到时把其中的定时器重新插入(下放)到下层，
+ * 超过最上层范围的先放在最远的槽里，下放时再重新计算
+ * 插入和删除都是 O(1) 的链表操作，用位图找下一个非空的槽
+ */
+class TimingWheel : noncopyable
+{
+public:
+    TimingWheel();
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    // 下一个还没处理的 tick
+    uint64_t currentTick() const { return currentTick_; }
+
+    void insert(Timer *timer, uint64_t tick);
+    void remove(Timer *timer);
+
+    /**
+     * 下一个需要处理的 tick: 有定时器到期，或者上层有槽需要下放
+     * 定时器只在这个 tick 设置 timerfd，中间的 tick 不唤醒 loop
+     * 时间轮为空时返回值无意义
+     */
+    uint64_t nextTick() const;
+
+    // 处理 nowTick 及之前的所有 tick，到期的定时器按到期顺序追加到 expired，并从时间轮中移除
+    void advance(uint64_t nowTick, std::vector<Timer*> *expired);
+
+    // 时间轮为空时直接把当前 tick 前移，避免插入时从很久以前的 tick 开始计算
+    void skipTo(uint64_t tick);
+
+private:
+    static const int kLevels = 4;
+    static const int kRootBits = 8;
+    static const int kLevelBits = 6;
+    static const int kRootSlots = 1 << kRootBits;
+    static const int kLevelSlots = 1 << kLevelBits;
+    static const int kWords = kRootSlots / 64;
+
+    static int shiftOf(int level) { return level == 0 ? 0 : kRootBits + kLevelBits * (level - 1); }
+    static int slotsOf(int level) { return level == 0 ? kRootSlots : kLevelSlots; }
+
+    void link(Timer *timer, int level, int slot);
+    void unlink(Timer *timer);
+    // 取出一个槽的整条链表
+    Timer* detach(int level, int slot);
+    // tick 是某层槽的边界时，把上层这个槽的定时器下放
+    void cascade(uint64_t tick);
+    // 从 from 开始循环查找第一个非空的槽，返回偏移量，没有返回 -1
+    int nextSlot(int level, int from) const;
+
+    Timer *slots_[kLevels][kRootSlots];
+    uint64_t bitmap_[kLevels][kWords];  // 非空的槽
+    uint64_t currentTick_;
+    size_t size_;
+};
+
+#endif // TIMING_WHEEL_H
@@ -0,0 +1,216 @@
+#include "Timer.h"
+#include "TimingWheel.h"
+#include "TimerQueue.h"
+#include "EventLoop.h"
+#include "Timestamp.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// 和逐个 tick 推进的结果对比，覆盖各层的下放和超出范围的定时器
+void testWheelOrder()
+{
+    const size_t kTimers = 5000;
+    std::unique_ptr<Timer[]> timers(new Timer[kTimers]);
+    std::vector<uint64_t> ticks(kTimers);
+    std::minstd_rand random(12345);
+
+    TimingWheel wheel;
+    wheel.skipTo(1000);
+    for (size_t i = 0; i < kTimers; ++i)
+    {
+        // 一半在第 0、1 层的范围内，其余分布到更高层和超出最上层
+        uint64_t delay = i % 2 ? random() % 20000 : random() % (1ULL << 28);
+        ticks[i] = 1000 + delay;
+        wheel.insert(&timers[i], ticks[i]);
+    }
+    // 取消一部分
+    std::vector<bool> canceled(kTimers, false);
+    for (size_t i = 0; i < kTimers; i += 7)
+    {
+        wheel.remove(&timers[i]);
+        canceled[i] = true;
+    }
+
+    std::vector<Timer*> expired;
+    size_t fired = 0;
+    uint64_t now = 999;
+    while (!wheel.empty())
+    {
+        // 每次推进的距离不固定，模拟 loop 被其他事件耽误
+        uint64_t prev = now;
+        now = std::max(now + 1, wheel.nextTick()) + random() % 3;
+        expired.clear();
+        wheel.advance(now, &expired);
+        for (Timer *timer : expired)
+        {
+            size_t i = timer - timers.get();
+            assert(!canceled[i]);
+            // 在第一次推进到它的 tick 时到期，不会提前也不会推迟
+            assert(ticks[i] <= now && ticks[i] > prev);
+            canceled[i] = true;
+            ++fired;
+        }
+    }
+    for (size_t i = 0; i < kTimers; ++i)
+    {
+        assert(canceled[i]);
+    }
+    printf("testWheelOrder fired=%zu\n", fired);
+}
+
+// nextTick 给出的 tick 之前不会有定时器到期
+void testWheelNextTick()
+{
+    Timer a, b;
+    TimingWheel wheel;
+    wheel.insert(&a, 300);      // 第 1 层
+    assert(wheel.nextTick() == 256);
+    std::vector<Timer*> expired;
+    wheel.advance(299, &expired);
+    assert(expired.empty());
+    assert(wheel.nextTick() == 300);
+    wheel.advance(300, &expired);
+    assert(expired.size() == 1 && expired[0] == &a);
+
+    wheel.insert(&b, 100);      // 已经过期
+    assert(wheel.nextTick() == wheel.currentTick());
+    expired.clear();
+    wheel.advance(wheel.currentTick(), &expired);
+    assert(expired.size() == 1 && expired[0] == &b);
+    assert(wheel.empty());
+    printf("testWheelNextTick ok\n");
+}
+
+void testLoop(TimerQueue::Mode mode)
+{
+    if (mode == TimerQueue::kPrecise)
+    {
+        ::setenv("MUDUO_PRECISE_TIMERS", "1", 1);
+    }
+    else
+    {
+        ::unsetenv("MUDUO_PRECISE_TIMERS");
+    }
+    EventLoop loop;
+    std::vector<int> order;
+
+    loop.runAfter(0.03, [&order]() { order.push_back(3); });
+    loop.runAfter(0.01, [&order]() { order.push_back(1); });
+    loop.runAfter(0.02, [&order]() { order.push_back(2); });
+
+    // 取消
+    TimerId canceled = loop.runAfter(0.015, [&order]() { order.push_back(-1); });
+    loop.cancel(canceled);
+
+    // 重新设置: 原本 0.005 秒到期，推迟到 0.025 秒
+    TimerId delayed = loop.runAfter(0.005, [&order]() { order.push_back(25); });
+    loop.restartTimer(delayed, 0.025);
+
+    // 重复定时器在自己的回调中取消
+    int ticks = 0;
+    TimerId every;
+    every = loop.runEvery(0.004, [&]() {
+        if (++ticks == 3)
+        {
+            loop.cancel(every);
+        }
+    });
+
+    // 回调中取消同一轮里还没执行的定时器
+    std::shared_ptr<int> resource(new int(0));
+    TimerId victim = loop.runAt(addTime(Timestamp::now(), 0.04), [&order, resource]() { order.push_back(-2); });
+    loop.runAt(addTime(Timestamp::now(), 0.04), [&loop, victim]() { loop.cancel(victim); });
+
+    // 其他线程取消
+    TimerId remote = loop.runAfter(0.035, [&order]() { order.push_back(-3); });
+    std::thread canceler([&loop, remote]() { loop.cancel(remote); });
+    canceler.join();
+
+    Timestamp start = Timestamp::now();
+    loop.runAfter(0.06, [&loop]() { loop.quit(); });
+    loop.loop();
+    double elapsed = timeDifference(Timestamp::now(), start);
+
+    assert(ticks == 3);
+    std::vector<int> expected = {1, 2, 25, 3};
+    // victim 和取消它的定时器同一时刻到期，执行顺序不确定
+    order.erase(std::remove(order.begin(), order.end(), -2), order.end());
+    assert(order == expected);
+    assert(elapsed >= 0.055 && elapsed < 0.5);
+    printf("testLoop mode=%s elapsed=%.3f\n", mode == TimerQueue::kWheel ? "wheel" : "precise", elapsed);
+}
+
+// 取消或者到期后，回调持有的资源被释放
+void testRelease()
+{
+    ::unsetenv("MUDUO_PRECISE_TIMERS");
+    EventLoop loop;
+    std::shared_ptr<int> resource(new int(0));
+    TimerId id = loop.runAfter(10.0, [resource]() {});
+    loop.runAfter(0.001, [resource]() {});
+    assert(resource.use_count() == 3);
+    loop.cancel(id);
+    assert(resource.use_count() == 2);
+    // 已经结束的句柄再操作什么也不做
+    loop.cancel(id);
+    loop.restartTimer(id, 0.001);
+    loop.runAfter(0.01, [&loop]() { loop.quit(); });
+    loop.loop();
+    assert(resource.use_count() == 1);
+    printf("testRelease ok\n");
+}
+
+// 大量定时器插入、重新设置和取消的耗时
+void benchmark(TimerQueue::Mode mode)
+{
+    if (mode == TimerQueue::kPrecise)
+    {
+        ::setenv("MUDUO_PRECISE_TIMERS", "1", 1);
+    }
+    else
+    {
+        ::unsetenv("MUDUO_PRECISE_TIMERS");
+    }
+    const int kTimers = 100000;
+    EventLoop loop;
+    std::vector<TimerId> ids(kTimers);
+    Timestamp start = Timestamp::now();
+    for (int i = 0; i < kTimers; ++i)
+    {
+        ids[i] = loop.runAfter(60.0 + i % 1000 * 0.001, []() {});
+    }
+    for (int round = 0; round < 5; ++round)
+    {
+        for (int i = 0; i < kTimers; ++i)
+        {
+            loop.restartTimer(ids[i], 60.0 + (i + round) % 1000 * 0.001);
+        }
+    }
+    for (int i = 0; i < kTimers; ++i)
+    {
+        loop.cancel(ids[i]);
+    }
+    double elapsed = timeDifference(Timestamp::now(), start);
+    printf("benchmark mode=%s add+5*restart+cancel of %d timers: %.3fs\n",
+           mode == TimerQueue::kWheel ? "wheel" : "precise", kTimers, elapsed);
+}
+
+int main()
+{
+    testWheelOrder();
+    testWheelNextTick();
+    testLoop(TimerQueue::kWheel);
+    testLoop(TimerQueue::kPrecise);
+    testRelease();
+    benchmark(TimerQueue::kWheel);
+    benchmark(TimerQueue::kPrecise);
+    return 0;
+}